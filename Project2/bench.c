@@ -0,0 +1,646 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cacti.h"
+#include "err.h"
+
+#define ignore (void)
+
+// Benchmarks of actor workloads. Each one runs in its own actor system
+// and reports messages per second and percentiles of its latency samples.
+// Run with a workload name to run only that one.
+
+#ifndef BENCH_PING_PONG_ROUNDS
+#define BENCH_PING_PONG_ROUNDS 100000
+#endif
+
+#ifndef BENCH_FAN_OUT_WORKERS
+#define BENCH_FAN_OUT_WORKERS 64
+#endif
+
+#ifndef BENCH_FAN_OUT_ROUNDS
+#define BENCH_FAN_OUT_ROUNDS 2000
+#endif
+
+#ifndef BENCH_CHAIN_LENGTH
+#define BENCH_CHAIN_LENGTH 100000
+#endif
+
+// Skynet spawns 10^BENCH_SKYNET_DEPTH leaves, CAST_LIMIT has to fit all actors.
+#ifndef BENCH_SKYNET_DEPTH
+#define BENCH_SKYNET_DEPTH 6
+#endif
+
+#ifndef BENCH_MATRIX_ROWS
+#define BENCH_MATRIX_ROWS 20000
+#endif
+
+#ifndef BENCH_MATRIX_COLUMNS
+#define BENCH_MATRIX_COLUMNS 16
+#endif
+
+// Rows of matrix passing through columns at once.
+#define BENCH_MATRIX_ROWS_IN_FLIGHT 256
+
+#define MSG_READY (message_type_t)1
+#define MSG_START (message_type_t)2
+#define MSG_WORK (message_type_t)3
+#define MSG_RESULT (message_type_t)4
+
+typedef struct workload {
+    const char *name;
+    role_t *role;
+    void (*init)();
+    unsigned long long (*messages)(); // Messages sent by a run.
+    const char *latency;              // What latency samples measure.
+} workload_t;
+
+static unsigned long long *samples_g;
+static size_t samples_capacity_g;
+static atomic_size_t samples_number_g;
+
+static unsigned long long now_ns() {
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now)) {
+        fatal(__FILE__, __LINE__);
+    }
+    return (unsigned long long) now.tv_sec * 1000000000ULL + (unsigned long long) now.tv_nsec;
+}
+
+static void record_latency(unsigned long long since_ns) {
+    size_t sample = atomic_fetch_add(&samples_number_g, 1);
+    if (sample < samples_capacity_g) {
+        samples_g[sample] = now_ns() - since_ns;
+    }
+}
+
+static message_t make_message(message_type_t type, void *data) {
+    message_t message;
+    message.message_type = type;
+    message.data = data;
+    message.nbytes = 0;
+    return message;
+}
+
+static message_t make_spawn_msg(role_t *role_ptr) {
+    message_t message;
+    message.message_type = MSG_SPAWN;
+    message.data = (void *) role_ptr;
+    message.nbytes = sizeof(role_t);
+    return message;
+}
+
+static void send_or_fail(actor_id_t actor, message_t message) {
+    if (send_message_blocking(actor, message) != 0) {
+        fatal(__FILE__, __LINE__);
+    }
+}
+
+static void godie() {
+    send_or_fail(actor_id_self(), make_message(MSG_GODIE, NULL));
+}
+
+// Ping-pong: two actors pass one message back and forth.
+// Latency is the time of a round trip.
+
+static role_t ping_pong_role_g;
+static actor_id_t pinger_g;
+static actor_id_t ponger_g;
+static unsigned long rounds_g;
+
+static void ping_pong_hello(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+
+    if (nbytes == 0) {
+        pinger_g = actor_id_self();
+        send_or_fail(pinger_g, make_spawn_msg(&ping_pong_role_g));
+        return;
+    }
+    ponger_g = actor_id_self();
+    send_or_fail((actor_id_t) data, make_message(MSG_RESULT, (void *) now_ns()));
+}
+
+static void ping_pong_ping(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+    ignore nbytes;
+
+    send_or_fail(pinger_g, make_message(MSG_RESULT, data));
+}
+
+static void ping_pong_pong(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+    ignore nbytes;
+
+    record_latency((unsigned long long) data);
+    if (++rounds_g < BENCH_PING_PONG_ROUNDS) {
+        send_or_fail(ponger_g, make_message(MSG_WORK, (void *) now_ns()));
+    } else {
+        send_or_fail(ponger_g, make_message(MSG_GODIE, NULL));
+        godie();
+    }
+}
+
+static void ping_pong_ignore(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+    ignore nbytes;
+    ignore data;
+}
+
+static act_t ping_pong_prompts_g[] = {
+    ping_pong_hello,
+    ping_pong_ignore,
+    ping_pong_ignore,
+    ping_pong_ping,
+    ping_pong_pong
+};
+static role_t ping_pong_role_g = { .nprompts = 5, .prompts = ping_pong_prompts_g };
+
+static void ping_pong_init() {
+    rounds_g = 0;
+}
+
+static unsigned long long ping_pong_messages() {
+    return 2ULL * BENCH_PING_PONG_ROUNDS;
+}
+
+// Fan-out/fan-in: a master broadcasts work to workers in rounds
+// and waits for all of them to answer before the next round.
+// Latency is the time from broadcast to a worker handling it.
+
+static role_t fan_out_role_g;
+static actor_id_t workers_g[BENCH_FAN_OUT_WORKERS];
+static unsigned long ready_workers_g;
+static unsigned long answers_g;
+
+static void broadcast_round() {
+    message_t work = make_message(MSG_WORK, (void *) now_ns());
+    if (send_messages(workers_g, BENCH_FAN_OUT_WORKERS, work, NULL) != 0) {
+        fatal(__FILE__, __LINE__);
+    }
+}
+
+static void fan_out_hello(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+
+    if (nbytes == 0) {
+        for (int worker = 0; worker < BENCH_FAN_OUT_WORKERS; ++worker) {
+            send_or_fail(actor_id_self(), make_spawn_msg(&fan_out_role_g));
+        }
+        return;
+    }
+    *stateptr = data;
+    send_or_fail((actor_id_t) data, make_message(MSG_READY, (void *) actor_id_self()));
+}
+
+static void fan_out_ready(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+    ignore nbytes;
+
+    workers_g[ready_workers_g++] = (actor_id_t) data;
+    if (ready_workers_g == BENCH_FAN_OUT_WORKERS) {
+        broadcast_round();
+    }
+}
+
+static void fan_out_work(void **stateptr, size_t nbytes, void *data) {
+    ignore nbytes;
+
+    record_latency((unsigned long long) data);
+    send_or_fail((actor_id_t) *stateptr, make_message(MSG_RESULT, NULL));
+}
+
+static void fan_out_answer(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+    ignore nbytes;
+    ignore data;
+
+    ++answers_g;
+    if (answers_g % BENCH_FAN_OUT_WORKERS != 0) {
+        return;
+    }
+    if (answers_g < (unsigned long) BENCH_FAN_OUT_WORKERS * BENCH_FAN_OUT_ROUNDS) {
+        broadcast_round();
+        return;
+    }
+
+    message_t die = make_message(MSG_GODIE, NULL);
+    if (send_messages(workers_g, BENCH_FAN_OUT_WORKERS, die, NULL) != 0) {
+        fatal(__FILE__, __LINE__);
+    }
+    godie();
+}
+
+static act_t fan_out_prompts_g[] = {
+    fan_out_hello,
+    fan_out_ready,
+    ping_pong_ignore,
+    fan_out_work,
+    fan_out_answer
+};
+static role_t fan_out_role_g = { .nprompts = 5, .prompts = fan_out_prompts_g };
+
+static void fan_out_init() {
+    ready_workers_g = 0;
+    answers_g = 0;
+}
+
+static unsigned long long fan_out_messages() {
+    return 2ULL * BENCH_FAN_OUT_WORKERS * BENCH_FAN_OUT_ROUNDS;
+}
+
+// Chain: every actor spawns the next one and dies, as in silnia.
+// Latency is the time from spawn to hello of the new actor.
+
+static role_t chain_role_g;
+static unsigned long chain_length_g;
+static unsigned long long spawned_ns_g;
+
+static void chain_hello(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+    ignore data;
+
+    if (nbytes != 0) {
+        record_latency(spawned_ns_g);
+    }
+    if (++chain_length_g < BENCH_CHAIN_LENGTH) {
+        spawned_ns_g = now_ns();
+        send_or_fail(actor_id_self(), make_spawn_msg(&chain_role_g));
+    }
+    godie();
+}
+
+static act_t chain_prompts_g[] = { chain_hello };
+static role_t chain_role_g = { .nprompts = 1, .prompts = chain_prompts_g };
+
+static void chain_init() {
+    chain_length_g = 0;
+}
+
+static unsigned long long chain_messages() {
+    // Hello, spawn and godie of every actor but the last one.
+    return 3ULL * BENCH_CHAIN_LENGTH - 1;
+}
+
+// Skynet: every actor spawns 10 children down to BENCH_SKYNET_DEPTH,
+// leaves answer with their numbers and parents answer with sums.
+// Latency is the time from spawning a leaf to its answer.
+
+typedef struct skynet_actor {
+    actor_id_t parent;
+    long number;
+    int depth;
+    int children;
+    int answers;
+    long long sum;
+    unsigned long long spawned_ns;
+} skynet_actor_t;
+
+static role_t skynet_role_g;
+static long long skynet_sum_g;
+
+static void skynet_answer(skynet_actor_t *actor, long long sum) {
+    if (actor->depth == 0) {
+        skynet_sum_g = sum;
+    } else {
+        send_or_fail(actor->parent, make_message(MSG_RESULT, (void *) sum));
+    }
+    free(actor);
+    godie();
+}
+
+static skynet_actor_t *skynet_create(actor_id_t parent) {
+    skynet_actor_t *actor = (skynet_actor_t *) calloc(1, sizeof(skynet_actor_t));
+    if (actor == NULL) {
+        fatal(__FILE__, __LINE__);
+    }
+    actor->parent = parent;
+    return actor;
+}
+
+static void skynet_hello(void **stateptr, size_t nbytes, void *data) {
+    if (nbytes == 0) {
+        skynet_actor_t *root = skynet_create(-1);
+        *stateptr = root;
+        root->spawned_ns = now_ns();
+        for (int child = 0; child < 10; ++child) {
+            send_or_fail(actor_id_self(), make_spawn_msg(&skynet_role_g));
+        }
+        return;
+    }
+    *stateptr = skynet_create((actor_id_t) data);
+    send_or_fail((actor_id_t) data, make_message(MSG_READY, (void *) actor_id_self()));
+}
+
+// Parent gives children numbers in order they are ready, with depth in the lowest bits.
+static void skynet_ready(void **stateptr, size_t nbytes, void *data) {
+    ignore nbytes;
+
+    skynet_actor_t *actor = (skynet_actor_t *) *stateptr;
+    long number = actor->number * 10 + actor->children++;
+    long encoded = number * 8 + actor->depth + 1;
+    send_or_fail((actor_id_t) data, make_message(MSG_START, (void *) encoded));
+}
+
+static void skynet_start(void **stateptr, size_t nbytes, void *data) {
+    ignore nbytes;
+
+    skynet_actor_t *actor = (skynet_actor_t *) *stateptr;
+    actor->number = (long) data / 8;
+    actor->depth = (int) ((long) data % 8);
+    if (actor->depth == BENCH_SKYNET_DEPTH) {
+        skynet_answer(actor, actor->number);
+        return;
+    }
+    actor->spawned_ns = now_ns();
+    for (int child = 0; child < 10; ++child) {
+        send_or_fail(actor_id_self(), make_spawn_msg(&skynet_role_g));
+    }
+}
+
+static void skynet_result(void **stateptr, size_t nbytes, void *data) {
+    ignore nbytes;
+
+    skynet_actor_t *actor = (skynet_actor_t *) *stateptr;
+    actor->sum += (long long) data;
+    if (actor->depth == BENCH_SKYNET_DEPTH - 1) {
+        record_latency(actor->spawned_ns);
+    }
+    if (++actor->answers == 10) {
+        skynet_answer(actor, actor->sum);
+    }
+}
+
+static act_t skynet_prompts_g[] = {
+    skynet_hello,
+    skynet_ready,
+    skynet_start,
+    ping_pong_ignore,
+    skynet_result
+};
+static role_t skynet_role_g = { .nprompts = 5, .prompts = skynet_prompts_g };
+
+static void skynet_init() {
+    skynet_sum_g = -1;
+}
+
+static unsigned long long skynet_actors() {
+    unsigned long long actors = 0;
+    unsigned long long level = 1;
+    for (int depth = 0; depth <= BENCH_SKYNET_DEPTH; ++depth) {
+        actors += level;
+        level *= 10;
+    }
+    return actors;
+}
+
+static unsigned long long skynet_messages() {
+    // Spawn, hello, ready, start, result and godie of every actor but the root.
+    return 6 * (skynet_actors() - 1) + 2;
+}
+
+// Matrix: rows pass through column actors, as in macierz, without sleeping.
+// Latency is the time of a row through all columns, with a window of rows in flight.
+
+typedef struct matrix_row {
+    unsigned long row;
+    long long sum;
+    unsigned long long started_ns;
+} matrix_row_t;
+
+static role_t matrix_role_g;
+// The last one is the coordinator.
+static actor_id_t columns_g[BENCH_MATRIX_COLUMNS + 1];
+static unsigned long ready_columns_g;
+static unsigned long sent_rows_g;
+static unsigned long done_rows_g;
+static unsigned long wrong_rows_g;
+
+static void send_row(actor_id_t column, const matrix_row_t *row) {
+    message_t message = make_message(MSG_WORK, message_payload_alloc(sizeof(matrix_row_t)));
+    message.nbytes = sizeof(matrix_row_t);
+    memcpy(message.data, row, sizeof(matrix_row_t));
+    send_or_fail(column, message);
+}
+
+static void send_next_row() {
+    matrix_row_t row = { .row = sent_rows_g++, .sum = 0, .started_ns = now_ns() };
+    send_row(columns_g[0], &row);
+}
+
+static void matrix_hello(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+
+    if (nbytes == 0) {
+        columns_g[BENCH_MATRIX_COLUMNS] = actor_id_self();
+        for (int column = 0; column < BENCH_MATRIX_COLUMNS; ++column) {
+            send_or_fail(actor_id_self(), make_spawn_msg(&matrix_role_g));
+        }
+        return;
+    }
+    send_or_fail((actor_id_t) data, make_message(MSG_READY, (void *) actor_id_self()));
+}
+
+static void matrix_ready(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+    ignore nbytes;
+
+    columns_g[ready_columns_g++] = (actor_id_t) data;
+    if (ready_columns_g < BENCH_MATRIX_COLUMNS) {
+        return;
+    }
+
+    for (long column = 0; column < BENCH_MATRIX_COLUMNS; ++column) {
+        send_or_fail(columns_g[column], make_message(MSG_START, (void *) column));
+    }
+    while (sent_rows_g < BENCH_MATRIX_ROWS && sent_rows_g < BENCH_MATRIX_ROWS_IN_FLIGHT) {
+        send_next_row();
+    }
+}
+
+static void matrix_start(void **stateptr, size_t nbytes, void *data) {
+    ignore nbytes;
+
+    *stateptr = data;
+}
+
+// Cell in row r and column c has value r + c.
+// The last column sends the row to the coordinator, which handles it as a result.
+static void matrix_work(void **stateptr, size_t nbytes, void *data) {
+    ignore nbytes;
+
+    long column = (long) *stateptr;
+    matrix_row_t row = *(matrix_row_t *) data;
+    row.sum += (long long) row.row + column;
+    if (column + 1 < BENCH_MATRIX_COLUMNS) {
+        send_row(columns_g[column + 1], &row);
+    } else {
+        send_row(columns_g[BENCH_MATRIX_COLUMNS], &row);
+    }
+}
+
+static void matrix_result(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+    ignore nbytes;
+
+    matrix_row_t *row = (matrix_row_t *) data;
+    long long expected = (long long) row->row * BENCH_MATRIX_COLUMNS
+        + (long long) BENCH_MATRIX_COLUMNS * (BENCH_MATRIX_COLUMNS - 1) / 2;
+    if (row->sum != expected) {
+        ++wrong_rows_g;
+    }
+    record_latency(row->started_ns);
+
+    if (sent_rows_g < BENCH_MATRIX_ROWS) {
+        send_next_row();
+    }
+    if (++done_rows_g == BENCH_MATRIX_ROWS) {
+        for (int column = 0; column < BENCH_MATRIX_COLUMNS; ++column) {
+            send_or_fail(columns_g[column], make_message(MSG_GODIE, NULL));
+        }
+        godie();
+    }
+}
+
+static act_t matrix_prompts_g[] = {
+    matrix_hello,
+    matrix_ready,
+    matrix_start,
+    matrix_work,
+    ping_pong_ignore
+};
+static role_t matrix_role_g = { .nprompts = 5, .prompts = matrix_prompts_g };
+static act_t matrix_coordinator_prompts_g[] = {
+    matrix_hello,
+    matrix_ready,
+    matrix_start,
+    matrix_result,
+    ping_pong_ignore
+};
+static role_t matrix_coordinator_role_g = { .nprompts = 5, .prompts = matrix_coordinator_prompts_g };
+
+static void matrix_init() {
+    ready_columns_g = 0;
+    sent_rows_g = 0;
+    done_rows_g = 0;
+    wrong_rows_g = 0;
+}
+
+static unsigned long long matrix_messages() {
+    // Rows through every column and back, spawn, hello, ready, start and godie of columns.
+    return (unsigned long long) BENCH_MATRIX_ROWS * (BENCH_MATRIX_COLUMNS + 1)
+        + 5ULL * BENCH_MATRIX_COLUMNS + 2;
+}
+
+static workload_t workloads_g[] = {
+    { "ping-pong", &ping_pong_role_g, ping_pong_init, ping_pong_messages, "round trip" },
+    { "fan-out", &fan_out_role_g, fan_out_init, fan_out_messages, "broadcast to handler" },
+    { "chain", &chain_role_g, chain_init, chain_messages, "spawn to hello" },
+    { "skynet", &skynet_role_g, skynet_init, skynet_messages, "leaf spawn to answer" },
+    { "matrix", &matrix_coordinator_role_g, matrix_init, matrix_messages, "row through columns" },
+};
+
+static int compare_samples(const void *a, const void *b) {
+    unsigned long long first = *(const unsigned long long *) a;
+    unsigned long long second = *(const unsigned long long *) b;
+    return (first > second) - (first < second);
+}
+
+static unsigned long long percentile(size_t samples, int percent) {
+    if (samples == 0) {
+        return 0;
+    }
+    return samples_g[(samples - 1) * (size_t) percent / 100];
+}
+
+static void run(const workload_t *workload) {
+    workload->init();
+    atomic_store(&samples_number_g, 0);
+
+    unsigned long long start_ns = now_ns();
+    actor_id_t first_actor_id;
+    if (actor_system_create(&first_actor_id, workload->role)) {
+        fatal(__FILE__, __LINE__);
+    }
+    actor_system_join(first_actor_id);
+    unsigned long long elapsed_ns = now_ns() - start_ns;
+
+    size_t samples = atomic_load(&samples_number_g);
+    if (samples > samples_capacity_g) {
+        samples = samples_capacity_g;
+    }
+    qsort(samples_g, samples, sizeof(unsigned long long), compare_samples);
+
+    unsigned long long messages = workload->messages();
+    printf("pool %d %-10s %10llu messages %8.3f s %12.0f messages/s"
+           "  %s latency p50 %llu ns p99 %llu ns\n",
+           POOL_SIZE,
+           workload->name,
+           messages,
+           (double) elapsed_ns / 1e9,
+           (double) messages * 1e9 / (double) elapsed_ns,
+           workload->latency,
+           percentile(samples, 50),
+           percentile(samples, 99));
+}
+
+static size_t skynet_leaves() {
+    size_t leaves = 1;
+    for (int depth = 0; depth < BENCH_SKYNET_DEPTH; ++depth) {
+        leaves *= 10;
+    }
+    return leaves;
+}
+
+static void check_results() {
+    if (skynet_sum_g != -1) {
+        long long leaves = (long long) skynet_leaves();
+        if (skynet_sum_g != leaves * (leaves - 1) / 2) {
+            fprintf(stderr, "skynet: wrong sum %lld\n", skynet_sum_g);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (wrong_rows_g > 0) {
+        fprintf(stderr, "matrix: %lu wrong rows\n", wrong_rows_g);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Enough samples for every workload.
+static void reserve_samples(size_t samples) {
+    if (samples_capacity_g < samples) {
+        samples_capacity_g = samples;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    reserve_samples(BENCH_PING_PONG_ROUNDS);
+    reserve_samples((size_t) BENCH_FAN_OUT_WORKERS * BENCH_FAN_OUT_ROUNDS);
+    reserve_samples(BENCH_CHAIN_LENGTH);
+    reserve_samples(skynet_leaves());
+    reserve_samples(BENCH_MATRIX_ROWS);
+    samples_g = (unsigned long long *) malloc(samples_capacity_g * sizeof(unsigned long long));
+    if (samples_g == NULL) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    skynet_sum_g = -1;
+    bool found = false;
+    for (size_t i = 0; i < sizeof(workloads_g) / sizeof(workloads_g[0]); ++i) {
+        if (argc < 2 || strcmp(argv[1], workloads_g[i].name) == 0) {
+            run(&workloads_g[i]);
+            found = true;
+        }
+    }
+    check_results();
+
+    free(samples_g);
+    if (!found) {
+        fprintf(stderr, "unknown workload %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
@@ -1,75 +1,205 @@
 #include "cacti.h"
-#include "queue.h"
+#include "mailbox.h"
 #include "threadpool.h"
-#include "dynarray.h"
+#include "slab.h"
+#include "metrics.h"
+#include "trace.h"
 #include "err.h"
 
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-typedef queue *message_queue_t;
+// Number of actors in one segment of the actor registry.
+#define ACTOR_SEGMENT_SIZE 1024
+#define ACTOR_SEGMENTS ((CAST_LIMIT + ACTOR_SEGMENT_SIZE - 1) / ACTOR_SEGMENT_SIZE)
+
+// Number of mutex and condition variable pairs senders wait on for full mailboxes.
+#define SEND_STRIPES 64
+// Maximal number of actors processed one inside another by handlers waiting to send.
+#define SEND_HELP_DEPTH 16
+// Number of actors scheduled at once, or messages reserved at once, by batch sends.
+#define SEND_BATCH_SIZE 64
+// Longest sleep of a handler waiting for space in a mailbox before it tries to help again.
+#define SEND_HELP_WAIT_MS 1
+
+// States of processing an actor, by its scheduled task or meanwhile
+// by a handler waiting to send to it on another stack.
+#define RUNNER_IDLE 0
+#define RUNNER_BUSY 1
+#define RUNNER_TASK_PARKED 2 // Busy, and the scheduled task has to be added again after it.
+
+// Message sent by an actor to itself while its mailbox was empty.
+typedef struct continuation {
+    struct continuation *next;
+    message_t message;
+    void *payload;
+} continuation_t;
 
 typedef struct actor {
+    atomic_bool ready; // Set when other fields are initialized.
     actor_id_t id;
     role_t *role_ptr;
     void *state;
-    message_queue_t message_queue;
-    bool alive;
-    bool free;
-    pthread_cond_t *free_cond_ptr;
+    mailbox_t *mailbox; // Closed when the actor dies.
+    atomic_int waiting_senders; // Senders waiting for space in mailbox.
+    atomic_int runner; // RUNNER_ state, so one thread at a time processes the actor.
+    // Messages to self processed before the mailbox, as they were sent
+    // before every message in it. They are counted in the mailbox.
+    // Used only by the thread processing the actor.
+    continuation_t *continuation_head;
+    continuation_t *continuation_tail;
+    size_t continuation_length;
+    // Metrics, written only by the thread processing the actor.
+    atomic_ullong messages_sent;
+    atomic_ullong messages_processed;
+    atomic_size_t mailbox_high_water;
 } actor_t;
 
-typedef actor_t *actor_dynamic_arr_t;
+// Argument of task of an actor scheduled to process its messages.
+typedef struct actor_task {
+    actor_id_t actor_id;
+    unsigned long long scheduled_ns; // Time of scheduling, if metrics are enabled.
+} actor_task_t;
+
+// Senders waiting for space in mailboxes of actors with ids equal modulo SEND_STRIPES.
+typedef struct send_stripe {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} send_stripe_t;
+
+// Memory of message data from message_payload_alloc.
+typedef struct payload {
+    struct payload *next; // In list of payloads not sent yet, newest first.
+    struct payload *prev;
+    size_t nbytes;
+    int help_depth; // Of the handler which allocated it, see help_actor.
+    _Alignas(max_align_t) char data[];
+} payload_t;
+
+// Payloads allocated by a thread and not sent yet. Sends find them by address of data
+// in a hash table, as data of a message may be any pointer, or no pointer at all,
+// so memory before it cannot be read to tell whether it is a payload.
+typedef struct unsent_payloads {
+    payload_t *newest;
+    payload_t **slots; // Open addressing with linear probing, capacity is a power of two.
+    size_t capacity;
+    size_t count;
+} unsent_payloads_t;
+
+// Sent with a message in place of its payload while tracing.
+typedef struct traced_payload {
+    payload_t *payload;
+    unsigned long long flow_id;
+} traced_payload_t;
 
 static _Thread_local actor_id_t actor_id_thread_local;
+static _Thread_local unsent_payloads_t unsent_payloads_thread_local;
+static _Thread_local bool in_handler_thread_local;
+static _Thread_local int help_depth_thread_local;
+// Actors whose handlers wait to send lower on the stack of this thread.
+static _Thread_local actor_id_t suspended_actors_thread_local[SEND_HELP_DEPTH];
+static send_stripe_t send_stripes_g[SEND_STRIPES];
 static thread_pool_t *thread_pool_ptr_g;
-static actor_dynamic_arr_t actor_array_g;
-static int active_actor_number_g = 0;
-static int all_actor_number_g = 0;
+// Frees tables of unsent payloads of threads when they exit.
+static pthread_once_t unsent_payloads_once_g = PTHREAD_ONCE_INIT;
+static pthread_key_t unsent_payloads_key_g;
+// Actor registry. Segments are allocated on demand and never move,
+// so actors are found by id without locking.
+static _Atomic(actor_t *) actor_segments_g[ACTOR_SEGMENTS];
+static atomic_long all_actor_number_g; // Also the id of the next actor.
+static atomic_long active_actor_number_g;
 static pthread_cond_t all_dead_cond_g;
-static pthread_mutex_t mutex_g;
+static pthread_mutex_t all_dead_mutex_g;
+// Set only while no actor system is running.
+static bool metrics_enabled_g;
+static char *metrics_path_g;
+static unsigned long metrics_interval_ms_g;
+static bool last_metrics_saved_g;
+static actor_system_metrics_t last_metrics_g;
+static bool trace_enabled_g;
 
 actor_id_t actor_id_self() {
     return actor_id_thread_local;
 }
 
-static actor_t create_new_actor(role_t *const role_ptr) {
-    if (pthread_mutex_lock(&mutex_g)) {
-        fatal(__FILE__, __LINE__);
+// Returns slot of actor with given id, allocating its segment if needed.
+static actor_t *actor_slot(actor_id_t actor_id) {
+    _Atomic(actor_t *) *segment_ptr = &actor_segments_g[actor_id / ACTOR_SEGMENT_SIZE];
+    actor_t *segment = atomic_load_explicit(segment_ptr, memory_order_acquire);
+    if (segment == NULL) {
+        actor_t *allocated = (actor_t *) calloc(ACTOR_SEGMENT_SIZE, sizeof(actor_t));
+        if (allocated == NULL) {
+            fatal(__FILE__, __LINE__);
+        }
+        // Another thread may install the segment first.
+        if (atomic_compare_exchange_strong_explicit(segment_ptr,
+                                                    &segment,
+                                                    allocated,
+                                                    memory_order_acq_rel,
+                                                    memory_order_acquire)) {
+            segment = allocated;
+        } else {
+            free(allocated);
+        }
     }
+    return &segment[actor_id % ACTOR_SEGMENT_SIZE];
+}
 
-    actor_t actor;
-    actor.id = dynarray_length(actor_array_g);
-    actor.role_ptr = role_ptr;
-    actor.state = NULL;
-    actor.message_queue = createQueue(sizeof(message_t));
-    actor.alive = true;
-    actor.free = true;
-    actor.free_cond_ptr = (pthread_cond_t *) malloc(sizeof(pthread_cond_t));
-    if (pthread_cond_init(actor.free_cond_ptr, NULL)) {
-        fatal(__FILE__, __LINE__);
+// Returns actor with given id, or NULL if there is no such actor.
+static actor_t *find_actor(actor_id_t actor_id) {
+    if (actor_id < 0 || actor_id >= CAST_LIMIT) {
+        return NULL;
     }
 
-    dynarray_push(actor_array_g, actor);
+    actor_t *segment = atomic_load_explicit(&actor_segments_g[actor_id / ACTOR_SEGMENT_SIZE],
+                                            memory_order_acquire);
+    if (segment == NULL) {
+        return NULL;
+    }
 
-    all_actor_number_g++;
-    if (all_actor_number_g > CAST_LIMIT) {
-        fatal(__FILE__, __LINE__);
+    actor_t *actor = &segment[actor_id % ACTOR_SEGMENT_SIZE];
+    if (!atomic_load_explicit(&actor->ready, memory_order_acquire)) {
+        return NULL;
     }
-    active_actor_number_g++;
+    return actor;
+}
 
-    if (pthread_mutex_unlock(&mutex_g)) {
+static actor_t *create_new_actor(role_t *const role_ptr) {
+    actor_id_t actor_id = atomic_fetch_add(&all_actor_number_g, 1);
+    if (actor_id >= CAST_LIMIT) {
         fatal(__FILE__, __LINE__);
     }
+    atomic_fetch_add(&active_actor_number_g, 1);
+
+    actor_t *actor = actor_slot(actor_id);
+    actor->id = actor_id;
+    actor->role_ptr = role_ptr;
+    actor->state = NULL;
+    actor->mailbox = mailbox_create();
+    atomic_init(&actor->waiting_senders, 0);
+    atomic_init(&actor->runner, RUNNER_IDLE);
+    actor->continuation_head = NULL;
+    actor->continuation_tail = NULL;
+    actor->continuation_length = 0;
+    atomic_init(&actor->messages_sent, 0);
+    atomic_init(&actor->messages_processed, 0);
+    atomic_init(&actor->mailbox_high_water, 0);
+    atomic_store_explicit(&actor->ready, true, memory_order_release);
 
     return actor;
 }
 
 static void process_spawn(const message_t *message_ptr) {
     role_t *role_ptr = (role_t *) message_ptr->data;
-    actor_t actor = create_new_actor(role_ptr);
+    actor_t *actor = create_new_actor(role_ptr);
 
     message_t hello_msg;
     hello_msg.message_type = MSG_HELLO;
@@ -77,95 +207,557 @@ static void process_spawn(const message_t *message_ptr) {
     hello_msg.nbytes = sizeof(self_id);
     hello_msg.data = (void *) self_id;
 
-    if (send_message(actor.id, hello_msg) != 0) {
+    if (send_message(actor->id, hello_msg) != 0) {
         fatal(__FILE__, __LINE__);
     }
 }
 
-static void process_godie() {
-    if (pthread_mutex_lock(&mutex_g)) {
+static size_t unsent_payload_slot(const void *data, size_t capacity) {
+    unsigned long long hash = (unsigned long long) (uintptr_t) data * 0x9e3779b97f4a7c15ull;
+    return (size_t) (hash >> 32) & (capacity - 1);
+}
+
+static void free_unsent_payload_slots(void *slots) {
+    free(slots);
+}
+
+static void create_unsent_payloads_key() {
+    if (pthread_key_create(&unsent_payloads_key_g, free_unsent_payload_slots)) {
         fatal(__FILE__, __LINE__);
     }
+}
+
+static void insert_unsent_payload_slot(unsent_payloads_t *unsent, payload_t *payload) {
+    size_t slot = unsent_payload_slot(payload->data, unsent->capacity);
+    while (unsent->slots[slot] != NULL) {
+        slot = (slot + 1) & (unsent->capacity - 1);
+    }
+    unsent->slots[slot] = payload;
+}
+
+// Table is at most half full, so lookups stop at an empty slot soon.
+static void grow_unsent_payloads(unsent_payloads_t *unsent) {
+    if (unsent->slots == NULL) {
+        if (pthread_once(&unsent_payloads_once_g, create_unsent_payloads_key)) {
+            fatal(__FILE__, __LINE__);
+        }
+    }
 
-    actor_id_t actor_id = actor_id_self();
-    actor_t *actor_ptr = &actor_array_g[actor_id];
-    actor_ptr->alive = false;
+    payload_t **old_slots = unsent->slots;
+    size_t old_capacity = unsent->capacity;
+    unsent->capacity = old_capacity == 0 ? 16 : 2 * old_capacity;
+    unsent->slots = (payload_t **) calloc(unsent->capacity, sizeof(payload_t *));
+    if (unsent->slots == NULL) {
+        fatal(__FILE__, __LINE__);
+    }
+    for (size_t slot = 0; slot < old_capacity; ++slot) {
+        if (old_slots[slot] != NULL) {
+            insert_unsent_payload_slot(unsent, old_slots[slot]);
+        }
+    }
+    free(old_slots);
 
-    if (pthread_mutex_unlock(&mutex_g)) {
+    if (pthread_setspecific(unsent_payloads_key_g, unsent->slots)) {
         fatal(__FILE__, __LINE__);
     }
 }
 
+// Makes payload unsent again, after it was taken by a send which failed.
+static void keep_unsent_payload(payload_t *payload) {
+    unsent_payloads_t *unsent = &unsent_payloads_thread_local;
+    if (2 * (unsent->count + 1) > unsent->capacity) {
+        grow_unsent_payloads(unsent);
+    }
+    insert_unsent_payload_slot(unsent, payload);
+    unsent->count++;
+
+    payload->prev = NULL;
+    payload->next = unsent->newest;
+    if (unsent->newest != NULL) {
+        unsent->newest->prev = payload;
+    }
+    unsent->newest = payload;
+}
+
+// Removes payload from unsent ones, leaving no gap in probe sequences of the others.
+static void remove_unsent_payload(unsent_payloads_t *unsent, size_t slot) {
+    payload_t *payload = unsent->slots[slot];
+    size_t mask = unsent->capacity - 1;
+    size_t next = (slot + 1) & mask;
+    while (unsent->slots[next] != NULL) {
+        size_t home = unsent_payload_slot(unsent->slots[next]->data, unsent->capacity);
+        // Entry moves to the gap if the gap lies between its home slot and its slot.
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            unsent->slots[slot] = unsent->slots[next];
+            slot = next;
+        }
+        next = (next + 1) & mask;
+    }
+    unsent->slots[slot] = NULL;
+    unsent->count--;
+
+    if (payload->prev != NULL) {
+        payload->prev->next = payload->next;
+    } else {
+        unsent->newest = payload->next;
+    }
+    if (payload->next != NULL) {
+        payload->next->prev = payload->prev;
+    }
+}
+
+void *message_payload_alloc(size_t nbytes) {
+    payload_t *payload = (payload_t *) slab_alloc(sizeof(payload_t) + nbytes);
+    payload->nbytes = nbytes;
+    payload->help_depth = help_depth_thread_local;
+    keep_unsent_payload(payload);
+    return payload->data;
+}
+
+static void payload_free(payload_t *payload) {
+    slab_free(payload, sizeof(payload_t) + payload->nbytes);
+}
+
+// Returns payload with given data allocated by the running handler of this thread
+// and not sent yet, removing it from unsent payloads, or NULL if there is no such payload.
+static payload_t *take_unsent_payload(void *data) {
+    unsent_payloads_t *unsent = &unsent_payloads_thread_local;
+    if (unsent->count == 0) {
+        return NULL;
+    }
+
+    size_t slot = unsent_payload_slot(data, unsent->capacity);
+    while (unsent->slots[slot] != NULL) {
+        payload_t *payload = unsent->slots[slot];
+        if (payload->data == data) {
+            if (payload->help_depth != help_depth_thread_local) {
+                return NULL;
+            }
+            remove_unsent_payload(unsent, slot);
+            return payload;
+        }
+        slot = (slot + 1) & (unsent->capacity - 1);
+    }
+    return NULL;
+}
+
+// Frees payloads allocated by the running handler of this thread. Payloads of handlers
+// waiting lower on the stack are older, so they follow these in the list.
+static void free_unsent_payloads() {
+    unsent_payloads_t *unsent = &unsent_payloads_thread_local;
+    while (unsent->newest != NULL && unsent->newest->help_depth == help_depth_thread_local) {
+        payload_t *payload = unsent->newest;
+        size_t slot = unsent_payload_slot(payload->data, unsent->capacity);
+        while (unsent->slots[slot] != payload) {
+            slot = (slot + 1) & (unsent->capacity - 1);
+        }
+        remove_unsent_payload(unsent, slot);
+        payload_free(payload);
+    }
+}
+
+// Returns payload of message sent in given flow to pass through mailbox while tracing.
+static void *trace_wrap(payload_t *payload, unsigned long long flow_id) {
+    traced_payload_t *traced = (traced_payload_t *) slab_alloc(sizeof(traced_payload_t));
+    traced->payload = payload;
+    traced->flow_id = flow_id;
+    return traced;
+}
+
+// Frees payload from trace_wrap, returning the wrapped one and saving its flow id
+// to flow_id, unless it is NULL.
+static payload_t *trace_unwrap(void *traced_ptr, unsigned long long *flow_id) {
+    traced_payload_t *traced = (traced_payload_t *) traced_ptr;
+    payload_t *payload = traced->payload;
+    if (flow_id != NULL) {
+        *flow_id = traced->flow_id;
+    }
+    slab_free(traced, sizeof(traced_payload_t));
+    return payload;
+}
+
+// Records message sent to receiver by the running handler.
+static void trace_sent(actor_id_t receiver,
+                       const message_t *message,
+                       unsigned long long flow_id,
+                       unsigned long long sent_ns) {
+    trace_send(in_handler_thread_local ? actor_id_thread_local : -1,
+               receiver,
+               message->message_type,
+               flow_id,
+               sent_ns);
+}
+
+static void process_godie(mailbox_t *mailbox) {
+    mailbox_close(mailbox);
+}
+
 static void process_message(const message_t *message_ptr,
                             const role_t *role_ptr,
-                            void **state_ptr) {
+                            void **state_ptr,
+                            mailbox_t *mailbox) {
     if (message_ptr->message_type == MSG_SPAWN) {
         process_spawn(message_ptr);
     } else if (message_ptr->message_type == MSG_GODIE) {
-        process_godie();
+        process_godie(mailbox);
     } else {
         act_t *func_ptr = &role_ptr->prompts[message_ptr->message_type];
         (*func_ptr)(state_ptr, message_ptr->nbytes, message_ptr->data);
     }
 }
 
-static void thread_pool_task(void *arg) {
-    actor_id_t actor_id = *(actor_id_t *) arg;
-    actor_id_thread_local = actor_id;
+// Appends message sent by the running actor to itself to its continuation.
+// Returns result as send_message, or 1 if the mailbox has other messages,
+// then the message has to go through it to keep the order.
+static int push_continuation(actor_t *actor, const message_t *message, void *payload) {
+    int result = mailbox_reserve(actor->mailbox, actor->continuation_length);
+    if (result != 0) {
+        return result;
+    }
+
+    continuation_t *continuation = (continuation_t *) slab_alloc(sizeof(continuation_t));
+    continuation->next = NULL;
+    continuation->message = *message;
+    continuation->payload = payload;
+    if (actor->continuation_tail == NULL) {
+        actor->continuation_head = continuation;
+    } else {
+        actor->continuation_tail->next = continuation;
+    }
+    actor->continuation_tail = continuation;
+    actor->continuation_length++;
+    return 0;
+}
+
+static void pop_continuation(actor_t *actor, message_t *message, void **payload) {
+    continuation_t *continuation = actor->continuation_head;
+    *message = continuation->message;
+    *payload = continuation->payload;
+    actor->continuation_head = continuation->next;
+    if (actor->continuation_head == NULL) {
+        actor->continuation_tail = NULL;
+    }
+    actor->continuation_length--;
+    mailbox_release(actor->mailbox);
+    slab_free(continuation, sizeof(continuation_t));
+}
+
+// Wakes senders waiting for space in mailbox of actor.
+static void wake_senders(actor_t *actor) {
+    send_stripe_t *stripe = &send_stripes_g[actor->id % SEND_STRIPES];
 
-    if (pthread_mutex_lock(&mutex_g)) {
+    if (pthread_mutex_lock(&stripe->mutex)) {
         fatal(__FILE__, __LINE__);
     }
 
-    // get actor lock
-    while (!actor_array_g[actor_id].free) {
-        pthread_cond_wait(actor_array_g[actor_id].free_cond_ptr, &mutex_g);
+    if (pthread_cond_broadcast(&stripe->cond)) {
+        fatal(__FILE__, __LINE__);
     }
-    actor_array_g[actor_id].free = false;
 
+    if (pthread_mutex_unlock(&stripe->mutex)) {
+        fatal(__FILE__, __LINE__);
+    }
+}
+
+static actor_task_t make_actor_task(actor_id_t actor_id) {
+    actor_task_t task;
+    task.actor_id = actor_id;
+    task.scheduled_ns = metrics_enabled_g ? metrics_now_ns() : 0;
+    return task;
+}
+
+static void thread_pool_task(void *arg);
+
+static void schedule_actor(actor_id_t actor_id) {
+    actor_task_t task = make_actor_task(actor_id);
+    thread_pool_add_task(thread_pool_ptr_g,
+                         &thread_pool_task,
+                         &task,
+                         sizeof(task));
+}
+
+// Counts messages sent by the handler running on this thread.
+static void count_sent_messages(size_t sent) {
+    if (!metrics_enabled_g || !in_handler_thread_local || sent == 0) {
+        return;
+    }
+
+    actor_t *actor = find_actor(actor_id_thread_local);
+    metrics_counter_add(&actor->messages_sent, sent);
+}
+
+// Updates metrics of actor processing a message, which had depth messages
+// in its mailbox before the message was taken.
+static void count_processed_message(actor_t *actor, size_t depth) {
+    if (depth > atomic_load_explicit(&actor->mailbox_high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&actor->mailbox_high_water, depth, memory_order_relaxed);
+    }
+    metrics_counter_add(&actor->messages_processed, 1);
+}
+
+// Starts processing actor. Returns false if another thread processes it.
+static bool claim_actor(actor_t *actor) {
+    int idle = RUNNER_IDLE;
+    return atomic_compare_exchange_strong(&actor->runner, &idle, RUNNER_BUSY);
+}
+
+// Ends processing actor, adding again its scheduled task parked meanwhile.
+static void release_actor(actor_t *actor) {
+    if (atomic_exchange(&actor->runner, RUNNER_IDLE) == RUNNER_TASK_PARKED) {
+        schedule_actor(actor->id);
+    }
+}
+
+// Processes message taken by actor from its mailbox, which had depth messages before.
+static void run_handler(actor_t *actor,
+                        const message_t *message,
+                        metrics_histograms_t *histograms,
+                        size_t depth) {
+    if (histograms == NULL) {
+        process_message(message, actor->role_ptr, &actor->state, actor->mailbox);
+        return;
+    }
+
+    count_processed_message(actor, depth);
+    unsigned long long start_ns = metrics_now_ns();
+    process_message(message, actor->role_ptr, &actor->state, actor->mailbox);
+    metrics_histogram_add(histograms->handler_time, metrics_now_ns() - start_ns);
+}
+
+// Processes message as run_handler, recording it while tracing.
+// Returns payload of the message wrapped by trace_wrap.
+static payload_t *run_traced_handler(actor_t *actor,
+                                     const message_t *message,
+                                     void *traced,
+                                     metrics_histograms_t *histograms,
+                                     size_t depth) {
+    unsigned long long flow_id;
+    payload_t *payload = trace_unwrap(traced, &flow_id);
+    unsigned long long start_ns = trace_now();
+    run_handler(actor, message, histograms, depth);
+    trace_handler(actor->id, message->message_type, flow_id, start_ns);
+    return payload;
+}
+
+// Processes up to ACTOR_BATCH_SIZE messages of actor claimed by this thread.
+// Returns number of processed messages and sets finished if the actor died.
+static size_t process_messages(actor_t *actor, metrics_histograms_t *histograms, bool *finished) {
+    actor_id_t actor_id = actor->id;
+    actor_id_thread_local = actor_id;
+    in_handler_thread_local = true;
+
+    mailbox_t *mailbox = actor->mailbox;
+
+    // Message not visible yet is processed when the actor is scheduled again.
+    *finished = false;
     message_t message;
-    dequeue(actor_array_g[actor_id].message_queue, &message);
+    void *payload;
+    size_t processed = 0;
+    while (processed < ACTOR_BATCH_SIZE && !*finished) {
+        size_t depth = histograms == NULL ? 0 : mailbox_size(mailbox);
+        if (actor->continuation_head != NULL) {
+            pop_continuation(actor, &message, &payload);
+        } else if (!mailbox_try_pop(mailbox, &message, &payload, NULL)) {
+            break;
+        }
 
-    const role_t *role_ptr = actor_array_g[actor_id].role_ptr;
-    void **state_ptr = &actor_array_g[actor_id].state;
+        if (trace_enabled_g) {
+            payload = run_traced_handler(actor, &message, payload, histograms, depth);
+        } else {
+            run_handler(actor, &message, histograms, depth);
+        }
 
-    if (pthread_mutex_unlock(&mutex_g)) {
-        fatal(__FILE__, __LINE__);
+        if (payload != NULL) {
+            payload_free((payload_t *) payload);
+        }
+        free_unsent_payloads();
+        ++processed;
+        *finished = mailbox_finished(mailbox);
     }
+    in_handler_thread_local = false;
 
-    process_message(&message, role_ptr, state_ptr);
+    // Pairs with senders announcing they wait before they try to push,
+    // so either they see the space or they are woken.
+    if (processed > 0 && atomic_load(&actor->waiting_senders) > 0) {
+        wake_senders(actor);
+    }
 
-    if (pthread_mutex_lock(&mutex_g)) {
-        fatal(__FILE__, __LINE__);
+    return processed;
+}
+
+// Counts a dead actor, waking join after the last one.
+static void count_dead_actor() {
+    // Mutex is taken only by the last actor, so join does not miss it.
+    if (atomic_fetch_sub(&active_actor_number_g, 1) == 1) {
+        if (pthread_mutex_lock(&all_dead_mutex_g)) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        if (pthread_cond_broadcast(&all_dead_cond_g)) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        if (pthread_mutex_unlock(&all_dead_mutex_g)) {
+            fatal(__FILE__, __LINE__);
+        }
     }
+}
 
-    if (getSize(actor_array_g[actor_id].message_queue) == 0
-        && !actor_array_g[actor_id].alive) {
-        active_actor_number_g--;
-        if (active_actor_number_g == 0) {
-            if (pthread_cond_broadcast(&all_dead_cond_g)) {
-                fatal(__FILE__, __LINE__);
-            }
+// Task of an actor scheduled to process its messages.
+// Processes up to ACTOR_BATCH_SIZE messages, then the actor is scheduled again
+// if it has more of them, so other actors are not starved.
+static void thread_pool_task(void *arg) {
+    actor_task_t *task = (actor_task_t *) arg;
+    actor_t *actor = find_actor(task->actor_id);
+
+    // Task coming while a handler waiting to send processes the actor
+    // is added again by it, as the actor stays scheduled.
+    while (!claim_actor(actor)) {
+        int busy = RUNNER_BUSY;
+        if (atomic_compare_exchange_strong(&actor->runner, &busy, RUNNER_TASK_PARKED)) {
+            return;
         }
     }
+    // The actor died while processed by a waiting handler.
+    if (mailbox_finished(actor->mailbox)) {
+        release_actor(actor);
+        return;
+    }
+
+    metrics_histograms_t *histograms = NULL;
+    if (metrics_enabled_g) {
+        histograms = metrics_thread_histograms();
+        metrics_histogram_add(histograms->dispatch_latency, metrics_now_ns() - task->scheduled_ns);
+    }
 
-    // release actor lock
-    actor_array_g[actor_id].free = true;
-    if (pthread_cond_broadcast(actor_array_g[actor_id].free_cond_ptr)) {
+    bool finished;
+    process_messages(actor, histograms, &finished);
+    // Actors are freed after the last one dies, so it is released first.
+    release_actor(actor);
+
+    if (finished) {
+        count_dead_actor();
+    } else if (!mailbox_unschedule(actor->mailbox)) {
+        schedule_actor(actor->id);
+    }
+}
+
+// Saves metrics of the running actor system.
+static void collect_metrics(actor_system_metrics_t *metrics) {
+    long actor_number = atomic_load(&all_actor_number_g);
+    metrics->nactors = 0;
+    metrics->actors = (actor_metrics_t *) malloc(actor_number * sizeof(actor_metrics_t));
+    if (actor_number > 0 && metrics->actors == NULL) {
         fatal(__FILE__, __LINE__);
     }
+    for (actor_id_t actor_id = 0; actor_id < actor_number; ++actor_id) {
+        actor_t *actor = find_actor(actor_id);
+        if (actor == NULL) {
+            continue;
+        }
+
+        actor_metrics_t *actor_metrics = &metrics->actors[metrics->nactors++];
+        actor_metrics->actor = actor_id;
+        actor_metrics->messages_sent = atomic_load_explicit(&actor->messages_sent,
+                                                            memory_order_relaxed);
+        actor_metrics->messages_processed = atomic_load_explicit(&actor->messages_processed,
+                                                                 memory_order_relaxed);
+        actor_metrics->mailbox_high_water = atomic_load_explicit(&actor->mailbox_high_water,
+                                                                 memory_order_relaxed);
+    }
 
-    if (pthread_mutex_unlock(&mutex_g)) {
+    metrics->nworkers = thread_pool_size(thread_pool_ptr_g);
+    metrics->workers = (worker_metrics_t *) malloc(metrics->nworkers * sizeof(worker_metrics_t));
+    if (metrics->nworkers > 0 && metrics->workers == NULL) {
         fatal(__FILE__, __LINE__);
     }
+    for (size_t i = 0; i < metrics->nworkers; ++i) {
+        thread_pool_stats_t stats;
+        thread_pool_stats(thread_pool_ptr_g, i, &stats);
+        metrics->workers[i].busy_ns = stats.busy_ns;
+        metrics->workers[i].idle_ns = stats.idle_ns;
+        metrics->workers[i].tasks = stats.tasks;
+        metrics->workers[i].steals = stats.steals;
+        metrics->workers[i].wakeups = stats.wakeups;
+    }
+
+    memset(metrics->dispatch_latency, 0, sizeof(metrics->dispatch_latency));
+    memset(metrics->handler_time, 0, sizeof(metrics->handler_time));
+    metrics_histograms_sum(metrics);
+}
+
+int actor_system_enable_metrics(const char *path, unsigned long interval_ms) {
+    if (atomic_load(&all_actor_number_g) > 0) {
+        return -1;
+    }
+
+    free(metrics_path_g);
+    metrics_path_g = NULL;
+    if (path != NULL) {
+        metrics_path_g = (char *) malloc(strlen(path) + 1);
+        if (metrics_path_g == NULL) {
+            fatal(__FILE__, __LINE__);
+        }
+        strcpy(metrics_path_g, path);
+    }
+    metrics_interval_ms_g = interval_ms;
+    metrics_enabled_g = true;
+    return 0;
+}
+
+int actor_system_metrics(actor_system_metrics_t *metrics) {
+    if (!metrics_enabled_g) {
+        return -1;
+    }
+
+    if (atomic_load(&all_actor_number_g) > 0) {
+        collect_metrics(metrics);
+    } else if (last_metrics_saved_g) {
+        metrics_copy(metrics, &last_metrics_g);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+void actor_system_metrics_free(actor_system_metrics_t *metrics) {
+    free(metrics->actors);
+    free(metrics->workers);
+    metrics->actors = NULL;
+    metrics->workers = NULL;
+}
+
+int actor_system_enable_trace(const char *path, size_t events_per_thread) {
+    if (atomic_load(&all_actor_number_g) > 0) {
+        return -1;
+    }
+
+    trace_enabled_g = path != NULL;
+    if (trace_enabled_g) {
+        trace_start(path, events_per_thread);
+    }
+    return 0;
 }
 
 int actor_system_create(actor_id_t *actor_id, role_t *const role_ptr) {
-    if (CAST_LIMIT < 1) {
+    actor_system_config_t config;
+    config.min_workers = POOL_SIZE;
+    config.max_workers = POOL_SIZE;
+    config.idle_timeout_ms = POOL_IDLE_TIMEOUT_MS;
+    return actor_system_create_with_config(actor_id, role_ptr, &config);
+}
+
+int actor_system_create_with_config(actor_id_t *actor_id,
+                                    role_t *const role_ptr,
+                                    const actor_system_config_t *config) {
+    if (CAST_LIMIT < 1
+        || config == NULL
+        || config->max_workers < 1
+        || config->min_workers > config->max_workers) {
         return -1;
     }
 
-    if (pthread_mutex_init(&mutex_g, NULL)) {
+    if (pthread_mutex_init(&all_dead_mutex_g, NULL)) {
         fatal(__FILE__, __LINE__);
     }
 
@@ -173,17 +765,51 @@ int actor_system_create(actor_id_t *actor_id, role_t *const role_ptr) {
         fatal(__FILE__, __LINE__);
     }
 
-    thread_pool_ptr_g = thread_pool_init(POOL_SIZE);
-    actor_array_g = dynarray_create(actor_t);
-    actor_t first_actor = create_new_actor(role_ptr);
-    *actor_id = first_actor.id;
+    // Senders wait until deadlines on the monotonic clock.
+    pthread_condattr_t stripe_cond_attr;
+    if (pthread_condattr_init(&stripe_cond_attr)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    if (pthread_condattr_setclock(&stripe_cond_attr, CLOCK_MONOTONIC)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    for (size_t i = 0; i < SEND_STRIPES; ++i) {
+        if (pthread_mutex_init(&send_stripes_g[i].mutex, NULL)) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        if (pthread_cond_init(&send_stripes_g[i].cond, &stripe_cond_attr)) {
+            fatal(__FILE__, __LINE__);
+        }
+    }
+
+    if (pthread_condattr_destroy(&stripe_cond_attr)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    thread_pool_ptr_g = thread_pool_init_elastic(config->min_workers,
+                                                 config->max_workers,
+                                                 config->idle_timeout_ms,
+                                                 POOL_WORK_STEALING
+                                                 ? THREAD_POOL_WORK_STEALING
+                                                 : THREAD_POOL_SHARED_QUEUE);
+    if (metrics_enabled_g) {
+        thread_pool_measure_time(thread_pool_ptr_g, true);
+        if (metrics_path_g != NULL) {
+            metrics_dump_start(metrics_path_g, metrics_interval_ms_g, collect_metrics);
+        }
+    }
+    actor_t *first_actor = create_new_actor(role_ptr);
+    *actor_id = first_actor->id;
 
     message_t hello_msg;
     hello_msg.message_type = MSG_HELLO;
     hello_msg.nbytes = 0;
     hello_msg.data = NULL;
 
-    if (send_message(first_actor.id, hello_msg) != 0) {
+    if (send_message(first_actor->id, hello_msg) != 0) {
         fatal(__FILE__, __LINE__);
     }
 
@@ -191,86 +817,435 @@ int actor_system_create(actor_id_t *actor_id, role_t *const role_ptr) {
 }
 
 static void free_actors() {
-    for (size_t i = 0; i < dynarray_length(actor_array_g); ++i) {
-        actor_t *actor_ptr = &actor_array_g[i];
-        if (pthread_cond_destroy(actor_ptr->free_cond_ptr)) {
-            fatal(__FILE__, __LINE__);
-        }
-        free(actor_ptr->free_cond_ptr);
-        destroyQueue(actor_ptr->message_queue);
+    long actor_number = atomic_load(&all_actor_number_g);
+    for (actor_id_t actor_id = 0; actor_id < actor_number; ++actor_id) {
+        mailbox_destroy(find_actor(actor_id)->mailbox);
     }
 
-    dynarray_destroy(actor_array_g);
+    for (size_t i = 0; i < ACTOR_SEGMENTS; ++i) {
+        free(atomic_load(&actor_segments_g[i]));
+        atomic_store(&actor_segments_g[i], NULL);
+    }
 }
 
 void actor_system_join(actor_id_t actor_id) {
-    if (all_actor_number_g <= actor_id) {
+    if (atomic_load(&all_actor_number_g) <= actor_id) {
         return;
     }
 
-    if (pthread_mutex_lock(&mutex_g)) {
+    if (pthread_mutex_lock(&all_dead_mutex_g)) {
         fatal(__FILE__, __LINE__);
     }
 
-    while (active_actor_number_g > 0) {
-        pthread_cond_wait(&all_dead_cond_g, &mutex_g);
+    while (atomic_load(&active_actor_number_g) > 0) {
+        pthread_cond_wait(&all_dead_cond_g, &all_dead_mutex_g);
     }
 
-    if (pthread_mutex_unlock(&mutex_g)) {
+    if (pthread_mutex_unlock(&all_dead_mutex_g)) {
         fatal(__FILE__, __LINE__);
     }
 
+    // Last metrics are kept, as actors and the pool are freed.
+    if (metrics_enabled_g) {
+        if (last_metrics_saved_g) {
+            actor_system_metrics_free(&last_metrics_g);
+        }
+        collect_metrics(&last_metrics_g);
+        last_metrics_saved_g = true;
+        if (metrics_path_g != NULL) {
+            metrics_dump_stop(&last_metrics_g);
+        }
+    }
+
     thread_pool_shutdown(thread_pool_ptr_g);
+    metrics_histograms_free();
+    if (trace_enabled_g) {
+        trace_finish();
+    }
     free_actors();
-    all_actor_number_g = 0;
-    if (pthread_mutex_destroy(&mutex_g)) {
+    free_unsent_payloads();
+    slab_flush();
+    slab_release();
+    atomic_store(&all_actor_number_g, 0);
+    if (pthread_mutex_destroy(&all_dead_mutex_g)) {
         fatal(__FILE__, __LINE__);
     }
 
     if (pthread_cond_destroy(&all_dead_cond_g)) {
         fatal(__FILE__, __LINE__);
     }
+
+    for (size_t i = 0; i < SEND_STRIPES; ++i) {
+        if (pthread_mutex_destroy(&send_stripes_g[i].mutex)) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        if (pthread_cond_destroy(&send_stripes_g[i].cond)) {
+            fatal(__FILE__, __LINE__);
+        }
+    }
 }
 
 int send_message(actor_id_t actor_id, message_t message) {
-    if (pthread_mutex_lock(&mutex_g)) {
+    return send_message_nonblocking(actor_id, message, NULL);
+}
+
+// Pushes message with payload to mailbox of actor. Message sent by the running actor
+// to itself is processed right after the handler, without the pool.
+static int deliver_message(actor_t *actor, const message_t *message, void *payload, bool *schedule) {
+    if (in_handler_thread_local && actor->id == actor_id_thread_local) {
+        int result = push_continuation(actor, message, payload);
+        if (result != 1) {
+            return result;
+        }
+    }
+    return mailbox_push(actor->mailbox, message, payload, schedule);
+}
+
+// Delivers message as deliver_message, recording it while tracing.
+static int deliver_traced_message(actor_t *actor, const message_t *message, payload_t *payload, bool *schedule) {
+    unsigned long long flow_id = trace_flow_id();
+    unsigned long long sent_ns = trace_now();
+    void *traced = trace_wrap(payload, flow_id);
+    int result = deliver_message(actor, message, traced, schedule);
+    if (result == 0) {
+        trace_sent(actor->id, message, flow_id, sent_ns);
+    } else {
+        trace_unwrap(traced, NULL);
+    }
+    return result;
+}
+
+int send_message_nonblocking(actor_id_t actor_id, message_t message, size_t *depth) {
+    actor_t *actor = find_actor(actor_id);
+    if (actor == NULL) {
+        return -2;
+    }
+
+    // Payload is owned by the message once it is sent.
+    payload_t *payload = message.data == NULL ? NULL : take_unsent_payload(message.data);
+    bool schedule = false;
+    int result = trace_enabled_g
+        ? deliver_traced_message(actor, &message, payload, &schedule)
+        : deliver_message(actor, &message, payload, &schedule);
+    if (depth != NULL) {
+        *depth = mailbox_size(actor->mailbox);
+    }
+    if (result != 0) {
+        if (payload != NULL) {
+            keep_unsent_payload(payload);
+        }
+        return result;
+    }
+    count_sent_messages(1);
+
+    // Actor is scheduled only when it has nothing else to process.
+    if (schedule) {
+        schedule_actor(actor_id);
+    }
+
+    return 0;
+}
+
+// Pushes message without payload to mailbox of actor, recording it if tracing.
+static int push_message(actor_t *actor, const message_t *message, bool *schedule) {
+    if (!trace_enabled_g) {
+        return mailbox_push(actor->mailbox, message, NULL, schedule);
+    }
+
+    unsigned long long flow_id = trace_flow_id();
+    unsigned long long sent_ns = trace_now();
+    void *traced = trace_wrap(NULL, flow_id);
+    int result = mailbox_push(actor->mailbox, message, traced, schedule);
+    if (result == 0) {
+        trace_sent(actor->id, message, flow_id, sent_ns);
+    } else {
+        trace_unwrap(traced, NULL);
+    }
+    return result;
+}
+
+int send_messages(actor_id_t *actor_ids, size_t n, message_t message, int *results) {
+    int first_error = 0;
+    actor_task_t scheduled[SEND_BATCH_SIZE];
+    size_t scheduled_number = 0;
+    size_t sent = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        actor_t *actor = find_actor(actor_ids[i]);
+        bool schedule = false;
+        int result = actor == NULL
+            ? -2
+            : push_message(actor, &message, &schedule);
+
+        if (results != NULL) {
+            results[i] = result;
+        }
+        if (result == 0) {
+            ++sent;
+        } else if (first_error == 0) {
+            first_error = result;
+        }
+
+        if (schedule) {
+            scheduled[scheduled_number++] = make_actor_task(actor_ids[i]);
+        }
+        if (scheduled_number == SEND_BATCH_SIZE || (i == n - 1 && scheduled_number > 0)) {
+            thread_pool_add_tasks(thread_pool_ptr_g,
+                                  &thread_pool_task,
+                                  scheduled,
+                                  sizeof(actor_task_t),
+                                  scheduled_number);
+            scheduled_number = 0;
+        }
+    }
+
+    count_sent_messages(sent);
+    return first_error;
+}
+
+// Pushes n messages with payloads to mailbox of actor as mailbox_push_many, recording
+// them while tracing. Payloads of messages not pushed are left in payloads.
+static int push_traced_batch(actor_t *actor,
+                             const message_t *messages,
+                             void **payloads,
+                             size_t n,
+                             size_t *pushed,
+                             bool *schedule) {
+    unsigned long long flow_ids[SEND_BATCH_SIZE];
+    unsigned long long sent_ns = trace_now();
+    for (size_t i = 0; i < n; ++i) {
+        flow_ids[i] = trace_flow_id();
+        payloads[i] = trace_wrap((payload_t *) payloads[i], flow_ids[i]);
+    }
+
+    int result = mailbox_push_many(actor->mailbox, messages, payloads, n, pushed, schedule);
+    for (size_t i = 0; i < *pushed; ++i) {
+        trace_sent(actor->id, &messages[i], flow_ids[i], sent_ns);
+    }
+    for (size_t i = *pushed; i < n; ++i) {
+        payloads[i] = trace_unwrap(payloads[i], NULL);
+    }
+    return result;
+}
+
+int send_message_batch(actor_id_t actor_id, const message_t *messages, size_t n, size_t *sent) {
+    *sent = 0;
+    actor_t *actor = find_actor(actor_id);
+    if (actor == NULL) {
+        return n == 0 ? 0 : -2;
+    }
+
+    bool scheduled = false;
+    int result = 0;
+    while (*sent < n && result == 0) {
+        size_t chunk = n - *sent < SEND_BATCH_SIZE ? n - *sent : SEND_BATCH_SIZE;
+        void *payloads[SEND_BATCH_SIZE];
+        for (size_t i = 0; i < chunk; ++i) {
+            void *data = messages[*sent + i].data;
+            payloads[i] = data == NULL ? NULL : take_unsent_payload(data);
+        }
+
+        size_t pushed;
+        bool schedule;
+        result = trace_enabled_g
+            ? push_traced_batch(actor, &messages[*sent], payloads, chunk, &pushed, &schedule)
+            : mailbox_push_many(actor->mailbox, &messages[*sent], payloads, chunk, &pushed, &schedule);
+        scheduled = scheduled || schedule;
+
+        // Payloads of messages not sent stay with the sender.
+        for (size_t i = pushed; i < chunk; ++i) {
+            if (payloads[i] != NULL) {
+                keep_unsent_payload((payload_t *) payloads[i]);
+            }
+        }
+        *sent += pushed;
+    }
+    count_sent_messages(*sent);
+
+    if (scheduled) {
+        schedule_actor(actor_id);
+    }
+
+    return result;
+}
+
+// Saves time timeout_ms milliseconds from now to deadline. Deadlines are measured
+// on the monotonic clock, as are waits on send stripes, so changes of system time
+// do not shorten or extend them.
+static void deadline_after(unsigned long timeout_ms, struct timespec *deadline) {
+    if (clock_gettime(CLOCK_MONOTONIC, deadline)) {
         fatal(__FILE__, __LINE__);
     }
+    deadline->tv_sec += (time_t) (timeout_ms / 1000);
+    deadline->tv_nsec += (long) (timeout_ms % 1000) * 1000000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
 
-    if (actor_id < 0 || dynarray_length(actor_array_g) <= (size_t) actor_id) {
-        if (pthread_mutex_unlock(&mutex_g)) {
-            fatal(__FILE__, __LINE__);
+static bool deadline_before(const struct timespec *first, const struct timespec *second) {
+    return first->tv_sec < second->tv_sec
+        || (first->tv_sec == second->tv_sec && first->tv_nsec < second->tv_nsec);
+}
+
+static bool deadline_passed(const struct timespec *deadline) {
+    if (deadline == NULL) {
+        return false;
+    }
+
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now)) {
+        fatal(__FILE__, __LINE__);
+    }
+    return !deadline_before(&now, deadline);
+}
+
+// Returns true if handler of actor waits to send lower on the stack of this thread.
+static bool is_suspended(actor_id_t actor_id) {
+    for (int i = 0; i < help_depth_thread_local; ++i) {
+        if (suspended_actors_thread_local[i] == actor_id) {
+            return true;
         }
-        return -2;
+    }
+    return false;
+}
+
+// Processes messages of actor which the current handler waits to send to,
+// if no other thread processes it. Tasks of other actors are not run here,
+// as they might wait for actors suspended on this stack, which cannot run
+// until they return. Returns false if no message was processed.
+static bool help_actor(actor_t *actor) {
+    if (help_depth_thread_local >= SEND_HELP_DEPTH || !claim_actor(actor)) {
+        return false;
+    }
+    if (mailbox_finished(actor->mailbox)) {
+        release_actor(actor);
+        return false;
+    }
+
+    actor_id_t actor_id = actor_id_thread_local;
+    suspended_actors_thread_local[help_depth_thread_local++] = actor_id;
+
+    bool finished;
+    size_t processed = process_messages(actor,
+                                        metrics_enabled_g ? metrics_thread_histograms() : NULL,
+                                        &finished);
+    release_actor(actor);
+    if (finished) {
+        count_dead_actor();
     }
 
-    actor_t *actor_ptr = &actor_array_g[actor_id];
+    help_depth_thread_local--;
+    in_handler_thread_local = true;
+    actor_id_thread_local = actor_id;
+    return processed > 0;
+}
+
+// Sends message from a handler, or sleeps until senders of actor are woken
+// or until deadline. Returns result of the send.
+static int send_or_sleep(actor_t *actor, message_t message, const struct timespec *deadline) {
+    send_stripe_t *stripe = &send_stripes_g[actor->id % SEND_STRIPES];
+    atomic_fetch_add(&actor->waiting_senders, 1);
+
+    if (pthread_mutex_lock(&stripe->mutex)) {
+        fatal(__FILE__, __LINE__);
+    }
 
-    if (!actor_ptr->alive) {
-        if (pthread_mutex_unlock(&mutex_g)) {
+    int result = send_message(actor->id, message);
+    if (result == -3) {
+        int wait_result = pthread_cond_timedwait(&stripe->cond, &stripe->mutex, deadline);
+        if (wait_result && wait_result != ETIMEDOUT) {
             fatal(__FILE__, __LINE__);
         }
-        return -1;
     }
 
-    size_t queue_size = getSize(actor_ptr->message_queue);
+    if (pthread_mutex_unlock(&stripe->mutex)) {
+        fatal(__FILE__, __LINE__);
+    }
 
-    if (queue_size >= ACTOR_QUEUE_LIMIT) {
-        if (pthread_mutex_unlock(&mutex_g)) {
-            fatal(__FILE__, __LINE__);
+    atomic_fetch_sub(&actor->waiting_senders, 1);
+    return result;
+}
+
+// Sends message, waiting for space in full mailbox until deadline,
+// or without limit if deadline is NULL.
+static int send_message_waiting(actor_id_t actor_id,
+                                message_t message,
+                                const struct timespec *deadline) {
+    int result = send_message(actor_id, message);
+    if (result != -3) {
+        return result;
+    }
+
+    // Handler does not sleep long, as the actor it waits for may need its thread.
+    // It processes messages of the actor instead. Tasks of other actors are run
+    // meanwhile by threads the pool starts, as this one is neither idle nor asleep.
+    if (in_handler_thread_local) {
+        // Only this handler would make space in its own mailbox,
+        // and handlers suspended below it run only after it returns.
+        if (actor_id == actor_id_self() || is_suspended(actor_id)) {
+            return -3;
         }
-        return -3;
+
+        actor_t *actor = find_actor(actor_id);
+        while (result == -3 && !deadline_passed(deadline)) {
+            if (help_actor(actor)) {
+                result = send_message(actor_id, message);
+                continue;
+            }
+
+            // Another thread processes the actor and wakes senders after it.
+            // Sleep is bounded, so the actor is helped if that thread leaves it.
+            struct timespec sleep_deadline;
+            deadline_after(SEND_HELP_WAIT_MS, &sleep_deadline);
+            if (deadline != NULL && deadline_before(deadline, &sleep_deadline)) {
+                sleep_deadline = *deadline;
+            }
+            result = send_or_sleep(actor, message, &sleep_deadline);
+        }
+        return result;
     }
 
-    enqueue(actor_ptr->message_queue, &message);
-    thread_pool_add_task(thread_pool_ptr_g,
-                         &thread_pool_task,
-                         &actor_id,
-                         sizeof(actor_id));
+    actor_t *actor = find_actor(actor_id);
+    send_stripe_t *stripe = &send_stripes_g[actor_id % SEND_STRIPES];
+    atomic_fetch_add(&actor->waiting_senders, 1);
 
-    if (pthread_mutex_unlock(&mutex_g)) {
+    if (pthread_mutex_lock(&stripe->mutex)) {
         fatal(__FILE__, __LINE__);
     }
 
-    return 0;
+    while ((result = send_message(actor_id, message)) == -3) {
+        if (deadline == NULL) {
+            if (pthread_cond_wait(&stripe->cond, &stripe->mutex)) {
+                fatal(__FILE__, __LINE__);
+            }
+        } else {
+            int wait_result = pthread_cond_timedwait(&stripe->cond, &stripe->mutex, deadline);
+            if (wait_result == ETIMEDOUT) {
+                result = send_message(actor_id, message);
+                break;
+            } else if (wait_result) {
+                fatal(__FILE__, __LINE__);
+            }
+        }
+    }
+
+    if (pthread_mutex_unlock(&stripe->mutex)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    atomic_fetch_sub(&actor->waiting_senders, 1);
+    return result;
+}
+
+int send_message_blocking(actor_id_t actor_id, message_t message) {
+    return send_message_waiting(actor_id, message, NULL);
+}
+
+int send_message_timed(actor_id_t actor_id, message_t message, unsigned long timeout_ms) {
+    struct timespec deadline;
+    deadline_after(timeout_ms, &deadline);
+    return send_message_waiting(actor_id, message, &deadline);
 }
@@ -13,6 +13,11 @@ typedef long message_type_t;
 #define ACTOR_QUEUE_LIMIT 1024
 #endif
 
+// Maximal number of messages processed by an actor before other actors run.
+#ifndef ACTOR_BATCH_SIZE
+#define ACTOR_BATCH_SIZE 64
+#endif
+
 #ifndef CAST_LIMIT
 #define CAST_LIMIT 1048576
 #endif
@@ -21,6 +26,21 @@ typedef long message_type_t;
 #define POOL_SIZE 3
 #endif
 
+// Time in milliseconds after which idle threads above the minimal number stop.
+#ifndef POOL_IDLE_TIMEOUT_MS
+#define POOL_IDLE_TIMEOUT_MS 1000
+#endif
+
+// Nonzero to give every pool thread its own task deque, zero for one shared queue.
+#ifndef POOL_WORK_STEALING
+#define POOL_WORK_STEALING 1
+#endif
+
+// Number of buckets of metrics histograms. Bucket i counts durations
+// shorter than 2^i nanoseconds and not shorter than 2^(i-1),
+// the last one also all longer durations.
+#define METRICS_HISTOGRAM_BUCKETS 40
+
 typedef struct message {
     message_type_t message_type;
     size_t nbytes;
@@ -38,10 +58,111 @@ typedef struct role {
     act_t *prompts;
 } role_t;
 
+// Number of threads running actors. Threads are added up to max_workers
+// when actors wait to run while all threads are busy or blocked in handlers.
+typedef struct actor_system_config {
+    size_t min_workers;            // Threads running from the start.
+    size_t max_workers;            // At least 1 and not less than min_workers.
+    unsigned long idle_timeout_ms; // Threads above min_workers idle this long stop,
+                                   // 0 to keep them.
+} actor_system_config_t;
+
 int actor_system_create(actor_id_t *actor, role_t *const role);
 
+// Creates actor system as actor_system_create, which runs POOL_SIZE threads,
+// with number of threads given by config. Returns -1 if config is invalid.
+int actor_system_create_with_config(actor_id_t *actor,
+                                    role_t *const role,
+                                    const actor_system_config_t *config);
+
 void actor_system_join(actor_id_t actor);
 
 int send_message(actor_id_t actor, message_t message);
 
-#endif
\ No newline at end of file
+// Sends message to n actors with given ids, as send_message to each of them,
+// but schedules the actors and wakes threads once for many of them.
+// Saves the result of every send to results, unless it is NULL.
+// Returns 0 if message was sent to all actors, or the first error otherwise.
+// Data from message_payload_alloc cannot be sent to many actors.
+int send_messages(actor_id_t *actors, size_t n, message_t message, int *results);
+
+// Sends n messages to actor in order, as send_message each of them,
+// but reserves space in its mailbox for many of them at once.
+// Stops at the first message which cannot be sent and saves number of sent ones to sent.
+// Returns 0 if all messages were sent, or result of sending the first unsent one.
+int send_message_batch(actor_id_t actor, const message_t *messages, size_t n, size_t *sent);
+
+// Like send_message, and saves number of messages in the mailbox of actor to depth,
+// unless it is NULL, so senders can slow down before the mailbox is full.
+int send_message_nonblocking(actor_id_t actor, message_t message, size_t *depth);
+
+// Like send_message, but waits for space in full mailbox instead of returning -3.
+// Outside of actors the caller sleeps. Handlers process messages of the receiving
+// actor meanwhile, or sleep for short times while another thread does, and return -3
+// at once when the mailbox of their own actor, or of an actor whose handler waits
+// on the same thread, is full.
+int send_message_blocking(actor_id_t actor, message_t message);
+
+// Like send_message_blocking, but returns -3 if the mailbox is still full
+// after timeout_ms milliseconds.
+int send_message_timed(actor_id_t actor, message_t message, unsigned long timeout_ms);
+
+// Allocates nbytes for data of a message, which is freed by the runtime
+// after the receiving actor processes the message. Data has to be sent once
+// by send_message from the thread which allocated it. Data not sent
+// when an actor finishes processing a message is freed then.
+// Receiver must not use the data after its handler returns.
+void *message_payload_alloc(size_t nbytes);
+
+// Metrics of an actor.
+typedef struct actor_metrics {
+    actor_id_t actor;
+    unsigned long long messages_sent;      // By handlers of the actor.
+    unsigned long long messages_processed;
+    size_t mailbox_high_water;             // Most messages seen in mailbox when processing.
+} actor_metrics_t;
+
+// Metrics of a thread of the pool.
+typedef struct worker_metrics {
+    unsigned long long busy_ns;  // Running tasks of actors.
+    unsigned long long idle_ns;  // Sleeping while there were no tasks.
+    unsigned long long tasks;
+    unsigned long long steals;   // Tasks taken from other threads.
+    unsigned long long wakeups;
+} worker_metrics_t;
+
+typedef struct actor_system_metrics {
+    size_t nactors;
+    actor_metrics_t *actors;
+    size_t nworkers;
+    worker_metrics_t *workers;
+    // Time from scheduling an actor with new messages until a thread runs it.
+    unsigned long long dispatch_latency[METRICS_HISTOGRAM_BUCKETS];
+    // Time of handlers, including actors they helped while waiting to send.
+    unsigned long long handler_time[METRICS_HISTOGRAM_BUCKETS];
+} actor_system_metrics_t;
+
+// Enables metrics of actor systems created later. Counters are kept
+// by the threads updating them, so they do not share memory.
+// If path is not NULL, metrics are written to file at path every interval_ms
+// milliseconds, or only at actor_system_join if interval_ms is 0.
+// Returns -1 if an actor system is running, 0 otherwise.
+int actor_system_enable_metrics(const char *path, unsigned long interval_ms);
+
+// Saves metrics of the running actor system, or of the last joined one,
+// to metrics, which have to be freed with actor_system_metrics_free.
+// Counters updated meanwhile may be missed. Must not be called during join.
+// Returns -1 if metrics are not enabled or no actor system ran, 0 otherwise.
+int actor_system_metrics(actor_system_metrics_t *metrics);
+
+void actor_system_metrics_free(actor_system_metrics_t *metrics);
+
+// Enables tracing of actor systems created later. Handlers run by every thread
+// and messages sent between actors are written to file at path at actor_system_join,
+// as Chrome trace event JSON for chrome://tracing or Perfetto.
+// Every thread keeps its newest events_per_thread events.
+// If path is NULL, tracing is disabled.
+// Returns -1 if an actor system is running, 0 otherwise.
+int actor_system_enable_trace(const char *path, size_t events_per_thread);
+
+#endif
@@ -0,0 +1,121 @@
+#include "deque.h"
+#include "err.h"
+
+#include <stdlib.h>
+
+#define DEQUE_INITIAL_CAPACITY 64
+
+static deque_array_t *deque_array_create(size_t capacity) {
+    deque_array_t *array = (deque_array_t *) malloc(
+        sizeof(deque_array_t) + capacity * sizeof(_Atomic(void *)));
+    if (array == NULL) {
+        fatal(__FILE__, __LINE__);
+    }
+    array->capacity = capacity;
+    array->retired = NULL;
+    return array;
+}
+
+void deque_init(deque_t *deque) {
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, deque_array_create(DEQUE_INITIAL_CAPACITY));
+}
+
+void deque_destroy(deque_t *deque) {
+    deque_array_t *array = atomic_load(&deque->array);
+    while (array != NULL) {
+        deque_array_t *retired = array->retired;
+        free(array);
+        array = retired;
+    }
+}
+
+// Replaces array with one twice as big, holding elements from top to bottom.
+static deque_array_t *deque_grow(deque_t *deque,
+                                 deque_array_t *array,
+                                 long top,
+                                 long bottom) {
+    deque_array_t *grown = deque_array_create(2 * array->capacity);
+    for (long i = top; i < bottom; ++i) {
+        void *element = atomic_load_explicit(&array->elements[i % array->capacity],
+                                             memory_order_relaxed);
+        atomic_store_explicit(&grown->elements[i % grown->capacity],
+                              element,
+                              memory_order_relaxed);
+    }
+    grown->retired = array;
+    atomic_store_explicit(&deque->array, grown, memory_order_release);
+    return grown;
+}
+
+void deque_push(deque_t *deque, void *element) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    deque_array_t *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+    if (bottom - top > (long) array->capacity - 1) {
+        array = deque_grow(deque, array, top, bottom);
+    }
+
+    atomic_store_explicit(&array->elements[bottom % array->capacity],
+                          element,
+                          memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+}
+
+void *deque_take(deque_t *deque) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    deque_array_t *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    void *element = atomic_load_explicit(&array->elements[bottom % array->capacity],
+                                         memory_order_relaxed);
+    if (top == bottom) {
+        // Last element, thieves may be taking it too.
+        if (!atomic_compare_exchange_strong_explicit(&deque->top,
+                                                     &top,
+                                                     top + 1,
+                                                     memory_order_seq_cst,
+                                                     memory_order_relaxed)) {
+            element = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return element;
+}
+
+void *deque_steal(deque_t *deque) {
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (top >= bottom) {
+        return NULL;
+    }
+
+    deque_array_t *array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    void *element = atomic_load_explicit(&array->elements[top % array->capacity],
+                                         memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top,
+                                                 &top,
+                                                 top + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return NULL;
+    }
+    return element;
+}
+
+size_t deque_size(deque_t *deque) {
+    long bottom = atomic_load(&deque->bottom);
+    long top = atomic_load(&deque->top);
+    return bottom > top ? (size_t) (bottom - top) : 0;
+}
@@ -0,0 +1,43 @@
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+typedef struct deque_array {
+    size_t capacity;
+    struct deque_array *retired; // Smaller array this one replaced.
+    _Atomic(void *) elements[];
+} deque_array_t;
+
+// Chase-Lev work-stealing deque of pointers, as described in
+// "Correct and Efficient Work-Stealing for Weak Memory Models" by Le et al.
+// Only the owner pushes and takes at the bottom, other threads steal from the top.
+// Arrays replaced when the deque grows are freed when it is destroyed,
+// as thieves may still read them.
+typedef struct deque {
+    atomic_long top;
+    atomic_long bottom;
+    _Atomic(deque_array_t *) array;
+} deque_t;
+
+// Initializes an empty deque.
+void deque_init(deque_t *deque);
+
+// Frees memory of deque. Elements left in it are not freed.
+void deque_destroy(deque_t *deque);
+
+// Adds element at the bottom. Only for the owner.
+void deque_push(deque_t *deque, void *element);
+
+// Removes and returns element from the bottom, or NULL if deque is empty. Only for the owner.
+void *deque_take(deque_t *deque);
+
+// Removes and returns element from the top, or NULL if deque is empty
+// or another thread took the element first.
+void *deque_steal(deque_t *deque);
+
+// Returns number of elements in deque, which may already have changed.
+size_t deque_size(deque_t *deque);
+
+#endif
@@ -1,5 +1,238 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
 #include "cacti.h"
+#include "err.h"
+
+#define ignore (void)
+
+#define MSG_COLUMN_READY (message_type_t)1
+#define MSG_START (message_type_t)2
+#define MSG_ROW (message_type_t)3
+#define MSG_ROW_DONE (message_type_t)4
+
+// Rows passing through columns at once. Next rows are sent as they are done,
+// so mailboxes never fill up with rows.
+#define ROWS_IN_FLIGHT 256
+
+// Reads k rows and n columns of a matrix, then k * n cells in rows order,
+// each as its value and time in milliseconds needed to compute it.
+// Every column is computed by its own actor and rows pass through columns
+// in order, so rows are summed in parallel. Prints sums of rows.
+
+void coordinator_hello(void **stateptr, size_t nbytes, void *data);
+void column_hello(void **stateptr, size_t nbytes, void *data);
+void process_column_ready(void **stateptr, size_t nbytes, void *data);
+void process_start(void **stateptr, size_t nbytes, void *data);
+void process_row(void **stateptr, size_t nbytes, void *data);
+void process_row_done(void **stateptr, size_t nbytes, void *data);
+
+static unsigned long k_g;
+static unsigned long n_g;
+static long *values_g;
+static unsigned long *times_g;
+static long long *sums_g;
+// Written only by the coordinator.
+static actor_id_t *columns_g;
+static unsigned long ready_columns_g;
+static unsigned long sent_rows_g;
+static unsigned long done_rows_g;
+
+static act_t coordinator_prompts_g[] = {
+    coordinator_hello,
+    process_column_ready,
+    process_start,
+    process_row,
+    process_row_done
+};
+static role_t coordinator_role_g = {
+    .nprompts = 5,
+    .prompts = coordinator_prompts_g
+};
+static act_t column_prompts_g[] = {
+    column_hello,
+    process_column_ready,
+    process_start,
+    process_row,
+    process_row_done
+};
+static role_t column_role_g = {
+    .nprompts = 5,
+    .prompts = column_prompts_g
+};
+
+message_t make_message(message_type_t type, void *data) {
+    message_t message;
+    message.message_type = type;
+    message.data = data;
+    message.nbytes = 0;
+    return message;
+}
+
+message_t make_spawn_msg(role_t *role_ptr) {
+    message_t message;
+    message.message_type = MSG_SPAWN;
+    message.data = (void *) role_ptr;
+    message.nbytes = sizeof(role_t);
+    return message;
+}
+
+void send_or_fail(actor_id_t actor, message_t message) {
+    if (send_message_blocking(actor, message) != 0) {
+        fatal(__FILE__, __LINE__);
+    }
+}
+
+// Sums are printed and all actors die once every row passed all columns.
+void finish() {
+    for (unsigned long row = 0; row < k_g; ++row) {
+        printf("%lld\n", sums_g[row]);
+    }
+
+    for (unsigned long column = 0; column < n_g; ++column) {
+        send_or_fail(columns_g[column], make_message(MSG_GODIE, NULL));
+    }
+    send_or_fail(actor_id_self(), make_message(MSG_GODIE, NULL));
+}
+
+void coordinator_hello(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+    ignore nbytes;
+    ignore data;
+
+    columns_g[n_g] = actor_id_self();
+    if (n_g == 0) {
+        finish();
+        return;
+    }
+
+    for (unsigned long column = 0; column < n_g; ++column) {
+        send_or_fail(actor_id_self(), make_spawn_msg(&column_role_g));
+    }
+}
+
+void column_hello(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+    ignore nbytes;
+
+    send_or_fail((actor_id_t) data, make_message(MSG_COLUMN_READY, (void *) actor_id_self()));
+}
+
+// Columns get indices in order they are ready, then first rows are sent to the first one.
+// Every column gets its index before any row, as rows come later from other columns.
+void process_column_ready(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+    ignore nbytes;
+
+    columns_g[ready_columns_g++] = (actor_id_t) data;
+    if (ready_columns_g < n_g) {
+        return;
+    }
+
+    for (unsigned long column = 0; column < n_g; ++column) {
+        send_or_fail(columns_g[column], make_message(MSG_START, (void *) column));
+    }
+
+    if (k_g == 0) {
+        finish();
+        return;
+    }
+
+    while (sent_rows_g < k_g && sent_rows_g < ROWS_IN_FLIGHT) {
+        send_or_fail(columns_g[0], make_message(MSG_ROW, (void *) sent_rows_g++));
+    }
+}
+
+void process_start(void **stateptr, size_t nbytes, void *data) {
+    ignore nbytes;
+
+    *stateptr = data;
+}
+
+void process_row(void **stateptr, size_t nbytes, void *data) {
+    ignore nbytes;
+
+    unsigned long column = (unsigned long) *stateptr;
+    unsigned long row = (unsigned long) data;
+    unsigned long cell = row * n_g + column;
+
+    struct timespec time;
+    time.tv_sec = (time_t) (times_g[cell] / 1000);
+    time.tv_nsec = (long) (times_g[cell] % 1000) * 1000000;
+    while (nanosleep(&time, &time) != 0) {
+        if (errno != EINTR) {
+            fatal(__FILE__, __LINE__);
+        }
+    }
+
+    // Row is in one column at a time, messages order writes to its sum.
+    sums_g[row] += values_g[cell];
+
+    if (column + 1 < n_g) {
+        send_or_fail(columns_g[column + 1], make_message(MSG_ROW, data));
+    } else {
+        send_or_fail(columns_g[n_g], make_message(MSG_ROW_DONE, data));
+    }
+}
+
+void process_row_done(void **stateptr, size_t nbytes, void *data) {
+    ignore stateptr;
+    ignore nbytes;
+    ignore data;
+
+    if (++done_rows_g == k_g) {
+        finish();
+    } else if (sent_rows_g < k_g) {
+        send_or_fail(columns_g[0], make_message(MSG_ROW, (void *) sent_rows_g++));
+    }
+}
+
+void read_unsigned_long(unsigned long *value) {
+    if (scanf("%lu", value) != 1) {
+        fatal(__FILE__, __LINE__);
+    }
+}
+
+void global_init() {
+    read_unsigned_long(&k_g);
+    read_unsigned_long(&n_g);
+
+    values_g = (long *) malloc(k_g * n_g * sizeof(long));
+    times_g = (unsigned long *) malloc(k_g * n_g * sizeof(unsigned long));
+    sums_g = (long long *) calloc(k_g, sizeof(long long));
+    // The last one is the coordinator.
+    columns_g = (actor_id_t *) malloc((n_g + 1) * sizeof(actor_id_t));
+    if ((k_g * n_g > 0 && (values_g == NULL || times_g == NULL))
+        || (k_g > 0 && sums_g == NULL)
+        || columns_g == NULL) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    for (unsigned long cell = 0; cell < k_g * n_g; ++cell) {
+        if (scanf("%ld %lu", &values_g[cell], &times_g[cell]) != 2) {
+            fatal(__FILE__, __LINE__);
+        }
+    }
+}
+
+void global_destroy() {
+    free(values_g);
+    free(times_g);
+    free(sums_g);
+    free(columns_g);
+}
+
+int main() {
+    global_init();
+
+    actor_id_t coordinator_id;
+    if (actor_system_create(&coordinator_id, &coordinator_role_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+    actor_system_join(coordinator_id);
 
-int main(){
-	return 0;
+    global_destroy();
+    return 0;
 }
@@ -0,0 +1,189 @@
+#include "mailbox.h"
+#include "err.h"
+#include "slab.h"
+
+#include <stdlib.h>
+
+#define MAILBOX_CLOSED ((size_t) 1 << (sizeof(size_t) * 8 - 1))
+#define MAILBOX_SCHEDULED ((size_t) 1 << (sizeof(size_t) * 8 - 2))
+#define MAILBOX_FLAGS (MAILBOX_CLOSED | MAILBOX_SCHEDULED)
+
+mailbox_t *mailbox_create() {
+    mailbox_t *mailbox = (mailbox_t *) malloc(sizeof(mailbox_t));
+    if (mailbox == NULL) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    atomic_init(&mailbox->stub.next, NULL);
+    atomic_init(&mailbox->tail, &mailbox->stub);
+    mailbox->head = &mailbox->stub;
+    atomic_init(&mailbox->state, 0);
+
+    return mailbox;
+}
+
+void mailbox_destroy(mailbox_t *mailbox) {
+    mailbox_node_t *node = mailbox->head;
+    while (node != NULL) {
+        mailbox_node_t *next = atomic_load(&node->next);
+        if (node != &mailbox->stub) {
+            slab_free(node, sizeof(mailbox_node_t));
+        }
+        node = next;
+    }
+
+    free(mailbox);
+}
+
+int mailbox_push(mailbox_t *mailbox, const message_t *message, void *payload, bool *schedule) {
+    // Place is reserved before the message is linked,
+    // so the limit holds for concurrent producers.
+    size_t state = atomic_load(&mailbox->state);
+    do {
+        if (state & MAILBOX_CLOSED) {
+            return -1;
+        }
+        if ((state & ~MAILBOX_FLAGS) >= ACTOR_QUEUE_LIMIT) {
+            return -3;
+        }
+    } while (!atomic_compare_exchange_weak(&mailbox->state,
+                                           &state,
+                                           (state + 1) | MAILBOX_SCHEDULED));
+    *schedule = !(state & MAILBOX_SCHEDULED);
+
+    mailbox_node_t *node = (mailbox_node_t *) slab_alloc(sizeof(mailbox_node_t));
+    node->message = *message;
+    node->payload = payload;
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+
+    mailbox_node_t *previous = atomic_exchange_explicit(&mailbox->tail,
+                                                        node,
+                                                        memory_order_acq_rel);
+    atomic_store_explicit(&previous->next, node, memory_order_release);
+
+    return 0;
+}
+
+int mailbox_push_many(mailbox_t *mailbox,
+                      const message_t *messages,
+                      void *const *payloads,
+                      size_t n,
+                      size_t *pushed,
+                      bool *schedule) {
+    *pushed = 0;
+    *schedule = false;
+    if (n == 0) {
+        return 0;
+    }
+
+    size_t state = atomic_load(&mailbox->state);
+    size_t reserved;
+    do {
+        if (state & MAILBOX_CLOSED) {
+            return -1;
+        }
+        size_t size = state & ~MAILBOX_FLAGS;
+        if (size >= ACTOR_QUEUE_LIMIT) {
+            return -3;
+        }
+        reserved = ACTOR_QUEUE_LIMIT - size < n ? ACTOR_QUEUE_LIMIT - size : n;
+    } while (!atomic_compare_exchange_weak(&mailbox->state,
+                                           &state,
+                                           (state + reserved) | MAILBOX_SCHEDULED));
+    *schedule = !(state & MAILBOX_SCHEDULED);
+    *pushed = reserved;
+
+    // Nodes are linked into a chain first, then the chain is appended at once.
+    mailbox_node_t *first = NULL;
+    mailbox_node_t *last = NULL;
+    for (size_t i = 0; i < reserved; ++i) {
+        mailbox_node_t *node = (mailbox_node_t *) slab_alloc(sizeof(mailbox_node_t));
+        node->message = messages[i];
+        node->payload = payloads == NULL ? NULL : payloads[i];
+        atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+        if (last == NULL) {
+            first = node;
+        } else {
+            atomic_store_explicit(&last->next, node, memory_order_relaxed);
+        }
+        last = node;
+    }
+
+    mailbox_node_t *previous = atomic_exchange_explicit(&mailbox->tail,
+                                                        last,
+                                                        memory_order_acq_rel);
+    atomic_store_explicit(&previous->next, first, memory_order_release);
+
+    return reserved == n ? 0 : -3;
+}
+
+bool mailbox_try_pop(mailbox_t *mailbox, message_t *message, void **payload, bool *finished) {
+    mailbox_node_t *head = mailbox->head;
+    mailbox_node_t *next = atomic_load_explicit(&head->next, memory_order_acquire);
+    if (next == NULL) {
+        return false;
+    }
+
+    // next becomes the node before the first message.
+    *message = next->message;
+    if (payload != NULL) {
+        *payload = next->payload;
+    }
+    mailbox->head = next;
+    if (head != &mailbox->stub) {
+        slab_free(head, sizeof(mailbox_node_t));
+    }
+
+    size_t state = atomic_fetch_sub(&mailbox->state, 1) - 1;
+    if (finished != NULL) {
+        *finished = (state & ~MAILBOX_SCHEDULED) == MAILBOX_CLOSED;
+    }
+    return true;
+}
+
+int mailbox_reserve(mailbox_t *mailbox, size_t size) {
+    size_t state = atomic_load(&mailbox->state);
+    do {
+        if (state & MAILBOX_CLOSED) {
+            return -1;
+        }
+        if ((state & ~MAILBOX_FLAGS) >= ACTOR_QUEUE_LIMIT) {
+            return -3;
+        }
+        if ((state & ~MAILBOX_FLAGS) != size) {
+            return 1;
+        }
+    } while (!atomic_compare_exchange_weak(&mailbox->state, &state, state + 1));
+    return 0;
+}
+
+void mailbox_release(mailbox_t *mailbox) {
+    atomic_fetch_sub(&mailbox->state, 1);
+}
+
+bool mailbox_unschedule(mailbox_t *mailbox) {
+    // Messages reserved but not linked yet are counted,
+    // so their producers see the actor scheduled only if it will process them.
+    size_t state = atomic_load(&mailbox->state);
+    do {
+        if (state & ~MAILBOX_FLAGS) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak(&mailbox->state,
+                                           &state,
+                                           state & ~MAILBOX_SCHEDULED));
+    return true;
+}
+
+bool mailbox_close(mailbox_t *mailbox) {
+    size_t state = atomic_fetch_or(&mailbox->state, MAILBOX_CLOSED);
+    return (state & ~MAILBOX_SCHEDULED) == 0;
+}
+
+bool mailbox_finished(mailbox_t *mailbox) {
+    return (atomic_load(&mailbox->state) & ~MAILBOX_SCHEDULED) == MAILBOX_CLOSED;
+}
+
+size_t mailbox_size(mailbox_t *mailbox) {
+    return atomic_load(&mailbox->state) & ~MAILBOX_FLAGS;
+}
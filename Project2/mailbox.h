@@ -0,0 +1,83 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct mailbox_node {
+    _Atomic(struct mailbox_node *) next;
+    message_t message;
+    void *payload; // Memory owned by the message, not used by mailbox.
+} mailbox_node_t;
+
+// Lock-free multi-producer single-consumer queue of actor messages
+// (Vyukov's intrusive MPSC queue). Any thread can push,
+// only the thread processing the actor can pop.
+// state counts messages in the mailbox and has MAILBOX_CLOSED bit set after the actor died,
+// so no message is accepted by a dead actor or beyond ACTOR_QUEUE_LIMIT.
+// It also has MAILBOX_SCHEDULED bit set while the actor is scheduled to process messages,
+// so it is scheduled once for all of them.
+typedef struct mailbox {
+    _Atomic(mailbox_node_t *) tail; // Last pushed node, swapped by producers.
+    mailbox_node_t *head;           // Node before the first message, used by consumer.
+    mailbox_node_t stub;
+    atomic_size_t state;
+} mailbox_t;
+
+// Creates and returns an empty mailbox.
+mailbox_t *mailbox_create();
+
+// Destroys mailbox with all messages left in it. Their payloads are not freed.
+void mailbox_destroy(mailbox_t *mailbox);
+
+// Appends a copy of message with its payload, which may be NULL. Returns 0 on success,
+// -1 if mailbox is closed and -3 if it has ACTOR_QUEUE_LIMIT messages.
+// Sets schedule if the actor was not scheduled, then caller has to schedule it.
+int mailbox_push(mailbox_t *mailbox, const message_t *message, void *payload, bool *schedule);
+
+// Appends copies of n messages with their payloads, or without them if payloads is NULL,
+// reserving space for all of them at once. Saves number of appended messages to pushed.
+// Returns 0 if all were appended, -1 if mailbox is closed and none was appended,
+// -3 if mailbox got ACTOR_QUEUE_LIMIT messages before all were appended.
+// Sets schedule as mailbox_push.
+int mailbox_push_many(mailbox_t *mailbox,
+                      const message_t *messages,
+                      void *const *payloads,
+                      size_t n,
+                      size_t *pushed,
+                      bool *schedule);
+
+// Removes the first message and saves it to message and its payload to payload,
+// unless payload is NULL.
+// Returns false if no message is visible, as producer may not have linked it yet.
+// Sets finished, unless it is NULL, if mailbox is closed and this was its last message.
+bool mailbox_try_pop(mailbox_t *mailbox, message_t *message, void **payload, bool *finished);
+
+// Counts a message kept by the consumer outside of mailbox, if mailbox has exactly
+// size messages counted, so the message is limited and scheduled as other messages are.
+// Returns 0 on success, 1 if mailbox has a different number of messages,
+// -1 if mailbox is closed and -3 if it has ACTOR_QUEUE_LIMIT messages.
+int mailbox_reserve(mailbox_t *mailbox, size_t size);
+
+// Stops counting a message counted by mailbox_reserve, when it is taken by the consumer.
+void mailbox_release(mailbox_t *mailbox);
+
+// Called by the scheduled actor when it stops processing messages.
+// Returns true if mailbox is empty and the actor is not scheduled anymore,
+// false if the actor stays scheduled and has to be scheduled again.
+bool mailbox_unschedule(mailbox_t *mailbox);
+
+// Closes mailbox, so it accepts no more messages.
+// Returns true if it was open and empty, then no message will be popped anymore.
+bool mailbox_close(mailbox_t *mailbox);
+
+// Returns true if mailbox is closed and empty, so no message will be popped anymore.
+bool mailbox_finished(mailbox_t *mailbox);
+
+// Returns number of messages in mailbox.
+size_t mailbox_size(mailbox_t *mailbox);
+
+#endif
@@ -0,0 +1,263 @@
+#include "metrics.h"
+#include "err.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static _Thread_local metrics_histograms_t *histograms_thread_local;
+// Histograms of threads are valid only if created in the current generation.
+static _Thread_local unsigned long histograms_generation_thread_local;
+static metrics_histograms_t *histograms_g;
+static atomic_ulong histograms_generation_g = 1;
+static pthread_mutex_t histograms_mutex_g = PTHREAD_MUTEX_INITIALIZER;
+
+static FILE *dump_file_g;
+static unsigned long dump_interval_ms_g;
+static unsigned long long dump_start_ns_g;
+static void (*dump_snapshot_g)(actor_system_metrics_t *metrics);
+static bool dump_stop_g;
+static pthread_t dump_thread_g;
+static pthread_mutex_t dump_mutex_g = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dump_cond_g = PTHREAD_COND_INITIALIZER;
+
+unsigned long long metrics_now_ns() {
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now)) {
+        fatal(__FILE__, __LINE__);
+    }
+    return (unsigned long long) now.tv_sec * 1000000000ULL + (unsigned long long) now.tv_nsec;
+}
+
+void metrics_counter_add(atomic_ullong *counter, unsigned long long value) {
+    atomic_store_explicit(counter,
+                          atomic_load_explicit(counter, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+metrics_histograms_t *metrics_thread_histograms() {
+    unsigned long generation = atomic_load(&histograms_generation_g);
+    if (histograms_thread_local != NULL && histograms_generation_thread_local == generation) {
+        return histograms_thread_local;
+    }
+
+    metrics_histograms_t *histograms = (metrics_histograms_t *) malloc(sizeof(metrics_histograms_t));
+    if (histograms == NULL) {
+        fatal(__FILE__, __LINE__);
+    }
+    for (size_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; ++i) {
+        atomic_init(&histograms->dispatch_latency[i], 0);
+        atomic_init(&histograms->handler_time[i], 0);
+    }
+
+    if (pthread_mutex_lock(&histograms_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    histograms->next = histograms_g;
+    histograms_g = histograms;
+
+    if (pthread_mutex_unlock(&histograms_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    histograms_thread_local = histograms;
+    histograms_generation_thread_local = generation;
+    return histograms;
+}
+
+void metrics_histogram_add(atomic_ullong *histogram, unsigned long long duration_ns) {
+    size_t bucket = 0;
+    while (bucket < METRICS_HISTOGRAM_BUCKETS - 1 && (duration_ns >> bucket) != 0) {
+        ++bucket;
+    }
+    metrics_counter_add(&histogram[bucket], 1);
+}
+
+void metrics_histograms_sum(actor_system_metrics_t *metrics) {
+    if (pthread_mutex_lock(&histograms_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    for (metrics_histograms_t *histograms = histograms_g;
+         histograms != NULL;
+         histograms = histograms->next) {
+        for (size_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; ++i) {
+            metrics->dispatch_latency[i] += atomic_load_explicit(&histograms->dispatch_latency[i],
+                                                                 memory_order_relaxed);
+            metrics->handler_time[i] += atomic_load_explicit(&histograms->handler_time[i],
+                                                             memory_order_relaxed);
+        }
+    }
+
+    if (pthread_mutex_unlock(&histograms_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+}
+
+void metrics_histograms_free() {
+    if (pthread_mutex_lock(&histograms_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    while (histograms_g != NULL) {
+        metrics_histograms_t *histograms = histograms_g;
+        histograms_g = histograms->next;
+        free(histograms);
+    }
+    atomic_fetch_add(&histograms_generation_g, 1);
+
+    if (pthread_mutex_unlock(&histograms_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+}
+
+void metrics_copy(actor_system_metrics_t *copy, const actor_system_metrics_t *metrics) {
+    *copy = *metrics;
+    copy->actors = (actor_metrics_t *) malloc(metrics->nactors * sizeof(actor_metrics_t));
+    copy->workers = (worker_metrics_t *) malloc(metrics->nworkers * sizeof(worker_metrics_t));
+    if ((metrics->nactors > 0 && copy->actors == NULL)
+        || (metrics->nworkers > 0 && copy->workers == NULL)) {
+        fatal(__FILE__, __LINE__);
+    }
+    if (metrics->nactors > 0) {
+        memcpy(copy->actors, metrics->actors, metrics->nactors * sizeof(actor_metrics_t));
+    }
+    if (metrics->nworkers > 0) {
+        memcpy(copy->workers, metrics->workers, metrics->nworkers * sizeof(worker_metrics_t));
+    }
+}
+
+static void write_histogram(const char *name, const unsigned long long *histogram) {
+    fprintf(dump_file_g, "%s", name);
+    for (size_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; ++i) {
+        if (histogram[i] > 0) {
+            fprintf(dump_file_g, " <%lluns:%llu", 1ULL << i, histogram[i]);
+        }
+    }
+    fprintf(dump_file_g, "\n");
+}
+
+// Writes metrics as lines of text, after the time since the dump started.
+static void write_metrics(const actor_system_metrics_t *metrics) {
+    fprintf(dump_file_g, "metrics %llu ms\n", (metrics_now_ns() - dump_start_ns_g) / 1000000);
+
+    for (size_t i = 0; i < metrics->nworkers; ++i) {
+        const worker_metrics_t *worker = &metrics->workers[i];
+        unsigned long long total_ns = worker->busy_ns + worker->idle_ns;
+        fprintf(dump_file_g,
+                "worker %zu busy_ns %llu idle_ns %llu busy_ratio %.3f tasks %llu steals %llu wakeups %llu\n",
+                i,
+                worker->busy_ns,
+                worker->idle_ns,
+                total_ns == 0 ? 0.0 : (double) worker->busy_ns / (double) total_ns,
+                worker->tasks,
+                worker->steals,
+                worker->wakeups);
+    }
+
+    for (size_t i = 0; i < metrics->nactors; ++i) {
+        const actor_metrics_t *actor = &metrics->actors[i];
+        fprintf(dump_file_g,
+                "actor %ld sent %llu processed %llu mailbox_high_water %zu\n",
+                actor->actor,
+                actor->messages_sent,
+                actor->messages_processed,
+                actor->mailbox_high_water);
+    }
+
+    write_histogram("dispatch_latency", metrics->dispatch_latency);
+    write_histogram("handler_time", metrics->handler_time);
+    fflush(dump_file_g);
+}
+
+static void *dump_thread(void *arg) {
+    (void) arg;
+
+    if (pthread_mutex_lock(&dump_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    while (!dump_stop_g) {
+        struct timespec deadline;
+        if (clock_gettime(CLOCK_REALTIME, &deadline)) {
+            fatal(__FILE__, __LINE__);
+        }
+        deadline.tv_sec += (time_t) (dump_interval_ms_g / 1000);
+        deadline.tv_nsec += (long) (dump_interval_ms_g % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        int wait_result = 0;
+        while (!dump_stop_g && wait_result != ETIMEDOUT) {
+            wait_result = pthread_cond_timedwait(&dump_cond_g, &dump_mutex_g, &deadline);
+            if (wait_result != 0 && wait_result != ETIMEDOUT) {
+                fatal(__FILE__, __LINE__);
+            }
+        }
+
+        if (!dump_stop_g) {
+            actor_system_metrics_t metrics;
+            dump_snapshot_g(&metrics);
+            write_metrics(&metrics);
+            actor_system_metrics_free(&metrics);
+        }
+    }
+
+    if (pthread_mutex_unlock(&dump_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    return NULL;
+}
+
+void metrics_dump_start(const char *path,
+                        unsigned long interval_ms,
+                        void (*snapshot)(actor_system_metrics_t *metrics)) {
+    dump_file_g = fopen(path, "w");
+    if (dump_file_g == NULL) {
+        fatal(__FILE__, __LINE__);
+    }
+    dump_interval_ms_g = interval_ms;
+    dump_start_ns_g = metrics_now_ns();
+    dump_snapshot_g = snapshot;
+    dump_stop_g = false;
+
+    if (interval_ms > 0 && pthread_create(&dump_thread_g, NULL, dump_thread, NULL)) {
+        fatal(__FILE__, __LINE__);
+    }
+}
+
+void metrics_dump_stop(const actor_system_metrics_t *last) {
+    if (dump_interval_ms_g > 0) {
+        if (pthread_mutex_lock(&dump_mutex_g)) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        dump_stop_g = true;
+
+        if (pthread_cond_signal(&dump_cond_g)) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        if (pthread_mutex_unlock(&dump_mutex_g)) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        if (pthread_join(dump_thread_g, NULL)) {
+            fatal(__FILE__, __LINE__);
+        }
+    }
+
+    write_metrics(last);
+    if (fclose(dump_file_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+    dump_file_g = NULL;
+}
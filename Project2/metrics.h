@@ -0,0 +1,46 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "cacti.h"
+
+#include <stdatomic.h>
+
+// Histograms of one thread, written only by it.
+typedef struct metrics_histograms {
+    struct metrics_histograms *next;
+    atomic_ullong dispatch_latency[METRICS_HISTOGRAM_BUCKETS];
+    atomic_ullong handler_time[METRICS_HISTOGRAM_BUCKETS];
+} metrics_histograms_t;
+
+// Returns current time of monotonic clock in nanoseconds.
+unsigned long long metrics_now_ns();
+
+// Adds value to counter written only by the calling thread.
+void metrics_counter_add(atomic_ullong *counter, unsigned long long value);
+
+// Returns histograms of the calling thread, creating them if needed.
+metrics_histograms_t *metrics_thread_histograms();
+
+// Counts duration in histogram of the calling thread.
+void metrics_histogram_add(atomic_ullong *histogram, unsigned long long duration_ns);
+
+// Adds histograms of all threads to histograms of metrics.
+void metrics_histograms_sum(actor_system_metrics_t *metrics);
+
+// Frees histograms of all threads, which get new ones when they need them.
+// No thread may be using its histograms.
+void metrics_histograms_free();
+
+// Copies metrics, which have to be freed with actor_system_metrics_free.
+void metrics_copy(actor_system_metrics_t *copy, const actor_system_metrics_t *metrics);
+
+// Starts thread writing metrics saved by snapshot to file at path
+// every interval_ms milliseconds, or never if interval_ms is 0.
+void metrics_dump_start(const char *path,
+                        unsigned long interval_ms,
+                        void (*snapshot)(actor_system_metrics_t *metrics));
+
+// Stops the thread, then writes last metrics to the file and closes it.
+void metrics_dump_stop(const actor_system_metrics_t *last);
+
+#endif
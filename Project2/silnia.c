@@ -80,7 +80,7 @@ message_t make_factorial_msg(const factorial_t *factorial_ptr) {
     message.message_type = MSG_FACTORIAL;
     size_t factorial_size = sizeof(factorial_t);
 
-    message.data = (void *) malloc(factorial_size);
+    message.data = message_payload_alloc(factorial_size);
     memcpy(message.data, factorial_ptr, factorial_size);
 
     message.nbytes = factorial_size;
@@ -190,8 +190,6 @@ void process_factorial(void **stateptr, size_t nbytes, void *data) {
         }
         send_message(actor_id_self(), message);
     }
-
-    free(factorial_ptr);
 }
 
 void process_recursive_godie(void **stateptr, size_t nbytes, void *data) {
@@ -0,0 +1,209 @@
+#include "slab.h"
+#include "err.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define SLAB_MIN_SIZE 32
+#define SLAB_CLASSES 6        // Sizes from SLAB_MIN_SIZE to SLAB_MAX_SIZE.
+#define SLAB_BATCH_SIZE 128   // Blocks moved between thread and shared lists at once.
+#define SLAB_CACHE_LIMIT 256  // Blocks of one class kept by a thread.
+#define SLAB_SHARED_LIMIT 64  // Batches of one class kept in shared lists.
+
+// Free block. The first block of a batch in shared list
+// links the next batch and knows the size of its batch.
+typedef struct slab_block {
+    struct slab_block *next;
+    struct slab_block *next_batch;
+    size_t batch_size;
+} slab_block_t;
+
+typedef struct slab_cache {
+    slab_block_t *blocks;
+    size_t size;
+} slab_cache_t;
+
+static _Thread_local slab_cache_t slab_caches[SLAB_CLASSES];
+static _Thread_local bool slab_thread_registered;
+static slab_block_t *slab_batches_g[SLAB_CLASSES];
+static size_t slab_batch_counts_g[SLAB_CLASSES];
+static pthread_mutex_t slab_mutex_g = PTHREAD_MUTEX_INITIALIZER;
+// Flushes caches of threads when they exit.
+static pthread_once_t slab_key_once_g = PTHREAD_ONCE_INIT;
+static pthread_key_t slab_key_g;
+
+// Returns size class of block, or -1 if it is too big.
+static int slab_class(size_t size) {
+    size_t class_size = SLAB_MIN_SIZE;
+    for (int size_class = 0; size_class < SLAB_CLASSES; ++size_class) {
+        if (size <= class_size) {
+            return size_class;
+        }
+        class_size *= 2;
+    }
+    return -1;
+}
+
+static void slab_free_blocks(slab_block_t *block) {
+    while (block != NULL) {
+        slab_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+// Batch is freed if shared list of its class is full.
+static void slab_push_batch(int size_class, slab_block_t *batch, size_t batch_size) {
+    batch->batch_size = batch_size;
+
+    if (pthread_mutex_lock(&slab_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    bool shared = slab_batch_counts_g[size_class] < SLAB_SHARED_LIMIT;
+    if (shared) {
+        batch->next_batch = slab_batches_g[size_class];
+        slab_batches_g[size_class] = batch;
+        slab_batch_counts_g[size_class]++;
+    }
+
+    if (pthread_mutex_unlock(&slab_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    if (!shared) {
+        slab_free_blocks(batch);
+    }
+}
+
+static void slab_thread_exit(void *value) {
+    (void) value;
+    slab_flush();
+    // Destructors of other keys may use slab again, then the thread registers again.
+    slab_thread_registered = false;
+}
+
+static void slab_create_key() {
+    if (pthread_key_create(&slab_key_g, slab_thread_exit)) {
+        fatal(__FILE__, __LINE__);
+    }
+}
+
+// Makes caches of the calling thread flushed when it exits.
+static void slab_register_thread() {
+    if (pthread_once(&slab_key_once_g, slab_create_key)) {
+        fatal(__FILE__, __LINE__);
+    }
+    if (pthread_setspecific(slab_key_g, slab_caches)) {
+        fatal(__FILE__, __LINE__);
+    }
+    slab_thread_registered = true;
+}
+
+void *slab_alloc(size_t size) {
+    int size_class = slab_class(size);
+    if (size_class < 0) {
+        void *block = malloc(size);
+        if (block == NULL) {
+            fatal(__FILE__, __LINE__);
+        }
+        return block;
+    }
+
+    slab_cache_t *cache = &slab_caches[size_class];
+    if (cache->blocks == NULL) {
+        if (!slab_thread_registered) {
+            slab_register_thread();
+        }
+        if (pthread_mutex_lock(&slab_mutex_g)) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        slab_block_t *batch = slab_batches_g[size_class];
+        if (batch != NULL) {
+            slab_batches_g[size_class] = batch->next_batch;
+            slab_batch_counts_g[size_class]--;
+            cache->blocks = batch;
+            cache->size = batch->batch_size;
+        }
+
+        if (pthread_mutex_unlock(&slab_mutex_g)) {
+            fatal(__FILE__, __LINE__);
+        }
+    }
+
+    if (cache->blocks == NULL) {
+        void *block = malloc((size_t) SLAB_MIN_SIZE << size_class);
+        if (block == NULL) {
+            fatal(__FILE__, __LINE__);
+        }
+        return block;
+    }
+
+    slab_block_t *block = cache->blocks;
+    cache->blocks = block->next;
+    cache->size--;
+    return block;
+}
+
+void slab_free(void *block, size_t size) {
+    int size_class = slab_class(size);
+    if (size_class < 0) {
+        free(block);
+        return;
+    }
+
+    if (!slab_thread_registered) {
+        slab_register_thread();
+    }
+    slab_cache_t *cache = &slab_caches[size_class];
+    slab_block_t *freed = (slab_block_t *) block;
+    freed->next = cache->blocks;
+    cache->blocks = freed;
+    cache->size++;
+
+    if (cache->size > SLAB_CACHE_LIMIT) {
+        slab_block_t *batch = cache->blocks;
+        slab_block_t *last = batch;
+        for (size_t i = 1; i < SLAB_BATCH_SIZE; ++i) {
+            last = last->next;
+        }
+        cache->blocks = last->next;
+        cache->size -= SLAB_BATCH_SIZE;
+        last->next = NULL;
+        slab_push_batch(size_class, batch, SLAB_BATCH_SIZE);
+    }
+}
+
+void slab_flush() {
+    for (int size_class = 0; size_class < SLAB_CLASSES; ++size_class) {
+        slab_cache_t *cache = &slab_caches[size_class];
+        if (cache->blocks != NULL) {
+            slab_push_batch(size_class, cache->blocks, cache->size);
+            cache->blocks = NULL;
+            cache->size = 0;
+        }
+    }
+}
+
+void slab_release() {
+    if (pthread_mutex_lock(&slab_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    for (int size_class = 0; size_class < SLAB_CLASSES; ++size_class) {
+        slab_block_t *batch = slab_batches_g[size_class];
+        while (batch != NULL) {
+            slab_block_t *next_batch = batch->next_batch;
+            slab_free_blocks(batch);
+            batch = next_batch;
+        }
+        slab_batches_g[size_class] = NULL;
+        slab_batch_counts_g[size_class] = 0;
+    }
+
+    if (pthread_mutex_unlock(&slab_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+}
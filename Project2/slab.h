@@ -0,0 +1,29 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+// Blocks bigger than this are allocated with malloc.
+#define SLAB_MAX_SIZE 1024
+
+// Allocator of small memory blocks in a few size classes, for objects
+// allocated and freed on every task and message.
+// Every thread keeps free lists of blocks it freed and reuses them.
+// Surplus blocks are moved in batches to lists shared by all threads,
+// so blocks freed by consumers are reused by producers. Shared lists are capped,
+// batches beyond the cap are freed.
+
+// Returns block of at least size bytes.
+void *slab_alloc(size_t size);
+
+// Frees block allocated with slab_alloc with the same size.
+void slab_free(void *block, size_t size);
+
+// Moves blocks cached by the calling thread to shared lists.
+// Caches of a thread are also flushed when it exits.
+void slab_flush();
+
+// Frees blocks in shared lists.
+void slab_release();
+
+#endif
@@ -0,0 +1,308 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#define MESSAGES (5 * ACTOR_QUEUE_LIMIT)
+#define TIMEOUT_MS 50
+#define PRODUCERS 8
+#define PIPELINE_MESSAGES ACTOR_QUEUE_LIMIT
+#define PIPELINE_WORKERS 4
+#define SINK_WORK 2000
+
+#define MSG_COUNT (message_type_t)1
+#define MSG_WAIT (message_type_t)2
+#define MSG_PRODUCE (message_type_t)3
+#define MSG_ITEM (message_type_t)1
+
+int tests_run = 0;
+
+static atomic_long counted_g;
+static atomic_bool waiting_g;
+static atomic_bool released_g;
+static actor_id_t consumer_g;
+static atomic_int produced_g;
+static atomic_int self_send_g;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void count(void **stateptr, size_t nbytes, void *data);
+static void wait_for_release(void **stateptr, size_t nbytes, void *data);
+static void produce(void **stateptr, size_t nbytes, void *data);
+
+static act_t prompts_g[] = { hello, count, wait_for_release, produce };
+static role_t role_g = { .nprompts = 4, .prompts = prompts_g };
+
+// Pipeline of producers sending to a middle actor, which forwards to a slow sink.
+static actor_id_t pipeline_g;
+static atomic_long sunk_g;
+static atomic_int failed_sends_g;
+
+static void pipeline_hello(void **stateptr, size_t nbytes, void *data);
+static void sink_item(void **stateptr, size_t nbytes, void *data);
+static void middle_item(void **stateptr, size_t nbytes, void *data);
+static void producer_hello(void **stateptr, size_t nbytes, void *data);
+static void idle_hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t pipeline_prompts_g[] = { pipeline_hello };
+static role_t pipeline_role_g = { .nprompts = 1, .prompts = pipeline_prompts_g };
+static act_t sink_prompts_g[] = { idle_hello, sink_item };
+static role_t sink_role_g = { .nprompts = 2, .prompts = sink_prompts_g };
+static act_t middle_prompts_g[] = { idle_hello, middle_item };
+static role_t middle_role_g = { .nprompts = 2, .prompts = middle_prompts_g };
+static act_t producer_prompts_g[] = { producer_hello };
+static role_t producer_role_g = { .nprompts = 1, .prompts = producer_prompts_g };
+
+static message_t make_message(message_type_t type, size_t nbytes, void *data)
+{
+    message_t message;
+    message.message_type = type;
+    message.nbytes = nbytes;
+    message.data = data;
+    return message;
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+
+    // Spawned actors send their ids to the first one.
+    if (nbytes != 0) {
+        send_message((actor_id_t) data, make_message(MSG_COUNT, 0, (void *) actor_id_self()));
+    }
+}
+
+static void count(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    atomic_fetch_add(&counted_g, 1);
+}
+
+static void wait_for_release(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    atomic_store(&waiting_g, true);
+    while (!atomic_load(&released_g)) {
+        sched_yield();
+    }
+}
+
+// Fills own mailbox, then sends messages to a consumer faster than it processes them.
+static void produce(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    message_t message = make_message(MSG_COUNT, 0, NULL);
+    while (send_message(actor_id_self(), message) == 0) {
+        atomic_fetch_add(&self_send_g, 1);
+    }
+    if (send_message_blocking(actor_id_self(), message) == -3) {
+        atomic_fetch_add(&self_send_g, 1000000);
+    }
+
+    for (int i = 0; i < MESSAGES; ++i) {
+        if (send_message_blocking(consumer_g, message) == 0) {
+            atomic_fetch_add(&produced_g, 1);
+        }
+    }
+    send_message_blocking(consumer_g, make_message(MSG_GODIE, 0, NULL));
+}
+
+// Actors are spawned in order, so the sink is the first one after the pipeline actor,
+// the middle the second one and producers the next ones.
+static void pipeline_hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    pipeline_g = actor_id_self();
+    send_message(pipeline_g, make_message(MSG_SPAWN, sizeof(role_t), &sink_role_g));
+    send_message(pipeline_g, make_message(MSG_SPAWN, sizeof(role_t), &middle_role_g));
+    for (int i = 0; i < PRODUCERS; ++i) {
+        send_message(pipeline_g, make_message(MSG_SPAWN, sizeof(role_t), &producer_role_g));
+    }
+}
+
+static void idle_hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+}
+
+static void sink_item(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    for (volatile int i = 0; i < SINK_WORK; ++i) {
+    }
+    if (atomic_fetch_add(&sunk_g, 1) + 1 < PRODUCERS * PIPELINE_MESSAGES) {
+        return;
+    }
+
+    for (actor_id_t actor = pipeline_g; actor <= pipeline_g + 2 + PRODUCERS; ++actor) {
+        send_message(actor, make_message(MSG_GODIE, 0, NULL));
+    }
+}
+
+static void middle_item(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    if (send_message_blocking(pipeline_g + 1, make_message(MSG_ITEM, 0, NULL)) != 0) {
+        atomic_fetch_add(&failed_sends_g, 1);
+    }
+}
+
+static void producer_hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    for (int i = 0; i < PIPELINE_MESSAGES; ++i) {
+        if (send_message_blocking(pipeline_g + 2, make_message(MSG_ITEM, 0, NULL)) != 0) {
+            atomic_fetch_add(&failed_sends_g, 1);
+        }
+    }
+}
+
+static char *blocking_send_waits_for_space()
+{
+    atomic_store(&counted_g, 0);
+    actor_id_t actor;
+    mu_assert("create failed", actor_system_create(&actor, &role_g) == 0);
+
+    for (int i = 0; i < MESSAGES; ++i) {
+        mu_assert("blocking send failed",
+                  send_message_blocking(actor, make_message(MSG_COUNT, 0, NULL)) == 0);
+    }
+    mu_assert("godie failed",
+              send_message_blocking(actor, make_message(MSG_GODIE, 0, NULL)) == 0);
+    actor_system_join(actor);
+
+    mu_assert("not all messages processed", atomic_load(&counted_g) == MESSAGES);
+    return 0;
+}
+
+static char *timed_send_times_out()
+{
+    atomic_store(&released_g, false);
+    actor_id_t actor;
+    mu_assert("create failed", actor_system_create(&actor, &role_g) == 0);
+    mu_assert("send failed", send_message(actor, make_message(MSG_WAIT, 0, NULL)) == 0);
+    while (!atomic_load(&waiting_g)) {
+        sched_yield();
+    }
+
+    size_t depth = 0;
+    message_t message = make_message(MSG_COUNT, 0, NULL);
+    while (send_message_nonblocking(actor, message, &depth) == 0) {
+    }
+    mu_assert("full mailbox depth not reported", depth == ACTOR_QUEUE_LIMIT);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    mu_assert("timed send to full mailbox succeeded",
+              send_message_timed(actor, message, TIMEOUT_MS) == -3);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    mu_assert("timed send returned too early", elapsed_ms >= TIMEOUT_MS - 1);
+
+    atomic_store(&released_g, true);
+    mu_assert("timed send after release failed",
+              send_message_timed(actor, message, 10000) == 0);
+    mu_assert("godie failed",
+              send_message_blocking(actor, make_message(MSG_GODIE, 0, NULL)) == 0);
+    actor_system_join(actor);
+    return 0;
+}
+
+static char *handlers_send_blocking()
+{
+    atomic_store(&counted_g, 0);
+    actor_id_t producer;
+    mu_assert("create failed", actor_system_create(&producer, &role_g) == 0);
+    mu_assert("spawn failed",
+              send_message(producer, make_message(MSG_SPAWN, sizeof(role_t), &role_g)) == 0);
+
+    // Consumer reports its id with a message counted by the producer.
+    while (atomic_load(&counted_g) == 0) {
+        sched_yield();
+    }
+    consumer_g = producer + 1;
+    mu_assert("produce failed", send_message(producer, make_message(MSG_PRODUCE, 0, NULL)) == 0);
+
+    // Producer's mailbox stays full until it finishes producing.
+    while (atomic_load(&produced_g) < MESSAGES) {
+        sched_yield();
+    }
+    mu_assert("godie failed",
+              send_message_blocking(producer, make_message(MSG_GODIE, 0, NULL)) == 0);
+    actor_system_join(producer);
+
+    mu_assert("not all messages produced", atomic_load(&produced_g) == MESSAGES);
+    mu_assert("own full mailbox not reported",
+              atomic_load(&self_send_g) == 1000000 + ACTOR_QUEUE_LIMIT);
+    mu_assert("not all messages processed",
+              atomic_load(&counted_g) == 1 + ACTOR_QUEUE_LIMIT + MESSAGES);
+    return 0;
+}
+
+// Handlers blocked in the pipeline must not run tasks which block
+// on actors waiting lower on the same thread.
+static char *blocking_pipeline_does_not_deadlock()
+{
+    actor_system_config_t config = {
+        .min_workers = PIPELINE_WORKERS,
+        .max_workers = PIPELINE_WORKERS,
+        .idle_timeout_ms = 0
+    };
+    actor_id_t pipeline;
+    mu_assert("create failed",
+              actor_system_create_with_config(&pipeline, &pipeline_role_g, &config) == 0);
+    actor_system_join(pipeline);
+
+    mu_assert("blocking send failed", atomic_load(&failed_sends_g) == 0);
+    mu_assert("not all items sunk", atomic_load(&sunk_g) == PRODUCERS * PIPELINE_MESSAGES);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(blocking_send_waits_for_space);
+    mu_run_test(timed_send_times_out);
+    mu_run_test(handlers_send_blocking);
+    mu_run_test(blocking_pipeline_does_not_deadlock);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
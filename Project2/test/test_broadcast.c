@@ -0,0 +1,240 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#define ACTORS 8
+#define NUMBERS 100
+#define BATCH (ACTOR_QUEUE_LIMIT + 10)
+
+#define MSG_NUMBER (message_type_t)1
+#define MSG_FILL (message_type_t)2
+#define MSG_FAN_OUT (message_type_t)3
+
+int tests_run = 0;
+
+static actor_id_t first_g;
+static atomic_long hellos_g;
+static long next_number_g[ACTORS];
+static atomic_long numbers_g;
+static atomic_long reordered_g;
+static message_t batch_g[BATCH];
+static atomic_size_t filled_g; // Messages of the batch sent by fill, plus one.
+static atomic_int fill_result_g;
+static atomic_int fan_out_failures_g;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void number(void **stateptr, size_t nbytes, void *data);
+static void fill(void **stateptr, size_t nbytes, void *data);
+static void fan_out(void **stateptr, size_t nbytes, void *data);
+
+static act_t prompts_g[] = { hello, number, fill, fan_out };
+static role_t role_g = { .nprompts = 4, .prompts = prompts_g };
+
+static message_t make_message(message_type_t type, size_t nbytes, void *data)
+{
+    message_t message;
+    message.message_type = type;
+    message.nbytes = nbytes;
+    message.data = data;
+    return message;
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    atomic_fetch_add(&hellos_g, 1);
+}
+
+// Every actor has to get numbers in order they were sent.
+static void number(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+
+    long *next_number = &next_number_g[actor_id_self() - first_g];
+    if ((long) data != (*next_number)++) {
+        atomic_fetch_add(&reordered_g, 1);
+    }
+    atomic_fetch_add(&numbers_g, 1);
+}
+
+// Sends the batch to own mailbox, which is not emptied while the handler runs,
+// so the batch stops when the mailbox is full.
+static void fill(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    size_t sent = 0;
+    atomic_store(&fill_result_g, send_message_batch(actor_id_self(), batch_g, BATCH, &sent));
+    atomic_store(&filled_g, sent + 1);
+}
+
+// Sends numbers to all other actors, scheduling them from a handler, then kills all actors.
+static void fan_out(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    actor_id_t actors[ACTORS];
+    for (int i = 0; i < ACTORS; ++i) {
+        actors[i] = first_g + i;
+    }
+
+    int results[ACTORS - 1];
+    for (long i = 0; i < NUMBERS; ++i) {
+        if (send_messages(actors + 1, ACTORS - 1, make_message(MSG_NUMBER, 0, (void *) i), results) != 0) {
+            atomic_fetch_add(&fan_out_failures_g, 1);
+        }
+        for (int actor = 0; actor < ACTORS - 1; ++actor) {
+            if (results[actor] != 0) {
+                atomic_fetch_add(&fan_out_failures_g, 1);
+            }
+        }
+    }
+    if (send_messages(actors, ACTORS, make_message(MSG_GODIE, 0, NULL), NULL) != 0) {
+        atomic_fetch_add(&fan_out_failures_g, 1);
+    }
+}
+
+// Creates the system with ACTORS actors, spawned in order after the first one.
+static char *create_actors()
+{
+    atomic_store(&hellos_g, 0);
+    atomic_store(&numbers_g, 0);
+    atomic_store(&reordered_g, 0);
+    for (int i = 0; i < ACTORS; ++i) {
+        next_number_g[i] = 0;
+    }
+
+    mu_assert("create failed", actor_system_create(&first_g, &role_g) == 0);
+    for (int i = 1; i < ACTORS; ++i) {
+        mu_assert("spawn failed",
+                  send_message(first_g, make_message(MSG_SPAWN, sizeof(role_t), &role_g)) == 0);
+    }
+    while (atomic_load(&hellos_g) < ACTORS) {
+        sched_yield();
+    }
+    return 0;
+}
+
+static char *send_messages_reports_every_send()
+{
+    char *result = create_actors();
+    if (result != 0) {
+        return result;
+    }
+
+    // Last id is not an actor.
+    actor_id_t actors[ACTORS + 1];
+    for (int i = 0; i < ACTORS; ++i) {
+        actors[i] = first_g + i;
+    }
+    actors[ACTORS] = CAST_LIMIT;
+
+    int results[ACTORS + 1];
+    for (long i = 0; i < NUMBERS; ++i) {
+        mu_assert("missing actor not reported",
+                  send_messages(actors, ACTORS + 1, make_message(MSG_NUMBER, 0, (void *) i), results) == -2);
+        for (int actor = 0; actor < ACTORS; ++actor) {
+            mu_assert("send to actor failed", results[actor] == 0);
+        }
+        mu_assert("send to missing actor succeeded", results[ACTORS] == -2);
+    }
+
+    mu_assert("godie failed",
+              send_messages(actors, ACTORS, make_message(MSG_GODIE, 0, NULL), NULL) == 0);
+    actor_system_join(first_g);
+
+    mu_assert("not all numbers processed", atomic_load(&numbers_g) == ACTORS * NUMBERS);
+    mu_assert("messages reordered", atomic_load(&reordered_g) == 0);
+    return 0;
+}
+
+static char *batch_stops_at_full_mailbox()
+{
+    atomic_store(&filled_g, 0);
+    char *result = create_actors();
+    if (result != 0) {
+        return result;
+    }
+
+    for (long i = 0; i < BATCH; ++i) {
+        batch_g[i] = make_message(MSG_NUMBER, 0, (void *) i);
+    }
+    mu_assert("fill failed", send_message(first_g, make_message(MSG_FILL, 0, NULL)) == 0);
+    while (atomic_load(&filled_g) == 0) {
+        sched_yield();
+    }
+    mu_assert("full mailbox not reported", atomic_load(&fill_result_g) == -3);
+    mu_assert("wrong number of sent messages", atomic_load(&filled_g) - 1 == ACTOR_QUEUE_LIMIT);
+
+    // Rest of the batch goes as the mailbox gets space.
+    size_t total = ACTOR_QUEUE_LIMIT;
+    while (total < BATCH) {
+        size_t sent = 0;
+        int batch_result = send_message_batch(first_g, batch_g + total, BATCH - total, &sent);
+        mu_assert("rest of batch failed", batch_result == 0 || batch_result == -3);
+        total += sent;
+        if (batch_result == -3) {
+            sched_yield();
+        }
+    }
+
+    for (int i = 0; i < ACTORS; ++i) {
+        mu_assert("godie failed", send_message(first_g + i, make_message(MSG_GODIE, 0, NULL)) == 0);
+    }
+    actor_system_join(first_g);
+
+    mu_assert("not all numbers processed", atomic_load(&numbers_g) == BATCH);
+    mu_assert("messages reordered", atomic_load(&reordered_g) == 0);
+    return 0;
+}
+
+static char *handler_fans_out()
+{
+    atomic_store(&fan_out_failures_g, 0);
+    char *result = create_actors();
+    if (result != 0) {
+        return result;
+    }
+
+    mu_assert("fan out failed", send_message(first_g, make_message(MSG_FAN_OUT, 0, NULL)) == 0);
+    actor_system_join(first_g);
+
+    mu_assert("send from handler failed", atomic_load(&fan_out_failures_g) == 0);
+    mu_assert("not all numbers processed", atomic_load(&numbers_g) == (ACTORS - 1) * NUMBERS);
+    mu_assert("messages reordered", atomic_load(&reordered_g) == 0);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(send_messages_reports_every_send);
+    mu_run_test(batch_stops_at_full_mailbox);
+    mu_run_test(handler_fans_out);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,107 @@
+#include "minunit.h"
+#include "deque.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define THIEVES 3
+#define ELEMENTS 100000
+
+int tests_run = 0;
+
+static deque_t deque_g;
+static atomic_int taken_g[ELEMENTS];
+static atomic_bool owner_done_g;
+
+static char *push_take_in_reverse_order()
+{
+    deque_t deque;
+    deque_init(&deque);
+    for (long i = 1; i <= 200; ++i) {
+        deque_push(&deque, (void *) i);
+    }
+    mu_assert("wrong size", deque_size(&deque) == 200);
+
+    mu_assert("wrong steal", (long) deque_steal(&deque) == 1);
+    for (long i = 200; i > 1; --i) {
+        mu_assert("wrong take", (long) deque_take(&deque) == i);
+    }
+    mu_assert("take from empty", deque_take(&deque) == NULL);
+    mu_assert("steal from empty", deque_steal(&deque) == NULL);
+
+    deque_destroy(&deque);
+    return 0;
+}
+
+static void *thief(void *arg)
+{
+    (void) arg;
+    while (!atomic_load(&owner_done_g) || deque_size(&deque_g) > 0) {
+        long element = (long) deque_steal(&deque_g);
+        if (element != 0) {
+            atomic_fetch_add(&taken_g[element - 1], 1);
+        }
+    }
+    return NULL;
+}
+
+// Owner pushes and takes while thieves steal, every element is taken once.
+static char *concurrent_steals()
+{
+    deque_init(&deque_g);
+    pthread_t thieves[THIEVES];
+    for (int i = 0; i < THIEVES; ++i) {
+        pthread_create(&thieves[i], NULL, thief, NULL);
+    }
+
+    for (long i = 1; i <= ELEMENTS; ++i) {
+        deque_push(&deque_g, (void *) i);
+        if (i % 3 == 0) {
+            long element = (long) deque_take(&deque_g);
+            if (element != 0) {
+                atomic_fetch_add(&taken_g[element - 1], 1);
+            }
+        }
+    }
+    long element;
+    while ((element = (long) deque_take(&deque_g)) != 0) {
+        atomic_fetch_add(&taken_g[element - 1], 1);
+    }
+    atomic_store(&owner_done_g, true);
+
+    for (int i = 0; i < THIEVES; ++i) {
+        pthread_join(thieves[i], NULL);
+    }
+    for (int i = 0; i < ELEMENTS; ++i) {
+        mu_assert("element not taken exactly once", atomic_load(&taken_g[i]) == 1);
+    }
+
+    deque_destroy(&deque_g);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(push_take_in_reverse_order);
+    mu_run_test(concurrent_steals);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
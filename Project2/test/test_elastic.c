@@ -0,0 +1,104 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+#define CHILDREN 3
+#define WAIT_STEPS 5000
+
+int tests_run = 0;
+
+static atomic_long blocked_g;
+static atomic_long unblocked_g;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t prompts_g[] = { hello };
+static role_t role_g = { .nprompts = 1, .prompts = prompts_g };
+
+static message_t make_message(message_type_t type, size_t nbytes, void *data)
+{
+    message_t message;
+    message.message_type = type;
+    message.nbytes = nbytes;
+    message.data = data;
+    return message;
+}
+
+static void sleep_ms(long ms)
+{
+    struct timespec time = { .tv_sec = 0, .tv_nsec = ms * 1000000 };
+    nanosleep(&time, NULL);
+}
+
+// Father spawns children, which block in hello until all of them run it at once,
+// so the system must add threads to run them.
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) data;
+
+    if (nbytes == 0) {
+        for (int i = 0; i < CHILDREN; ++i) {
+            send_message(actor_id_self(), make_message(MSG_SPAWN, sizeof(role_t), &role_g));
+        }
+    } else {
+        atomic_fetch_add(&blocked_g, 1);
+        for (int i = 0; i < WAIT_STEPS && atomic_load(&blocked_g) < CHILDREN; ++i) {
+            sleep_ms(1);
+        }
+        if (atomic_load(&blocked_g) == CHILDREN) {
+            atomic_fetch_add(&unblocked_g, 1);
+        }
+    }
+    send_message(actor_id_self(), make_message(MSG_GODIE, 0, NULL));
+}
+
+static char *invalid_config()
+{
+    actor_id_t father;
+    actor_system_config_t config = { .min_workers = 0, .max_workers = 0, .idle_timeout_ms = 0 };
+    mu_assert("no workers accepted", actor_system_create_with_config(&father, &role_g, &config) == -1);
+
+    config.min_workers = 2;
+    config.max_workers = 1;
+    mu_assert("min over max accepted", actor_system_create_with_config(&father, &role_g, &config) == -1);
+    return 0;
+}
+
+static char *blocked_handlers_get_threads()
+{
+    actor_system_config_t config = { .min_workers = 1, .max_workers = CHILDREN, .idle_timeout_ms = 10 };
+
+    actor_id_t father;
+    mu_assert("create failed", actor_system_create_with_config(&father, &role_g, &config) == 0);
+    actor_system_join(father);
+
+    mu_assert("children did not run at once", atomic_load(&unblocked_g) == CHILDREN);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(invalid_config);
+    mu_run_test(blocked_handlers_get_threads);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,263 @@
+#include "minunit.h"
+#include "mailbox.h"
+#include "slab.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define PRODUCERS 4
+#define MESSAGES_PER_PRODUCER 20000
+
+int tests_run = 0;
+
+static mailbox_t *mailbox_g;
+
+static message_t make_message(long producer, long number)
+{
+    message_t message;
+    message.message_type = producer;
+    message.nbytes = 0;
+    message.data = (void *) number;
+    return message;
+}
+
+static char *push_pop_in_order()
+{
+    mailbox_t *mailbox = mailbox_create();
+    bool schedule;
+    for (long i = 0; i < 10; ++i) {
+        message_t message = make_message(0, i);
+        mu_assert("push failed", mailbox_push(mailbox, &message, NULL, &schedule) == 0);
+    }
+    mu_assert("wrong size", mailbox_size(mailbox) == 10);
+
+    for (long i = 0; i < 10; ++i) {
+        message_t message;
+        bool finished;
+        mu_assert("pop failed", mailbox_try_pop(mailbox, &message, NULL, &finished));
+        mu_assert("wrong order", (long) message.data == i);
+        mu_assert("finished before close", !finished);
+    }
+    message_t message;
+    bool finished;
+    mu_assert("pop from empty", !mailbox_try_pop(mailbox, &message, NULL, &finished));
+
+    mailbox_destroy(mailbox);
+    return 0;
+}
+
+static char *full_mailbox()
+{
+    mailbox_t *mailbox = mailbox_create();
+    bool schedule;
+    message_t message = make_message(0, 0);
+    for (int i = 0; i < ACTOR_QUEUE_LIMIT; ++i) {
+        mu_assert("push failed", mailbox_push(mailbox, &message, NULL, &schedule) == 0);
+    }
+    mu_assert("full mailbox accepted message", mailbox_push(mailbox, &message, NULL, &schedule) == -3);
+
+    bool finished;
+    mu_assert("pop failed", mailbox_try_pop(mailbox, &message, NULL, &finished));
+    mu_assert("push after pop failed", mailbox_push(mailbox, &message, NULL, &schedule) == 0);
+
+    mailbox_destroy(mailbox);
+    return 0;
+}
+
+static char *closed_mailbox()
+{
+    mailbox_t *mailbox = mailbox_create();
+    bool schedule;
+    message_t message = make_message(0, 0);
+    mu_assert("push failed", mailbox_push(mailbox, &message, NULL, &schedule) == 0);
+    mu_assert("push failed", mailbox_push(mailbox, &message, NULL, &schedule) == 0);
+
+    mu_assert("non empty mailbox finished", !mailbox_close(mailbox));
+    mu_assert("closed mailbox accepted message", mailbox_push(mailbox, &message, NULL, &schedule) == -1);
+    mu_assert("second close finished", !mailbox_close(mailbox));
+
+    bool finished;
+    mu_assert("pop failed", mailbox_try_pop(mailbox, &message, NULL, &finished));
+    mu_assert("finished too early", !finished);
+    mu_assert("pop failed", mailbox_try_pop(mailbox, &message, NULL, &finished));
+    mu_assert("not finished after last message", finished);
+    mailbox_destroy(mailbox);
+
+    mailbox = mailbox_create();
+    mu_assert("empty mailbox not finished", mailbox_close(mailbox));
+    mailbox_destroy(mailbox);
+    return 0;
+}
+
+static char *scheduled_once()
+{
+    mailbox_t *mailbox = mailbox_create();
+    message_t message = make_message(0, 0);
+    bool schedule;
+    mu_assert("push failed", mailbox_push(mailbox, &message, NULL, &schedule) == 0);
+    mu_assert("first message did not schedule", schedule);
+    mu_assert("push failed", mailbox_push(mailbox, &message, NULL, &schedule) == 0);
+    mu_assert("second message scheduled again", !schedule);
+
+    bool finished;
+    mu_assert("pop failed", mailbox_try_pop(mailbox, &message, NULL, &finished));
+    mu_assert("unscheduled with a message left", !mailbox_unschedule(mailbox));
+    mu_assert("push failed", mailbox_push(mailbox, &message, NULL, &schedule) == 0);
+    mu_assert("scheduled actor scheduled again", !schedule);
+
+    mu_assert("pop failed", mailbox_try_pop(mailbox, &message, NULL, &finished));
+    mu_assert("pop failed", mailbox_try_pop(mailbox, &message, NULL, &finished));
+    mu_assert("empty mailbox not unscheduled", mailbox_unschedule(mailbox));
+    mu_assert("push failed", mailbox_push(mailbox, &message, NULL, &schedule) == 0);
+    mu_assert("unscheduled actor not scheduled", schedule);
+
+    mailbox_destroy(mailbox);
+    return 0;
+}
+
+static char *push_many()
+{
+    mailbox_t *mailbox = mailbox_create();
+    message_t messages[ACTOR_QUEUE_LIMIT];
+    for (long i = 0; i < ACTOR_QUEUE_LIMIT; ++i) {
+        messages[i] = make_message(0, i);
+    }
+
+    size_t pushed;
+    bool schedule;
+    mu_assert("push many failed",
+              mailbox_push_many(mailbox, messages, NULL, 10, &pushed, &schedule) == 0);
+    mu_assert("not all pushed", pushed == 10);
+    mu_assert("first messages did not schedule", schedule);
+    mu_assert("over limit accepted",
+              mailbox_push_many(mailbox, messages, NULL, ACTOR_QUEUE_LIMIT, &pushed, &schedule) == -3);
+    mu_assert("free space not used", pushed == ACTOR_QUEUE_LIMIT - 10);
+    mu_assert("scheduled actor scheduled again", !schedule);
+    mu_assert("full mailbox accepted messages",
+              mailbox_push_many(mailbox, messages, NULL, 1, &pushed, &schedule) == -3 && pushed == 0);
+
+    for (long i = 0; i < ACTOR_QUEUE_LIMIT; ++i) {
+        message_t message;
+        bool finished;
+        mu_assert("pop failed", mailbox_try_pop(mailbox, &message, NULL, &finished));
+        mu_assert("wrong order", (long) message.data == (i < 10 ? i : i - 10));
+    }
+
+    mailbox_close(mailbox);
+    mu_assert("closed mailbox accepted messages",
+              mailbox_push_many(mailbox, messages, NULL, 1, &pushed, &schedule) == -1 && pushed == 0);
+    mailbox_destroy(mailbox);
+    return 0;
+}
+
+static char *reserved_messages()
+{
+    mailbox_t *mailbox = mailbox_create();
+    message_t message = make_message(0, 0);
+    bool schedule;
+
+    mu_assert("reserve in empty mailbox failed", mailbox_reserve(mailbox, 0) == 0);
+    mu_assert("reserve failed", mailbox_reserve(mailbox, 1) == 0);
+    mu_assert("push failed", mailbox_push(mailbox, &message, NULL, &schedule) == 0);
+    mu_assert("reserve with other message succeeded", mailbox_reserve(mailbox, 2) == 1);
+    mu_assert("reserved messages not counted", mailbox_size(mailbox) == 3);
+
+    mailbox_release(mailbox);
+    mailbox_release(mailbox);
+    mu_assert("unscheduled with a message left", !mailbox_unschedule(mailbox));
+    mu_assert("pop failed", mailbox_try_pop(mailbox, &message, NULL, NULL));
+    mu_assert("empty mailbox not unscheduled", mailbox_unschedule(mailbox));
+
+    for (int i = 0; i < ACTOR_QUEUE_LIMIT; ++i) {
+        mu_assert("reserve failed", mailbox_reserve(mailbox, (size_t) i) == 0);
+    }
+    mu_assert("reserve over limit", mailbox_reserve(mailbox, ACTOR_QUEUE_LIMIT) == -3);
+    mailbox_close(mailbox);
+    mu_assert("reserve in closed mailbox", mailbox_reserve(mailbox, ACTOR_QUEUE_LIMIT) == -1);
+    for (int i = 0; i < ACTOR_QUEUE_LIMIT; ++i) {
+        mu_assert("finished with reserved messages", !mailbox_finished(mailbox));
+        mailbox_release(mailbox);
+    }
+    mu_assert("not finished", mailbox_finished(mailbox));
+
+    mailbox_destroy(mailbox);
+    return 0;
+}
+
+static void *producer_thread(void *arg)
+{
+    long producer = (long) arg;
+    bool schedule;
+    for (long i = 0; i < MESSAGES_PER_PRODUCER;) {
+        message_t message = make_message(producer, i);
+        if (mailbox_push(mailbox_g, &message, NULL, &schedule) == 0) {
+            ++i;
+        } else {
+            sched_yield();
+        }
+    }
+    slab_flush();
+    return NULL;
+}
+
+static char *concurrent_producers()
+{
+    mailbox_g = mailbox_create();
+    pthread_t producers[PRODUCERS];
+    for (long producer = 0; producer < PRODUCERS; ++producer) {
+        pthread_create(&producers[producer], NULL, producer_thread, (void *) producer);
+    }
+
+    long next[PRODUCERS] = { 0 };
+    long received = 0;
+    while (received < PRODUCERS * MESSAGES_PER_PRODUCER) {
+        message_t message;
+        bool finished;
+        if (mailbox_try_pop(mailbox_g, &message, NULL, &finished)) {
+            mu_assert("mailbox size over limit", mailbox_size(mailbox_g) <= ACTOR_QUEUE_LIMIT);
+            mu_assert("messages of producer reordered",
+                      (long) message.data == next[message.message_type]);
+            next[message.message_type]++;
+            received++;
+        }
+    }
+
+    for (long producer = 0; producer < PRODUCERS; ++producer) {
+        pthread_join(producers[producer], NULL);
+    }
+    mu_assert("mailbox not empty", mailbox_size(mailbox_g) == 0);
+    mailbox_destroy(mailbox_g);
+    slab_flush();
+    slab_release();
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(push_pop_in_order);
+    mu_run_test(full_mailbox);
+    mu_run_test(closed_mailbox);
+    mu_run_test(scheduled_once);
+    mu_run_test(push_many);
+    mu_run_test(reserved_messages);
+    mu_run_test(concurrent_producers);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,167 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MESSAGES 500
+#define METRICS_FILE "test_metrics.out"
+
+#define MSG_READY (message_type_t)1
+#define MSG_NUMBER (message_type_t)2
+
+int tests_run = 0;
+
+static long numbers_g;
+static bool running_snapshot_g;
+static bool enabled_while_running_g;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void ready(void **stateptr, size_t nbytes, void *data);
+static void number(void **stateptr, size_t nbytes, void *data);
+
+static act_t prompts_g[] = { hello, ready, number };
+static role_t role_g = { .nprompts = 3, .prompts = prompts_g };
+
+static message_t make_message(message_type_t type, size_t nbytes, void *data)
+{
+    message_t message;
+    message.message_type = type;
+    message.nbytes = nbytes;
+    message.data = data;
+    return message;
+}
+
+// Father spawns a child, which tells it when it is ready for numbers.
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+
+    if (nbytes == 0) {
+        send_message(actor_id_self(), make_message(MSG_SPAWN, sizeof(role_t), &role_g));
+    } else {
+        send_message((actor_id_t) data, make_message(MSG_READY, 0, (void *) actor_id_self()));
+    }
+}
+
+static void ready(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+
+    actor_system_metrics_t metrics;
+    if (actor_system_metrics(&metrics) == 0) {
+        running_snapshot_g = metrics.nactors == 2 && metrics.nworkers == POOL_SIZE;
+        actor_system_metrics_free(&metrics);
+    }
+    enabled_while_running_g = actor_system_enable_metrics(NULL, 0) == 0;
+
+    actor_id_t child = (actor_id_t) data;
+    for (long i = 0; i < MESSAGES; ++i) {
+        send_message(child, make_message(MSG_NUMBER, 0, (void *) i));
+    }
+    send_message(child, make_message(MSG_GODIE, 0, NULL));
+    send_message(actor_id_self(), make_message(MSG_GODIE, 0, NULL));
+}
+
+static void number(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    numbers_g++;
+}
+
+static unsigned long long histogram_sum(const unsigned long long *histogram)
+{
+    unsigned long long sum = 0;
+    for (size_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; ++i) {
+        sum += histogram[i];
+    }
+    return sum;
+}
+
+static char *metrics_disabled_by_default()
+{
+    actor_system_metrics_t metrics;
+    mu_assert("metrics without enabling", actor_system_metrics(&metrics) == -1);
+    return 0;
+}
+
+static char *metrics_count_messages()
+{
+    mu_assert("enable failed", actor_system_enable_metrics(METRICS_FILE, 1) == 0);
+
+    actor_id_t father;
+    mu_assert("create failed", actor_system_create(&father, &role_g) == 0);
+    actor_system_join(father);
+
+    mu_assert("not all numbers processed", numbers_g == MESSAGES);
+    mu_assert("no snapshot of running system", running_snapshot_g);
+    mu_assert("enabled while running", !enabled_while_running_g);
+
+    actor_system_metrics_t metrics;
+    mu_assert("no metrics after join", actor_system_metrics(&metrics) == 0);
+    mu_assert("wrong number of actors", metrics.nactors == 2);
+    mu_assert("wrong number of workers", metrics.nworkers == POOL_SIZE);
+
+    // Father sends spawn, hello, numbers and two godie, child sends ready.
+    actor_metrics_t *father_metrics = &metrics.actors[0];
+    actor_metrics_t *child_metrics = &metrics.actors[1];
+    mu_assert("wrong father sent", father_metrics->messages_sent == MESSAGES + 4);
+    mu_assert("wrong father processed", father_metrics->messages_processed == 4);
+    mu_assert("wrong child sent", child_metrics->messages_sent == 1);
+    mu_assert("wrong child processed", child_metrics->messages_processed == MESSAGES + 2);
+    mu_assert("no mailbox high water", child_metrics->mailbox_high_water >= 1);
+    mu_assert("mailbox high water over sent",
+              child_metrics->mailbox_high_water <= MESSAGES + 2);
+
+    unsigned long long tasks = 0;
+    for (size_t i = 0; i < metrics.nworkers; ++i) {
+        tasks += metrics.workers[i].tasks;
+    }
+    mu_assert("no tasks run", tasks > 0);
+    // The last task may not be counted by its thread yet.
+    mu_assert("wrong dispatch count", histogram_sum(metrics.dispatch_latency) >= tasks);
+    mu_assert("wrong handler count", histogram_sum(metrics.handler_time) == MESSAGES + 6);
+    actor_system_metrics_free(&metrics);
+
+    // The last dump has the final metrics.
+    FILE *file = fopen(METRICS_FILE, "r");
+    mu_assert("no metrics file", file != NULL);
+    char line[256];
+    char expected[256];
+    snprintf(expected, sizeof(expected), "actor 1 sent 1 processed %d ", MESSAGES + 2);
+    bool found = false;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        found = strncmp(line, expected, strlen(expected)) == 0 || found;
+    }
+    fclose(file);
+    mu_assert("final metrics not written", found);
+    remove(METRICS_FILE);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(metrics_disabled_by_default);
+    mu_run_test(metrics_count_messages);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,193 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define ROUNDS 10000
+#define PAYLOAD_SIZE 100
+
+#define BURST 300
+
+#define MSG_BALL (message_type_t)1
+#define MSG_BURST (message_type_t)1
+#define MSG_PIECE (message_type_t)2
+
+int tests_run = 0;
+
+static long rounds_g;
+static long corrupted_g;
+static long pieces_g;
+static long not_payload_g = 42;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void ball(void **stateptr, size_t nbytes, void *data);
+
+static act_t prompts_g[] = { hello, ball };
+static role_t role_g = { .nprompts = 2, .prompts = prompts_g };
+
+static void burst_hello(void **stateptr, size_t nbytes, void *data);
+static void burst(void **stateptr, size_t nbytes, void *data);
+static void piece(void **stateptr, size_t nbytes, void *data);
+
+static act_t burst_prompts_g[] = { burst_hello, burst, piece };
+static role_t burst_role_g = { .nprompts = 3, .prompts = burst_prompts_g };
+
+static void send_ball(long round)
+{
+    long *data = (long *) message_payload_alloc(PAYLOAD_SIZE * sizeof(long));
+    for (int i = 0; i < PAYLOAD_SIZE; ++i) {
+        data[i] = round;
+    }
+    // Unsent payload is freed by the runtime.
+    memset(message_payload_alloc(PAYLOAD_SIZE), 0, PAYLOAD_SIZE);
+
+    message_t message;
+    message.message_type = MSG_BALL;
+    message.nbytes = PAYLOAD_SIZE * sizeof(long);
+    message.data = data;
+    send_message(actor_id_self(), message);
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    send_ball(0);
+}
+
+// Actor sends itself payloads, each of them freed after it is processed.
+static void ball(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+
+    long *numbers = (long *) data;
+    if (nbytes != PAYLOAD_SIZE * sizeof(long)) {
+        corrupted_g++;
+    }
+    for (int i = 0; i < PAYLOAD_SIZE; ++i) {
+        if (numbers[i] != rounds_g) {
+            corrupted_g++;
+        }
+    }
+
+    if (++rounds_g < ROUNDS) {
+        send_ball(rounds_g);
+    } else {
+        message_t godie;
+        godie.message_type = MSG_GODIE;
+        godie.nbytes = 0;
+        godie.data = NULL;
+        send_message(actor_id_self(), godie);
+    }
+}
+
+static char *payloads_delivered_intact()
+{
+    actor_id_t actor;
+    mu_assert("create failed", actor_system_create(&actor, &role_g) == 0);
+    actor_system_join(actor);
+
+    mu_assert("not all rounds played", rounds_g == ROUNDS);
+    mu_assert("payload corrupted", corrupted_g == 0);
+    return 0;
+}
+
+static void burst_hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    message_t message;
+    message.message_type = MSG_BURST;
+    message.nbytes = 0;
+    message.data = NULL;
+    send_message(actor_id_self(), message);
+}
+
+// Handler keeps many payloads unsent, then sends them oldest first,
+// with messages whose data is not a payload between them.
+static void burst(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    long *pieces[BURST];
+    for (long i = 0; i < BURST; ++i) {
+        pieces[i] = (long *) message_payload_alloc(sizeof(long));
+        *pieces[i] = i;
+    }
+
+    message_t message;
+    message.message_type = MSG_PIECE;
+    message.nbytes = sizeof(long);
+    for (long i = 0; i < BURST; ++i) {
+        message.data = pieces[i];
+        send_message(actor_id_self(), message);
+        message.data = &not_payload_g;
+        send_message(actor_id_self(), message);
+    }
+}
+
+static void piece(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+
+    long number = *(long *) data;
+    if (data == &not_payload_g) {
+        if (number != 42) {
+            corrupted_g++;
+        }
+        return;
+    }
+    if (number != pieces_g) {
+        corrupted_g++;
+    }
+
+    if (++pieces_g == BURST) {
+        message_t godie;
+        godie.message_type = MSG_GODIE;
+        godie.nbytes = 0;
+        godie.data = NULL;
+        send_message(actor_id_self(), godie);
+    }
+}
+
+static char *unsent_payloads_sent_in_any_order()
+{
+    corrupted_g = 0;
+    actor_id_t actor;
+    mu_assert("create failed", actor_system_create(&actor, &burst_role_g) == 0);
+    actor_system_join(actor);
+
+    mu_assert("not all pieces delivered", pieces_g == BURST);
+    mu_assert("piece corrupted", corrupted_g == 0);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(payloads_delivered_intact);
+    mu_run_test(unsent_payloads_sent_in_any_order);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,161 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHILDREN 16
+#define NUMBERS 1000
+
+#define MSG_CHILD_READY (message_type_t)1
+#define MSG_NUMBER (message_type_t)2
+#define MSG_CHILD_DONE (message_type_t)3
+
+int tests_run = 0;
+
+typedef struct child {
+    actor_id_t father_id;
+    atomic_int running;
+    long next_number;
+} child_t;
+
+static actor_id_t children_g[CHILDREN];
+static long children_ready_g;
+static long children_done_g;
+static atomic_long reordered_g;
+static atomic_long overlapped_g;
+
+static void father_hello(void **stateptr, size_t nbytes, void *data);
+static void child_hello(void **stateptr, size_t nbytes, void *data);
+static void child_ready(void **stateptr, size_t nbytes, void *data);
+static void number(void **stateptr, size_t nbytes, void *data);
+static void child_done(void **stateptr, size_t nbytes, void *data);
+
+static act_t father_prompts_g[] = { father_hello, child_ready, number, child_done };
+static role_t father_role_g = { .nprompts = 4, .prompts = father_prompts_g };
+static act_t child_prompts_g[] = { child_hello, child_ready, number, child_done };
+static role_t child_role_g = { .nprompts = 4, .prompts = child_prompts_g };
+
+static message_t make_message(message_type_t type, void *data)
+{
+    message_t message;
+    message.message_type = type;
+    message.nbytes = 0;
+    message.data = data;
+    return message;
+}
+
+static void father_hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    for (int child = 0; child < CHILDREN; ++child) {
+        message_t spawn = make_message(MSG_SPAWN, &child_role_g);
+        spawn.nbytes = sizeof(role_t);
+        send_message(actor_id_self(), spawn);
+    }
+}
+
+static void child_hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) nbytes;
+
+    child_t *child = (child_t *) malloc(sizeof(child_t));
+    child->father_id = (actor_id_t) data;
+    atomic_init(&child->running, 0);
+    child->next_number = 0;
+    *stateptr = child;
+
+    send_message(child->father_id, make_message(MSG_CHILD_READY, (void *) actor_id_self()));
+}
+
+// Father sends every child numbers in order, once all of them are ready.
+static void child_ready(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+
+    children_g[children_ready_g++] = (actor_id_t) data;
+    if (children_ready_g < CHILDREN) {
+        return;
+    }
+
+    for (long i = 0; i < NUMBERS; ++i) {
+        for (int child = 0; child < CHILDREN; ++child) {
+            send_message(children_g[child], make_message(MSG_NUMBER, (void *) i));
+        }
+    }
+}
+
+static void number(void **stateptr, size_t nbytes, void *data)
+{
+    (void) nbytes;
+
+    child_t *child = (child_t *) *stateptr;
+    if (atomic_fetch_add(&child->running, 1) != 0) {
+        atomic_fetch_add(&overlapped_g, 1);
+    }
+
+    if ((long) data != child->next_number) {
+        atomic_fetch_add(&reordered_g, 1);
+    }
+    child->next_number++;
+    if (child->next_number == NUMBERS) {
+        send_message(child->father_id, make_message(MSG_CHILD_DONE, NULL));
+        send_message(actor_id_self(), make_message(MSG_GODIE, NULL));
+    }
+
+    atomic_fetch_sub(&child->running, 1);
+    if (child->next_number == NUMBERS) {
+        free(child);
+    }
+}
+
+static void child_done(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    if (++children_done_g == CHILDREN) {
+        send_message(actor_id_self(), make_message(MSG_GODIE, NULL));
+    }
+}
+
+static char *actors_process_messages_in_order()
+{
+    actor_id_t father;
+    mu_assert("create failed", actor_system_create(&father, &father_role_g) == 0);
+    actor_system_join(father);
+
+    mu_assert("not all children done", children_done_g == CHILDREN);
+    mu_assert("messages reordered", atomic_load(&reordered_g) == 0);
+    mu_assert("actor processed messages concurrently", atomic_load(&overlapped_g) == 0);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(actors_process_messages_in_order);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -0,0 +1,130 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define SELF_MESSAGES 100000
+#define EXTERNAL_MESSAGES 20000
+
+#define MSG_SELF (message_type_t)1
+#define MSG_EXTERNAL (message_type_t)2
+
+int tests_run = 0;
+
+static long sent_g;
+static long next_self_g;
+static long next_external_g;
+static long reordered_g;
+static atomic_bool started_g;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void self(void **stateptr, size_t nbytes, void *data);
+static void external(void **stateptr, size_t nbytes, void *data);
+
+static act_t prompts_g[] = { hello, self, external };
+static role_t role_g = { .nprompts = 3, .prompts = prompts_g };
+
+static message_t make_message(message_type_t type, long number)
+{
+    message_t message;
+    message.message_type = type;
+    message.nbytes = 0;
+    message.data = (void *) number;
+    return message;
+}
+
+// Sends itself two messages, so they pile up while other messages arrive.
+static void send_self()
+{
+    for (int i = 0; i < 2 && sent_g < SELF_MESSAGES; ++i) {
+        if (send_message(actor_id_self(), make_message(MSG_SELF, sent_g)) == 0) {
+            sent_g++;
+        }
+    }
+}
+
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+    atomic_store(&started_g, true);
+    send_self();
+}
+
+static void self(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+
+    if ((long) data != next_self_g++) {
+        reordered_g++;
+    }
+    if (next_self_g == SELF_MESSAGES) {
+        send_message(actor_id_self(), make_message(MSG_GODIE, 0));
+    } else {
+        send_self();
+    }
+}
+
+static void external(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+
+    if ((long) data != next_external_g++) {
+        reordered_g++;
+    }
+}
+
+static char *messages_to_self_in_order()
+{
+    actor_id_t actor;
+    mu_assert("create failed", actor_system_create(&actor, &role_g) == 0);
+
+    while (!atomic_load(&started_g)) {
+        sched_yield();
+    }
+    long external_sent = 0;
+    while (external_sent < EXTERNAL_MESSAGES) {
+        int result = send_message(actor, make_message(MSG_EXTERNAL, external_sent));
+        if (result == 0) {
+            external_sent++;
+        } else if (result == -1) {
+            break;
+        } else {
+            sched_yield();
+        }
+    }
+    actor_system_join(actor);
+
+    mu_assert("messages to self lost", next_self_g == SELF_MESSAGES);
+    mu_assert("external messages lost", next_external_g == external_sent);
+    mu_assert("messages reordered", reordered_g == 0);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(messages_to_self_in_order);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
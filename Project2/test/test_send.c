@@ -0,0 +1,113 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define MSG_COUNT (message_type_t)1
+
+int tests_run = 0;
+
+static atomic_bool filled_g;
+static atomic_long counted_g;
+static long accepted_g;
+static int full_result_g;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void count(void **stateptr, size_t nbytes, void *data);
+
+static act_t prompts_g[] = { hello, count };
+static role_t role_g = { .nprompts = 2, .prompts = prompts_g };
+
+static message_t make_message(message_type_t type)
+{
+    message_t message;
+    message.message_type = type;
+    message.nbytes = 0;
+    message.data = NULL;
+    return message;
+}
+
+// Fills own mailbox until it is full.
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    int result;
+    while ((result = send_message(actor_id_self(), make_message(MSG_COUNT))) == 0) {
+        accepted_g++;
+    }
+    full_result_g = result;
+    atomic_store(&filled_g, true);
+}
+
+static void count(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    atomic_fetch_add(&counted_g, 1);
+}
+
+static char *send_results()
+{
+    actor_id_t actor;
+    mu_assert("create failed", actor_system_create(&actor, &role_g) == 0);
+
+    while (!atomic_load(&filled_g)) {
+        sched_yield();
+    }
+    mu_assert("full mailbox accepted message", full_result_g == -3);
+    mu_assert("mailbox limit not reached", accepted_g == ACTOR_QUEUE_LIMIT);
+
+    mu_assert("message to missing actor", send_message(actor + 1000, make_message(MSG_COUNT)) == -2);
+    mu_assert("message to negative actor", send_message(-1, make_message(MSG_COUNT)) == -2);
+
+    int result;
+    while ((result = send_message(actor, make_message(MSG_GODIE))) == -3) {
+        sched_yield();
+    }
+    mu_assert("godie not accepted", result == 0);
+
+    // Messages sent before godie is processed are still delivered.
+    long sent_after_godie = 0;
+    while ((result = send_message(actor, make_message(MSG_COUNT))) != -1) {
+        mu_assert("unexpected result", result == 0 || result == -3);
+        if (result == 0) {
+            sent_after_godie++;
+        }
+        sched_yield();
+    }
+
+    actor_system_join(actor);
+    mu_assert("messages lost",
+              atomic_load(&counted_g) == ACTOR_QUEUE_LIMIT + sent_after_godie);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(send_results);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
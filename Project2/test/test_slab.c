@@ -0,0 +1,134 @@
+#include "minunit.h"
+#include "slab.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BLOCKS 1000
+#define THREADS 4
+
+int tests_run = 0;
+
+static char *freed_block_reused()
+{
+    void *block = slab_alloc(48);
+    slab_free(block, 48);
+    mu_assert("freed block not reused", slab_alloc(40) == block);
+    slab_free(block, 40);
+
+    void *big = slab_alloc(SLAB_MAX_SIZE + 1);
+    memset(big, 0, SLAB_MAX_SIZE + 1);
+    slab_free(big, SLAB_MAX_SIZE + 1);
+    return 0;
+}
+
+static char *blocks_do_not_overlap()
+{
+    unsigned char *blocks[BLOCKS];
+    for (int i = 0; i < BLOCKS; ++i) {
+        size_t size = (size_t) i % SLAB_MAX_SIZE + 1;
+        blocks[i] = (unsigned char *) slab_alloc(size);
+        memset(blocks[i], i % 256, size);
+    }
+    for (int i = 0; i < BLOCKS; ++i) {
+        size_t size = (size_t) i % SLAB_MAX_SIZE + 1;
+        for (size_t j = 0; j < size; ++j) {
+            mu_assert("block overwritten", blocks[i][j] == i % 256);
+        }
+        slab_free(blocks[i], size);
+    }
+    slab_flush();
+    return 0;
+}
+
+static void *consumer(void *arg)
+{
+    void **blocks = (void **) arg;
+    for (int i = 0; i < BLOCKS; ++i) {
+        slab_free(blocks[i], sizeof(long));
+    }
+    slab_flush();
+    return NULL;
+}
+
+// Blocks allocated by one thread and freed by another come back to the first one.
+static char *blocks_freed_by_other_threads()
+{
+    for (int round = 0; round < THREADS; ++round) {
+        void *blocks[BLOCKS];
+        for (int i = 0; i < BLOCKS; ++i) {
+            blocks[i] = slab_alloc(sizeof(long));
+            *(long *) blocks[i] = i;
+        }
+        pthread_t thread;
+        pthread_create(&thread, NULL, consumer, blocks);
+        pthread_join(thread, NULL);
+    }
+    slab_flush();
+    slab_release();
+    return 0;
+}
+
+#define UNFLUSHED_BLOCKS 10
+#define UNFLUSHED_SIZE 512
+
+static void *unflushed_consumer(void *arg)
+{
+    void **blocks = (void **) arg;
+    for (int i = 0; i < UNFLUSHED_BLOCKS; ++i) {
+        slab_free(blocks[i], UNFLUSHED_SIZE);
+    }
+    return NULL;
+}
+
+// Thread which exits without slab_flush leaves its blocks to other threads.
+static char *caches_flushed_at_thread_exit()
+{
+    slab_flush();
+    slab_release();
+
+    void *blocks[UNFLUSHED_BLOCKS];
+    for (int i = 0; i < UNFLUSHED_BLOCKS; ++i) {
+        blocks[i] = slab_alloc(UNFLUSHED_SIZE);
+    }
+    pthread_t thread;
+    pthread_create(&thread, NULL, unflushed_consumer, blocks);
+    pthread_join(thread, NULL);
+
+    void *block = slab_alloc(UNFLUSHED_SIZE);
+    int found = 0;
+    for (int i = 0; i < UNFLUSHED_BLOCKS; ++i) {
+        found = found || block == blocks[i];
+    }
+    mu_assert("blocks of exited thread not reused", found);
+    slab_free(block, UNFLUSHED_SIZE);
+    slab_flush();
+    slab_release();
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(freed_block_reused);
+    mu_run_test(blocks_do_not_overlap);
+    mu_run_test(blocks_freed_by_other_threads);
+    mu_run_test(caches_flushed_at_thread_exit);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
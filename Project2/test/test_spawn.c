@@ -0,0 +1,87 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+// More than fits in a few segments of the actor registry.
+#define ACTORS 5000
+
+int tests_run = 0;
+
+static atomic_long spawned_g;
+static atomic_int hello_g[ACTORS];
+static atomic_long wrong_father_g;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+
+static act_t prompts_g[] = { hello };
+static role_t role_g = { .nprompts = 1, .prompts = prompts_g };
+
+static message_t make_message(message_type_t type, size_t nbytes, void *data)
+{
+    message_t message;
+    message.message_type = type;
+    message.nbytes = nbytes;
+    message.data = data;
+    return message;
+}
+
+// Every actor spawns up to two children, so many actors spawn at once.
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+
+    actor_id_t self = actor_id_self();
+    if (self < 0 || self >= ACTORS) {
+        atomic_fetch_add(&wrong_father_g, 1);
+        return;
+    }
+    atomic_fetch_add(&hello_g[self], 1);
+    if (self != 0 && (actor_id_t) data >= self) {
+        atomic_fetch_add(&wrong_father_g, 1);
+    }
+
+    for (int child = 0; child < 2; ++child) {
+        if (atomic_fetch_add(&spawned_g, 1) < ACTORS - 1) {
+            send_message(self, make_message(MSG_SPAWN, sizeof(role_t), &role_g));
+        }
+    }
+    send_message(self, make_message(MSG_GODIE, 0, NULL));
+}
+
+static char *every_actor_gets_own_id()
+{
+    actor_id_t first;
+    mu_assert("create failed", actor_system_create(&first, &role_g) == 0);
+    actor_system_join(first);
+
+    mu_assert("wrong father", atomic_load(&wrong_father_g) == 0);
+    for (int i = 0; i < ACTORS; ++i) {
+        mu_assert("actor did not get exactly one hello", atomic_load(&hello_g[i]) == 1);
+    }
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(every_actor_gets_own_id);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
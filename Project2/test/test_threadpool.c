@@ -0,0 +1,156 @@
+#include "minunit.h"
+#include "threadpool.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+#define DEPTH 12
+#define POOL_THREADS 4
+#define TASKS (2 * ((1L << (DEPTH + 1)) - 1))
+#define BLOCKING_TASKS 4
+#define IDLE_TIMEOUT_MS 20
+#define WAIT_STEPS 5000
+
+int tests_run = 0;
+
+typedef struct task_arg {
+    thread_pool_t *pool;
+    int depth;
+} task_arg_t;
+
+static atomic_long executed_g;
+
+// Task adding two smaller tasks, so most tasks are added by pool threads.
+static void split(void *arg)
+{
+    task_arg_t *task = (task_arg_t *) arg;
+    atomic_fetch_add(&executed_g, 1);
+    if (task->depth > 0) {
+        task_arg_t child = { .pool = task->pool, .depth = task->depth - 1 };
+        thread_pool_add_task(task->pool, split, &child, sizeof(child));
+        thread_pool_add_task(task->pool, split, &child, sizeof(child));
+    }
+}
+
+static char *run_all_tasks(thread_pool_mode_t mode)
+{
+    atomic_store(&executed_g, 0);
+    thread_pool_t *pool = thread_pool_init_mode(POOL_THREADS, mode);
+    task_arg_t root = { .pool = pool, .depth = DEPTH };
+    thread_pool_add_task(pool, split, &root, sizeof(root));
+    thread_pool_add_task(pool, split, &root, sizeof(root));
+
+    // Tasks cannot be added after shutdown.
+    while (atomic_load(&executed_g) < TASKS) {
+        sched_yield();
+    }
+    thread_pool_shutdown(pool);
+
+    mu_assert("task executed twice", atomic_load(&executed_g) == TASKS);
+    return 0;
+}
+
+static char *shared_queue()
+{
+    return run_all_tasks(THREAD_POOL_SHARED_QUEUE);
+}
+
+static char *work_stealing()
+{
+    return run_all_tasks(THREAD_POOL_WORK_STEALING);
+}
+
+static atomic_long blocked_g;
+static atomic_long unblocked_g;
+
+static void sleep_ms(long ms)
+{
+    struct timespec time = { .tv_sec = 0, .tv_nsec = ms * 1000000 };
+    nanosleep(&time, NULL);
+}
+
+// Task blocking until all blocking tasks run at once, so only new threads can run them.
+static void block(void *arg)
+{
+    (void) arg;
+    atomic_fetch_add(&blocked_g, 1);
+    for (int i = 0; i < WAIT_STEPS && atomic_load(&blocked_g) < BLOCKING_TASKS; ++i) {
+        sleep_ms(1);
+    }
+    if (atomic_load(&blocked_g) == BLOCKING_TASKS) {
+        atomic_fetch_add(&unblocked_g, 1);
+    }
+}
+
+static char *grow_and_retire(thread_pool_mode_t mode)
+{
+    atomic_store(&blocked_g, 0);
+    atomic_store(&unblocked_g, 0);
+    thread_pool_t *pool = thread_pool_init_elastic(1, BLOCKING_TASKS, IDLE_TIMEOUT_MS, mode);
+    mu_assert("wrong number of threads at start", thread_pool_threads(pool) == 1);
+
+    for (int i = 0; i < BLOCKING_TASKS; ++i) {
+        thread_pool_add_task(pool, block, NULL, 0);
+    }
+    for (int i = 0; i < WAIT_STEPS && atomic_load(&unblocked_g) < BLOCKING_TASKS; ++i) {
+        sleep_ms(1);
+    }
+    mu_assert("threads not added for blocked tasks", atomic_load(&unblocked_g) == BLOCKING_TASKS);
+    mu_assert("too many threads", thread_pool_threads(pool) <= BLOCKING_TASKS);
+
+    for (int i = 0; i < WAIT_STEPS && thread_pool_threads(pool) > 1; ++i) {
+        sleep_ms(1);
+    }
+    mu_assert("idle threads not retired", thread_pool_threads(pool) == 1);
+
+    // Slots of retired threads are reused.
+    atomic_store(&blocked_g, 0);
+    atomic_store(&unblocked_g, 0);
+    for (int i = 0; i < BLOCKING_TASKS; ++i) {
+        thread_pool_add_task(pool, block, NULL, 0);
+    }
+    for (int i = 0; i < WAIT_STEPS && atomic_load(&unblocked_g) < BLOCKING_TASKS; ++i) {
+        sleep_ms(1);
+    }
+    mu_assert("threads not added again", atomic_load(&unblocked_g) == BLOCKING_TASKS);
+
+    thread_pool_shutdown(pool);
+    return 0;
+}
+
+static char *elastic_shared_queue()
+{
+    return grow_and_retire(THREAD_POOL_SHARED_QUEUE);
+}
+
+static char *elastic_work_stealing()
+{
+    return grow_and_retire(THREAD_POOL_WORK_STEALING);
+}
+
+static char *all_tests()
+{
+    mu_run_test(shared_queue);
+    mu_run_test(work_stealing);
+    mu_run_test(elastic_shared_queue);
+    mu_run_test(elastic_work_stealing);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
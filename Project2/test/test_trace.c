@@ -0,0 +1,157 @@
+#include "minunit.h"
+#include "cacti.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define ROUNDS 100
+#define TRACE_FILE "test_trace.json"
+
+#define MSG_PING (message_type_t)1
+#define MSG_PONG (message_type_t)2
+
+int tests_run = 0;
+
+static actor_id_t father_g;
+static long pongs_g;
+
+static void hello(void **stateptr, size_t nbytes, void *data);
+static void ping(void **stateptr, size_t nbytes, void *data);
+static void pong(void **stateptr, size_t nbytes, void *data);
+
+static act_t prompts_g[] = { hello, ping, pong };
+static role_t role_g = { .nprompts = 3, .prompts = prompts_g };
+
+static message_t make_message(message_type_t type, size_t nbytes, void *data)
+{
+    message_t message;
+    message.message_type = type;
+    message.nbytes = nbytes;
+    message.data = data;
+    return message;
+}
+
+// Father spawns a child, which plays ping-pong with it.
+static void hello(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+
+    if (nbytes == 0) {
+        father_g = actor_id_self();
+        send_message(actor_id_self(), make_message(MSG_SPAWN, sizeof(role_t), &role_g));
+    } else {
+        send_message((actor_id_t) data, make_message(MSG_PING, 0, (void *) actor_id_self()));
+    }
+}
+
+static void ping(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    send_message((actor_id_t) data, make_message(MSG_PONG, 0, NULL));
+}
+
+static void pong(void **stateptr, size_t nbytes, void *data)
+{
+    (void) stateptr;
+    (void) nbytes;
+    (void) data;
+
+    if (++pongs_g < ROUNDS) {
+        send_message(father_g, make_message(MSG_PING, 0, (void *) actor_id_self()));
+    } else {
+        send_message(father_g, make_message(MSG_GODIE, 0, NULL));
+        send_message(actor_id_self(), make_message(MSG_GODIE, 0, NULL));
+    }
+}
+
+// Returns number of lines of trace file containing text.
+static long count_lines(const char *text)
+{
+    FILE *file = fopen(TRACE_FILE, "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    char line[512];
+    long count = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strstr(line, text) != NULL) {
+            ++count;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+static char *run_ping_pong(size_t events_per_thread)
+{
+    pongs_g = 0;
+    mu_assert("enable failed", actor_system_enable_trace(TRACE_FILE, events_per_thread) == 0);
+
+    actor_id_t father;
+    mu_assert("create failed", actor_system_create(&father, &role_g) == 0);
+    actor_system_join(father);
+
+    mu_assert("not all rounds played", pongs_g == ROUNDS);
+    return 0;
+}
+
+static char *trace_records_handlers_and_messages()
+{
+    char *result = run_ping_pong(10000);
+    if (result != 0) {
+        return result;
+    }
+
+    // Every message is sent once and handled once: hello, spawn, hello of child,
+    // pings, pongs and two godie.
+    long messages = 2 * ROUNDS + 5;
+    mu_assert("wrong number of handlers", count_lines("\"ph\":\"X\"") == messages);
+    mu_assert("wrong number of sends", count_lines("\"ph\":\"s\"") == messages);
+    mu_assert("wrong number of receives", count_lines("\"ph\":\"f\"") == messages);
+    mu_assert("ping not traced", count_lines("\"from\":1,\"to\":0,\"type\":1}") == ROUNDS);
+    mu_assert("pong not traced", count_lines("\"from\":0,\"to\":1,\"type\":2}") == ROUNDS);
+    mu_assert("trace not closed", count_lines("]}") == 1);
+    return 0;
+}
+
+static char *full_buffers_keep_newest_events()
+{
+    char *result = run_ping_pong(4);
+    if (result != 0) {
+        return result;
+    }
+
+    // Pool threads and the main thread keep at most 4 events each.
+    long events = count_lines("\"ph\":\"X\"") + count_lines("\"ph\":\"s\"");
+    mu_assert("too many events kept", events > 0 && events <= 4 * (POOL_SIZE + 1));
+    mu_assert("last godie not kept", count_lines("\"name\":\"godie\",\"cat\":\"handler\"") >= 1);
+
+    mu_assert("disable failed", actor_system_enable_trace(NULL, 0) == 0);
+    remove(TRACE_FILE);
+    return 0;
+}
+
+static char *all_tests()
+{
+    mu_run_test(trace_records_handlers_and_messages);
+    mu_run_test(full_buffers_keep_newest_events);
+    return 0;
+}
+
+int main()
+{
+    char *result = all_tests();
+    if (result != 0)
+    {
+        printf(__FILE__ ": %s\n", result);
+    }
+    else
+    {
+        printf(__FILE__ ": ALL TESTS PASSED\n");
+    }
+    printf(__FILE__ ": Tests run: %d\n", tests_run);
+
+    return result != 0;
+}
@@ -1,19 +1,43 @@
 #include "threadpool.h"
 #include "err.h"
 
+#include <errno.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h>
+#include <time.h>
 
+#include "deque.h"
+#include "slab.h"
 #include "queue.h"
 #include "dynarray.h"
 
+// How often the pool checks if it needs another thread.
+#define POOL_MONITOR_INTERVAL_MS 10
+
+// Task with a copy of its argument.
 typedef struct runnable {
     void (*function)(void *);
-    void *arg;
     size_t arg_size;
+    _Alignas(max_align_t) char arg[];
 } runnable_t;
 
+// Thread of the pool. Statistics are written only by the thread itself.
+typedef struct worker {
+    thread_pool_t *pool;
+    deque_t tasks; // Used only in work stealing mode.
+    unsigned random_state; // For choosing workers to steal from.
+    bool started; // Thread was created and not joined yet.
+    bool active;  // Thread is running tasks, it did not retire.
+    atomic_ullong busy_ns;
+    atomic_ullong idle_ns;
+    atomic_ullong tasks_run;
+    atomic_ullong steals;
+    atomic_ullong wakeups;
+} worker_t;
+
 typedef pthread_t *pthread_dynamic_arr_t;
 typedef queue *runnable_queue_t;
 
@@ -24,48 +48,460 @@ struct thread_pool {
     pthread_cond_t
         thread_pool_cond; // Condition variable worker threads wait on.
 
+    // Queue of runnable_t pointers. In work stealing mode
+    // it has only tasks added by threads which are not workers of the pool.
     runnable_queue_t tasks;
 
     bool shutdown; // Flag set after thread_pool_shutdown.
+
+    thread_pool_mode_t mode;
+    worker_t *workers;
+    size_t num_workers; // Maximal number of threads.
+    size_t min_workers;
+    size_t live_workers; // Threads which did not retire.
+    unsigned long idle_timeout_ms; // Threads above min_workers retire after it, 0 if never.
+    bool elastic;             // Set if monitor thread runs.
+    pthread_t monitor;        // Starts threads when tasks wait and no thread is idle.
+    pthread_cond_t monitor_cond;
+    atomic_size_t sleeping; // Workers waiting on thread_pool_cond.
+    atomic_size_t queued;   // Size of tasks, read without the mutex.
+    atomic_bool measure_time; // Set to measure busy and idle time of threads.
 };
 
-// Function run by threadpool thread.
+// Worker running the current thread, NULL if it is not a worker.
+static _Thread_local worker_t *current_worker;
+
+static runnable_t *runnable_create(void (*function)(void *),
+                                   void *arg,
+                                   size_t arg_size) {
+    runnable_t *runnable = (runnable_t *) slab_alloc(sizeof(runnable_t) + arg_size);
+    runnable->function = function;
+    runnable->arg_size = arg_size;
+    memcpy(runnable->arg, arg, arg_size);
+    return runnable;
+}
+
+static void runnable_run(runnable_t *runnable) {
+    (*(runnable->function))(runnable->arg);
+    slab_free(runnable, sizeof(runnable_t) + runnable->arg_size);
+}
+
+static unsigned long long now_ns() {
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now)) {
+        fatal(__FILE__, __LINE__);
+    }
+    return (unsigned long long) now.tv_sec * 1000000000ULL + (unsigned long long) now.tv_nsec;
+}
+
+// Adds value to statistic of the worker running the current thread.
+static void stat_add(atomic_ullong *stat, unsigned long long value) {
+    atomic_store_explicit(stat,
+                          atomic_load_explicit(stat, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+// Runs task of worker, measuring its time if needed.
+static void worker_run(worker_t *worker, runnable_t *task) {
+    if (!atomic_load_explicit(&worker->pool->measure_time, memory_order_relaxed)) {
+        runnable_run(task);
+    } else {
+        unsigned long long start = now_ns();
+        runnable_run(task);
+        stat_add(&worker->busy_ns, now_ns() - start);
+    }
+    stat_add(&worker->tasks_run, 1);
+}
+
+// Returns time after given number of milliseconds, for timed waits. Condition variables
+// of the pool wait on the monotonic clock, so changes of system time do not shorten
+// or extend idle timeouts and monitor ticks.
+static struct timespec deadline_after(unsigned long ms) {
+    struct timespec deadline;
+    if (clock_gettime(CLOCK_MONOTONIC, &deadline)) {
+        fatal(__FILE__, __LINE__);
+    }
+    deadline.tv_sec += (time_t) (ms / 1000);
+    deadline.tv_nsec += (long) (ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+// Waits on condition variable of pool, counting time and wakeups of worker.
+// Returns true if the worker waited for idle timeout and there are
+// more threads than the minimum, so it may retire.
+static bool worker_wait(worker_t *worker) {
+    thread_pool_t *pool = worker->pool;
+    bool measure = atomic_load_explicit(&pool->measure_time, memory_order_relaxed);
+    unsigned long long start = measure ? now_ns() : 0;
+    bool timed_out = false;
+
+    if (pool->idle_timeout_ms > 0 && pool->live_workers > pool->min_workers) {
+        struct timespec deadline = deadline_after(pool->idle_timeout_ms);
+        int result = pthread_cond_timedwait(&(pool->thread_pool_cond),
+                                            &(pool->thread_pool_mutex),
+                                            &deadline);
+        if (result == ETIMEDOUT) {
+            timed_out = true;
+        } else if (result) {
+            fatal(__FILE__, __LINE__);
+        }
+    } else if (pthread_cond_wait(&(pool->thread_pool_cond), &(pool->thread_pool_mutex))) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    if (measure) {
+        stat_add(&worker->idle_ns, now_ns() - start);
+    }
+    if (!timed_out) {
+        stat_add(&worker->wakeups, 1);
+    }
+    return timed_out && pool->live_workers > pool->min_workers;
+}
+
+// Marks worker as retired, so its slot may get a new thread. Pool mutex must be held.
+static void worker_retire(worker_t *worker) {
+    worker->active = false;
+    worker->pool->live_workers--;
+}
+
+// Function run by threadpool thread in shared queue mode.
 // Takes tasks from queue and runs them.
-static void *thread_pool_thread(void *thread_pool) {
-    thread_pool_t *pool = (thread_pool_t *) thread_pool;
+static void *thread_pool_thread(void *worker_arg) {
+    worker_t *worker = (worker_t *) worker_arg;
+    thread_pool_t *pool = worker->pool;
+    current_worker = worker;
 
     while (true) {
         if (pthread_mutex_lock(&(pool->thread_pool_mutex))) {
             fatal(__FILE__, __LINE__);
         }
 
-        while (getSize(pool->tasks) == 0 && !pool->shutdown) {
-            pthread_cond_wait(&(pool->thread_pool_cond),
-                              &(pool->thread_pool_mutex));
+        bool idle = false;
+        atomic_fetch_add(&pool->sleeping, 1);
+        while (getSize(pool->tasks) == 0 && !pool->shutdown && !idle) {
+            idle = worker_wait(worker);
         }
+        atomic_fetch_sub(&pool->sleeping, 1);
 
-        if (pool->shutdown && getSize(pool->tasks) == 0) {
+        if (getSize(pool->tasks) == 0 && (pool->shutdown || idle)) {
+            if (!pool->shutdown) {
+                worker_retire(worker);
+            }
             if (pthread_mutex_unlock(&(pool->thread_pool_mutex))) {
                 fatal(__FILE__, __LINE__);
             }
             break;
         }
 
-        runnable_t task;
+        runnable_t *task;
         dequeue(pool->tasks, &task);
 
         if (pthread_mutex_unlock(&(pool->thread_pool_mutex))) {
             fatal(__FILE__, __LINE__);
         }
 
-        (*(task.function))(task.arg);
-        free(task.arg);
+        worker_run(worker, task);
+    }
+
+    current_worker = NULL;
+    slab_flush();
+    return 0;
+}
+
+// Takes a task added by a thread which is not a worker.
+static runnable_t *take_queued_task(thread_pool_t *pool) {
+    if (atomic_load(&pool->queued) == 0) {
+        return NULL;
+    }
+
+    if (pthread_mutex_lock(&(pool->thread_pool_mutex))) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    runnable_t *task = NULL;
+    if (getSize(pool->tasks) > 0) {
+        dequeue(pool->tasks, &task);
+        atomic_fetch_sub(&pool->queued, 1);
+    }
+
+    if (pthread_mutex_unlock(&(pool->thread_pool_mutex))) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    return task;
+}
+
+// Steals a task from workers chosen at random, starting from a random one.
+static runnable_t *steal_task(worker_t *worker) {
+    thread_pool_t *pool = worker->pool;
+
+    worker->random_state ^= worker->random_state << 13;
+    worker->random_state ^= worker->random_state >> 17;
+    worker->random_state ^= worker->random_state << 5;
+    size_t first = worker->random_state % pool->num_workers;
+
+    for (size_t i = 0; i < pool->num_workers; ++i) {
+        worker_t *victim = &pool->workers[(first + i) % pool->num_workers];
+        if (victim != worker) {
+            runnable_t *task = (runnable_t *) deque_steal(&victim->tasks);
+            if (task != NULL) {
+                stat_add(&worker->steals, 1);
+                return task;
+            }
+        }
+    }
+    return NULL;
+}
+
+static bool has_tasks(thread_pool_t *pool) {
+    if (atomic_load(&pool->queued) > 0) {
+        return true;
+    }
+    for (size_t i = 0; i < pool->num_workers; ++i) {
+        if (deque_size(&pool->workers[i].tasks) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Wakes one sleeping worker, if there is one.
+static void wake_worker(thread_pool_t *pool) {
+    // Pairs with the fence of a worker going to sleep, so either it sees
+    // the new task or this thread sees it sleeping.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&pool->sleeping) == 0) {
+        return;
+    }
+
+    if (pthread_mutex_lock(&(pool->thread_pool_mutex))) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    if (pthread_cond_signal(&(pool->thread_pool_cond))) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    if (pthread_mutex_unlock(&(pool->thread_pool_mutex))) {
+        fatal(__FILE__, __LINE__);
+    }
+}
+
+// Function run by threadpool thread in work stealing mode.
+// Takes tasks from own deque, then from queue, then steals from other workers.
+// Sleeps when there are no tasks.
+static void *work_stealing_thread(void *worker_arg) {
+    worker_t *worker = (worker_t *) worker_arg;
+    thread_pool_t *pool = worker->pool;
+    current_worker = worker;
+
+    while (true) {
+        runnable_t *task = (runnable_t *) deque_take(&worker->tasks);
+        if (task == NULL) {
+            task = take_queued_task(pool);
+        }
+        if (task == NULL) {
+            task = steal_task(worker);
+        }
+        if (task != NULL && has_tasks(pool)) {
+            // Sleeping workers are woken one at a time,
+            // so wake the next one if there is more work.
+            wake_worker(pool);
+        }
+
+        if (task != NULL) {
+            worker_run(worker, task);
+            continue;
+        }
+
+        if (pthread_mutex_lock(&(pool->thread_pool_mutex))) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        bool idle = false;
+        atomic_fetch_add(&pool->sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        while (!has_tasks(pool) && !pool->shutdown && !idle) {
+            idle = worker_wait(worker);
+        }
+        atomic_fetch_sub(&pool->sleeping, 1);
+        // A task pushed by a worker after the check stays in its own deque,
+        // so it is run even if this one retires.
+        bool finished = (pool->shutdown || idle) && !has_tasks(pool);
+        if (finished && !pool->shutdown) {
+            worker_retire(worker);
+        }
+
+        if (pthread_mutex_unlock(&(pool->thread_pool_mutex))) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        if (finished) {
+            break;
+        }
     }
 
+    current_worker = NULL;
+    slab_flush();
     return 0;
 }
 
+bool thread_pool_help(thread_pool_t *pool) {
+    runnable_t *task = NULL;
+
+    if (pool->mode == THREAD_POOL_WORK_STEALING) {
+        worker_t *worker = current_worker != NULL && current_worker->pool == pool
+            ? current_worker
+            : NULL;
+        if (worker != NULL) {
+            task = (runnable_t *) deque_take(&worker->tasks);
+        }
+        if (task == NULL) {
+            task = take_queued_task(pool);
+        }
+        if (task == NULL && worker != NULL) {
+            task = steal_task(worker);
+        }
+    } else {
+        if (pthread_mutex_lock(&(pool->thread_pool_mutex))) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        if (getSize(pool->tasks) > 0) {
+            dequeue(pool->tasks, &task);
+        }
+
+        if (pthread_mutex_unlock(&(pool->thread_pool_mutex))) {
+            fatal(__FILE__, __LINE__);
+        }
+    }
+
+    if (task == NULL) {
+        return false;
+    }
+    if (current_worker != NULL && current_worker->pool == pool) {
+        stat_add(&current_worker->tasks_run, 1);
+    }
+    runnable_run(task);
+    return true;
+}
+
+void thread_pool_measure_time(thread_pool_t *pool, bool measure) {
+    atomic_store(&pool->measure_time, measure);
+}
+
+size_t thread_pool_size(thread_pool_t *pool) {
+    return pool->num_workers;
+}
+
+size_t thread_pool_threads(thread_pool_t *pool) {
+    if (pthread_mutex_lock(&(pool->thread_pool_mutex))) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    size_t threads = pool->live_workers;
+
+    if (pthread_mutex_unlock(&(pool->thread_pool_mutex))) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    return threads;
+}
+
+void thread_pool_stats(thread_pool_t *pool, size_t thread, thread_pool_stats_t *stats) {
+    worker_t *worker = &pool->workers[thread];
+    stats->busy_ns = atomic_load_explicit(&worker->busy_ns, memory_order_relaxed);
+    stats->idle_ns = atomic_load_explicit(&worker->idle_ns, memory_order_relaxed);
+    stats->tasks = atomic_load_explicit(&worker->tasks_run, memory_order_relaxed);
+    stats->steals = atomic_load_explicit(&worker->steals, memory_order_relaxed);
+    stats->wakeups = atomic_load_explicit(&worker->wakeups, memory_order_relaxed);
+}
+
 thread_pool_t *thread_pool_init(size_t num_threads) {
+    return thread_pool_init_mode(num_threads, THREAD_POOL_SHARED_QUEUE);
+}
+
+// Starts thread of worker in a free slot. Pool mutex must be held.
+static void start_worker(thread_pool_t *pool) {
+    for (size_t i = 0; i < pool->num_workers; i++) {
+        worker_t *worker = &pool->workers[i];
+        if (worker->active) {
+            continue;
+        }
+
+        // Thread which retired from the slot is finishing without the mutex.
+        if (worker->started && pthread_join(pool->threads[i], NULL)) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        worker->started = true;
+        worker->active = true;
+        pool->live_workers++;
+        int result = pthread_create(&pool->threads[i],
+                                    NULL,
+                                    pool->mode == THREAD_POOL_WORK_STEALING
+                                        ? work_stealing_thread
+                                        : thread_pool_thread,
+                                    (void *) worker);
+        if (result) {
+            fatal(__FILE__, __LINE__);
+        }
+        return;
+    }
+}
+
+// Function run by monitor thread of elastic pool. Tasks waiting while
+// no thread sleeps mean threads are busy or blocked, so another one is started.
+static void *monitor_thread(void *pool_arg) {
+    thread_pool_t *pool = (thread_pool_t *) pool_arg;
+
+    if (pthread_mutex_lock(&(pool->thread_pool_mutex))) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    while (!pool->shutdown) {
+        struct timespec deadline = deadline_after(POOL_MONITOR_INTERVAL_MS);
+        int result = pthread_cond_timedwait(&(pool->monitor_cond),
+                                            &(pool->thread_pool_mutex),
+                                            &deadline);
+        if (result && result != ETIMEDOUT) {
+            fatal(__FILE__, __LINE__);
+        }
+
+        bool waiting = pool->mode == THREAD_POOL_WORK_STEALING
+            ? has_tasks(pool)
+            : getSize(pool->tasks) > 0;
+        if (!pool->shutdown
+            && waiting
+            && atomic_load(&pool->sleeping) == 0
+            && pool->live_workers < pool->num_workers) {
+            start_worker(pool);
+        }
+    }
+
+    if (pthread_mutex_unlock(&(pool->thread_pool_mutex))) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    return 0;
+}
+
+thread_pool_t *thread_pool_init_mode(size_t num_threads, thread_pool_mode_t mode) {
+    return thread_pool_init_elastic(num_threads, num_threads, 0, mode);
+}
+
+thread_pool_t *thread_pool_init_elastic(size_t min_threads,
+                                        size_t max_threads,
+                                        unsigned long idle_timeout_ms,
+                                        thread_pool_mode_t mode) {
+    if (min_threads > max_threads) {
+        fatal(__FILE__, __LINE__);
+    }
+
     thread_pool_t *pool = (thread_pool_t *) malloc(sizeof(thread_pool_t));
     if (pool == NULL) {
         fatal(__FILE__, __LINE__);
@@ -77,26 +513,76 @@ thread_pool_t *thread_pool_init(size_t num_threads) {
 
     pool->threads = dynarray_create(pthread_t);
 
-    while (dynarray_length(pool->threads) < num_threads) {
+    while (dynarray_length(pool->threads) < max_threads) {
         pthread_t temp_thread;
         dynarray_push(pool->threads, temp_thread);
     }
 
-    if (pthread_cond_init(&(pool->thread_pool_cond), NULL)) {
+    pthread_condattr_t cond_attr;
+    if (pthread_condattr_init(&cond_attr)) {
         fatal(__FILE__, __LINE__);
     }
 
-    pool->tasks = createQueue(sizeof(runnable_t));
+    if (pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    if (pthread_cond_init(&(pool->thread_pool_cond), &cond_attr)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    pool->tasks = createQueue(sizeof(runnable_t *));
 
     pool->shutdown = false;
 
-    for (size_t i = 0; i < dynarray_length(pool->threads); i++) {
-        if (pthread_create(&pool->threads[i],
-                           NULL,
-                           thread_pool_thread,
-                           (void *) pool)) {
-            fatal(__FILE__, __LINE__);
-        }
+    pool->mode = mode;
+    pool->num_workers = max_threads;
+    pool->min_workers = min_threads;
+    pool->live_workers = 0;
+    pool->idle_timeout_ms = idle_timeout_ms;
+    pool->elastic = min_threads < max_threads;
+    pool->workers = (worker_t *) malloc(pool->num_workers * sizeof(worker_t));
+    if (pool->num_workers > 0 && pool->workers == NULL) {
+        fatal(__FILE__, __LINE__);
+    }
+    for (size_t i = 0; i < pool->num_workers; i++) {
+        worker_t *worker = &pool->workers[i];
+        worker->pool = pool;
+        deque_init(&worker->tasks);
+        worker->random_state = 2 * i + 1;
+        worker->started = false;
+        worker->active = false;
+        atomic_init(&worker->busy_ns, 0);
+        atomic_init(&worker->idle_ns, 0);
+        atomic_init(&worker->tasks_run, 0);
+        atomic_init(&worker->steals, 0);
+        atomic_init(&worker->wakeups, 0);
+    }
+    atomic_init(&pool->sleeping, 0);
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->measure_time, false);
+
+    if (pthread_mutex_lock(&(pool->thread_pool_mutex))) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    while (pool->live_workers < min_threads) {
+        start_worker(pool);
+    }
+
+    if (pthread_mutex_unlock(&(pool->thread_pool_mutex))) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    if (pthread_cond_init(&(pool->monitor_cond), &cond_attr)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    if (pthread_condattr_destroy(&cond_attr)) {
+        fatal(__FILE__, __LINE__);
+    }
+    if (pool->elastic && pthread_create(&pool->monitor, NULL, monitor_thread, (void *) pool)) {
+        fatal(__FILE__, __LINE__);
     }
 
     return pool;
@@ -116,18 +602,32 @@ void thread_pool_shutdown(thread_pool_t *pool) {
     if (pthread_cond_broadcast(&(pool->thread_pool_cond))) {
         fatal(__FILE__, __LINE__);
     }
+    if (pthread_cond_signal(&(pool->monitor_cond))) {
+        fatal(__FILE__, __LINE__);
+    }
 
     if (pthread_mutex_unlock(&(pool->thread_pool_mutex))) {
         fatal(__FILE__, __LINE__);
     }
 
+    // No thread is started after the monitor finishes.
+    if (pool->elastic) {
+        (pthread_join(pool->monitor, NULL));
+    }
     for (size_t i = 0; i < dynarray_length(pool->threads); i++) {
-        (pthread_join((pool->threads[i]), NULL));
+        if (pool->workers[i].started) {
+            (pthread_join((pool->threads[i]), NULL));
+        }
     }
     pthread_mutex_destroy(&(pool->thread_pool_mutex));
+    pthread_cond_destroy(&(pool->monitor_cond));
     dynarray_destroy(pool->threads);
     pthread_cond_destroy(&(pool->thread_pool_cond));
     destroyQueue(pool->tasks);
+    for (size_t i = 0; i < pool->num_workers; i++) {
+        deque_destroy(&pool->workers[i].tasks);
+    }
+    free(pool->workers);
     free(pool);
 }
 
@@ -135,10 +635,33 @@ void thread_pool_add_task(thread_pool_t *pool,
                           void (*function)(void *),
                           void *arg,
                           size_t arg_size) {
+    thread_pool_add_tasks(pool, function, arg, arg_size, 1);
+}
+
+void thread_pool_add_tasks(thread_pool_t *pool,
+                           void (*function)(void *),
+                           void *args,
+                           size_t arg_size,
+                           size_t count) {
     if (pool == NULL) {
         fatal(__FILE__, __LINE__);
     }
 
+    if (count == 0) {
+        return;
+    }
+
+    // Worker adds tasks to its own deque, others steal them when idle.
+    if (pool->mode == THREAD_POOL_WORK_STEALING
+        && current_worker != NULL && current_worker->pool == pool) {
+        for (size_t i = 0; i < count; ++i) {
+            deque_push(&current_worker->tasks,
+                       runnable_create(function, (char *) args + i * arg_size, arg_size));
+        }
+        wake_worker(pool);
+        return;
+    }
+
     if (pthread_mutex_lock(&(pool->thread_pool_mutex))) {
         fatal(__FILE__, __LINE__);
     }
@@ -147,17 +670,23 @@ void thread_pool_add_task(thread_pool_t *pool,
         fatal(__FILE__, __LINE__);
     }
 
-    runnable_t runnable;
-    runnable.function = function;
-    runnable.arg = (void *) malloc(arg_size);
-    if (runnable.arg == NULL) {
-        fatal(__FILE__, __LINE__);
+    for (size_t i = 0; i < count; ++i) {
+        runnable_t *runnable = runnable_create(function, (char *) args + i * arg_size, arg_size);
+        enqueue(pool->tasks, &runnable);
     }
-    memcpy(runnable.arg, arg, arg_size);
-
-    enqueue(pool->tasks, &runnable);
 
-    if (pthread_cond_broadcast(&(pool->thread_pool_cond))) {
+    if (pool->mode == THREAD_POOL_WORK_STEALING) {
+        atomic_fetch_add(&pool->queued, count);
+        size_t sleeping = atomic_load(&pool->sleeping);
+        if (sleeping > 0) {
+            int result = count < sleeping
+                ? pthread_cond_signal(&(pool->thread_pool_cond))
+                : pthread_cond_broadcast(&(pool->thread_pool_cond));
+            if (result) {
+                fatal(__FILE__, __LINE__);
+            }
+        }
+    } else if (pthread_cond_broadcast(&(pool->thread_pool_cond))) {
         fatal(__FILE__, __LINE__);
     }
 
@@ -1,17 +1,68 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
+#include <stdbool.h>
 #include <stdlib.h>
 
 typedef struct thread_pool thread_pool_t;
 
-// Creates and returns threadpool.
+typedef enum thread_pool_mode {
+    THREAD_POOL_SHARED_QUEUE,  // All threads take tasks from one queue.
+    THREAD_POOL_WORK_STEALING, // Tasks added by a pool thread go to its own deque,
+                               // idle threads steal them.
+} thread_pool_mode_t;
+
+// Statistics of a thread of threadpool.
+typedef struct thread_pool_stats {
+    unsigned long long busy_ns; // Time running tasks, if measured.
+    unsigned long long idle_ns; // Time waiting for tasks, if measured.
+    unsigned long long tasks;   // Tasks run.
+    unsigned long long steals;  // Tasks stolen from other threads.
+    unsigned long long wakeups; // Times woken up after waiting for tasks.
+} thread_pool_stats_t;
+
+// Creates and returns threadpool with shared queue.
 thread_pool_t *thread_pool_init(size_t pool_size);
 
+// Creates and returns threadpool working in given mode.
+thread_pool_t *thread_pool_init_mode(size_t pool_size, thread_pool_mode_t mode);
+
+// Creates and returns threadpool working in given mode, starting with min_threads
+// threads. Another thread is started, up to max_threads, when tasks wait while
+// no thread is idle, as all are busy or blocked. Threads above min_threads
+// which are idle for idle_timeout_ms milliseconds stop, never if it is 0.
+thread_pool_t *thread_pool_init_elastic(size_t min_threads,
+                                        size_t max_threads,
+                                        unsigned long idle_timeout_ms,
+                                        thread_pool_mode_t mode);
+
 // Finishes all threadpool tasks then destroys threadpool.
 void thread_pool_shutdown(thread_pool_t *pool);
 
+// Runs one task waiting in threadpool, so a task waiting for other tasks
+// does not hold a thread of the pool idle. In work stealing mode tasks
+// of other workers are run only if called by a thread of the pool.
+// Returns false if there was no task to run.
+bool thread_pool_help(thread_pool_t *pool);
+
+// Turns measuring busy and idle time of threads on or off.
+void thread_pool_measure_time(thread_pool_t *pool, bool measure);
+
+// Returns maximal number of threads of threadpool.
+size_t thread_pool_size(thread_pool_t *pool);
+
+// Returns number of threads of threadpool running now.
+size_t thread_pool_threads(thread_pool_t *pool);
+
+// Saves statistics of thread with given index to stats.
+// Other threads may be updating them meanwhile.
+void thread_pool_stats(thread_pool_t *pool, size_t thread, thread_pool_stats_t *stats);
+
 // Adds a new task to threadpool.
 void thread_pool_add_task(thread_pool_t *pool, void (*function)(void *), void *arg, size_t arg_size);
 
+// Adds count tasks to threadpool, with arguments of arg_size bytes each
+// one after another in args, waking threads once for all of them.
+void thread_pool_add_tasks(thread_pool_t *pool, void (*function)(void *), void *args, size_t arg_size, size_t count);
+
 #endif
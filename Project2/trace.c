@@ -0,0 +1,231 @@
+#include "trace.h"
+#include "err.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Flow ids of a thread have its index in the high bits.
+#define TRACE_FLOW_ID_BITS 40
+
+typedef enum trace_event_kind {
+    TRACE_SEND,
+    TRACE_HANDLER
+} trace_event_kind_t;
+
+typedef struct trace_event {
+    trace_event_kind_t kind;
+    actor_id_t actor;        // Sender or actor running handler, -1 if none.
+    actor_id_t receiver;     // Only for sends.
+    message_type_t type;
+    unsigned long long flow_id;
+    unsigned long long start_ns;
+    unsigned long long duration_ns;
+} trace_event_t;
+
+// Ring buffer of events of one thread, written only by it.
+typedef struct trace_buffer {
+    struct trace_buffer *next;
+    unsigned long thread;
+    unsigned long long next_flow;
+    size_t written; // Events recorded, the newest capacity of them are kept.
+    trace_event_t events[];
+} trace_buffer_t;
+
+static _Thread_local trace_buffer_t *buffer_thread_local;
+// Buffers of threads are valid only if created in the current generation.
+static _Thread_local unsigned long buffer_generation_thread_local;
+static trace_buffer_t *buffers_g;
+static unsigned long buffer_number_g;
+static atomic_ulong buffer_generation_g = 1;
+static pthread_mutex_t buffers_mutex_g = PTHREAD_MUTEX_INITIALIZER;
+
+static char *trace_path_g;
+static size_t trace_capacity_g;
+static unsigned long long trace_start_ns_g;
+
+void trace_start(const char *path, size_t events_per_thread) {
+    free(trace_path_g);
+    trace_path_g = (char *) malloc(strlen(path) + 1);
+    if (trace_path_g == NULL) {
+        fatal(__FILE__, __LINE__);
+    }
+    strcpy(trace_path_g, path);
+    trace_capacity_g = events_per_thread > 0 ? events_per_thread : 1;
+    trace_start_ns_g = trace_now();
+}
+
+unsigned long long trace_now() {
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now)) {
+        fatal(__FILE__, __LINE__);
+    }
+    return (unsigned long long) now.tv_sec * 1000000000ULL + (unsigned long long) now.tv_nsec;
+}
+
+// Returns buffer of the calling thread, creating it if needed.
+static trace_buffer_t *thread_buffer() {
+    unsigned long generation = atomic_load(&buffer_generation_g);
+    if (buffer_thread_local != NULL && buffer_generation_thread_local == generation) {
+        return buffer_thread_local;
+    }
+
+    trace_buffer_t *buffer = (trace_buffer_t *) malloc(
+        sizeof(trace_buffer_t) + trace_capacity_g * sizeof(trace_event_t));
+    if (buffer == NULL) {
+        fatal(__FILE__, __LINE__);
+    }
+    buffer->next_flow = 0;
+    buffer->written = 0;
+
+    if (pthread_mutex_lock(&buffers_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    buffer->thread = buffer_number_g++;
+    buffer->next = buffers_g;
+    buffers_g = buffer;
+
+    if (pthread_mutex_unlock(&buffers_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    buffer_thread_local = buffer;
+    buffer_generation_thread_local = generation;
+    return buffer;
+}
+
+static trace_event_t *next_event(trace_event_kind_t kind) {
+    trace_buffer_t *buffer = thread_buffer();
+    trace_event_t *event = &buffer->events[buffer->written++ % trace_capacity_g];
+    event->kind = kind;
+    return event;
+}
+
+unsigned long long trace_flow_id() {
+    trace_buffer_t *buffer = thread_buffer();
+    return ((unsigned long long) buffer->thread << TRACE_FLOW_ID_BITS) | ++buffer->next_flow;
+}
+
+void trace_send(actor_id_t sender,
+                actor_id_t receiver,
+                message_type_t type,
+                unsigned long long flow_id,
+                unsigned long long sent_ns) {
+    trace_event_t *event = next_event(TRACE_SEND);
+    event->actor = sender;
+    event->receiver = receiver;
+    event->type = type;
+    event->flow_id = flow_id;
+    event->start_ns = sent_ns;
+    event->duration_ns = 0;
+}
+
+void trace_handler(actor_id_t actor,
+                   message_type_t type,
+                   unsigned long long flow_id,
+                   unsigned long long start_ns) {
+    unsigned long long end_ns = trace_now();
+    trace_event_t *event = next_event(TRACE_HANDLER);
+    event->actor = actor;
+    event->receiver = actor;
+    event->type = type;
+    event->flow_id = flow_id;
+    event->start_ns = start_ns;
+    event->duration_ns = end_ns - start_ns;
+}
+
+// Writes time in microseconds since the trace started, as trace events use.
+static void write_time(FILE *file, const char *name, unsigned long long time_ns) {
+    fprintf(file, "\"%s\":%llu.%03llu", name, time_ns / 1000, time_ns % 1000);
+}
+
+static const char *message_name(message_type_t type) {
+    if (type == MSG_SPAWN) {
+        return "spawn";
+    } else if (type == MSG_GODIE) {
+        return "godie";
+    } else if (type == MSG_HELLO) {
+        return "hello";
+    }
+    return "message";
+}
+
+// Writes a handler as a complete event and the end of its flow, a send as start of a flow.
+// Flow ends bind to the enclosing handler, so arrows go from sender to handler.
+static void write_event(FILE *file, unsigned long thread, const trace_event_t *event, bool *first) {
+    unsigned long long start_ns = event->start_ns > trace_start_ns_g
+        ? event->start_ns - trace_start_ns_g
+        : 0;
+
+    if (event->kind == TRACE_HANDLER) {
+        fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"handler\",\"ph\":\"X\",",
+                *first ? "" : ",", message_name(event->type));
+        write_time(file, "ts", start_ns);
+        fprintf(file, ",");
+        write_time(file, "dur", event->duration_ns);
+        fprintf(file, ",\"pid\":1,\"tid\":%lu,\"args\":{\"actor\":%ld,\"type\":%ld}}",
+                thread, event->actor, event->type);
+        *first = false;
+        if (event->flow_id == 0) {
+            return;
+        }
+    }
+
+    fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"message\",\"ph\":\"%s\",\"id\":%llu,",
+            *first ? "" : ",",
+            message_name(event->type),
+            event->kind == TRACE_SEND ? "s" : "f\",\"bp\":\"e",
+            event->flow_id);
+    write_time(file, "ts", start_ns);
+    fprintf(file, ",\"pid\":1,\"tid\":%lu,\"args\":{", thread);
+    if (event->kind == TRACE_SEND) {
+        fprintf(file, "\"from\":%ld,", event->actor);
+    }
+    fprintf(file, "\"to\":%ld,\"type\":%ld}}", event->receiver, event->type);
+    *first = false;
+}
+
+void trace_finish() {
+    FILE *file = fopen(trace_path_g, "w");
+    if (file == NULL) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    if (pthread_mutex_lock(&buffers_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    bool first = true;
+    while (buffers_g != NULL) {
+        trace_buffer_t *buffer = buffers_g;
+        buffers_g = buffer->next;
+
+        fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,"
+                      "\"args\":{\"name\":\"thread %lu\"}}",
+                first ? "" : ",", buffer->thread, buffer->thread);
+        first = false;
+
+        size_t kept = buffer->written < trace_capacity_g ? buffer->written : trace_capacity_g;
+        for (size_t i = buffer->written - kept; i < buffer->written; ++i) {
+            write_event(file, buffer->thread, &buffer->events[i % trace_capacity_g], &first);
+        }
+        free(buffer);
+    }
+    fprintf(file, "\n]}\n");
+    buffer_number_g = 0;
+    atomic_fetch_add(&buffer_generation_g, 1);
+
+    if (pthread_mutex_unlock(&buffers_mutex_g)) {
+        fatal(__FILE__, __LINE__);
+    }
+
+    if (fclose(file)) {
+        fatal(__FILE__, __LINE__);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "cacti.h"
+
+#include <stddef.h>
+
+// Timeline of handlers and messages, written as Chrome trace event JSON
+// (chrome://tracing, Perfetto). Every thread records events to its own
+// ring buffer, keeping the newest events when it is full, so recording
+// takes no lock. Buffers are read only after threads stop recording.
+
+// Starts tracing to file at path with buffers of given number of events.
+void trace_start(const char *path, size_t events_per_thread);
+
+// Returns current time of trace clock in nanoseconds.
+unsigned long long trace_now();
+
+// Returns new id of a message flow from sender to receiver.
+unsigned long long trace_flow_id();
+
+// Records sending message to receiver by sender, or by no actor if it is -1,
+// at time sent_ns.
+void trace_send(actor_id_t sender,
+                actor_id_t receiver,
+                message_type_t type,
+                unsigned long long flow_id,
+                unsigned long long sent_ns);
+
+// Records handler of actor started at start_ns and ending now,
+// processing message sent in given flow.
+void trace_handler(actor_id_t actor,
+                   message_type_t type,
+                   unsigned long long flow_id,
+                   unsigned long long start_ns);
+
+// Writes events of all threads to the file and frees their buffers.
+// No thread may be recording events.
+void trace_finish();
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef SRC_BINARYPAGEID_HPP_
+#define SRC_BINARYPAGEID_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "immutable/pageId.hpp"
+
+#include "sha256.hpp"
+
+// 32 byte page id, the binary form of a SHA-256 hex page id.
+// Trivially copyable, so it can be stored in flat arrays and files.
+// Conversion to and from hex PageId is meant only for input and output.
+struct alignas(16) BinaryPageId {
+    uint64_t words[4];
+
+    static BinaryPageId fromDigest(const Sha256::Digest& digest)
+    {
+        BinaryPageId id;
+        std::memcpy(id.words, digest.data(), sizeof(id.words));
+        return id;
+    }
+
+    // Returns false if hex is not 64 lowercase hex digits.
+    // Uppercase digits are rejected, so every binary id has a single hex form.
+    static bool fromHex(const std::string& hex, BinaryPageId& id)
+    {
+        if (hex.size() != 2 * sizeof(id.words)) {
+            return false;
+        }
+
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(id.words);
+        for (size_t byte = 0; byte < sizeof(id.words); ++byte) {
+            int high = hexValue(hex[2 * byte]);
+            int low = hexValue(hex[2 * byte + 1]);
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            bytes[byte] = static_cast<uint8_t>(high << 4 | low);
+        }
+        return true;
+    }
+
+    // Ids that are not SHA-256 hex digests are mapped to SHA-256 digest of the id,
+    // so different ids get different binary ids.
+    static BinaryPageId fromPageId(const PageId& pageId)
+    {
+        BinaryPageId id;
+        if (!fromHex(pageId.id, id)) {
+            id = fromDigest(Sha256::digest(pageId.id.data(), pageId.id.size()));
+        }
+        return id;
+    }
+
+    std::string toHex() const
+    {
+        static const char digits[] = "0123456789abcdef";
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(words);
+
+        std::string hex(2 * sizeof(words), '0');
+        for (size_t byte = 0; byte < sizeof(words); ++byte) {
+            hex[2 * byte] = digits[bytes[byte] >> 4];
+            hex[2 * byte + 1] = digits[bytes[byte] & 0xf];
+        }
+        return hex;
+    }
+
+    PageId toPageId() const
+    {
+        return PageId(toHex());
+    }
+
+    bool operator==(const BinaryPageId& other) const
+    {
+#ifdef __SSE2__
+        const __m128i* lhs = reinterpret_cast<const __m128i*>(words);
+        const __m128i* rhs = reinterpret_cast<const __m128i*>(other.words);
+        __m128i equal = _mm_and_si128(_mm_cmpeq_epi8(_mm_load_si128(lhs), _mm_load_si128(rhs)),
+            _mm_cmpeq_epi8(_mm_load_si128(lhs + 1), _mm_load_si128(rhs + 1)));
+        return _mm_movemask_epi8(equal) == 0xffff;
+#else
+        return std::memcmp(words, other.words, sizeof(words)) == 0;
+#endif
+    }
+
+    bool operator!=(const BinaryPageId& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    static int hexValue(char digit)
+    {
+        if (digit >= '0' && digit <= '9') {
+            return digit - '0';
+        } else if (digit >= 'a' && digit <= 'f') {
+            return digit - 'a' + 10;
+        }
+        return -1;
+    }
+};
+
+static_assert(sizeof(BinaryPageId) == 32, "BinaryPageId has to be 32 bytes");
+static_assert(std::is_trivially_copyable<BinaryPageId>::value,
+    "BinaryPageId has to be trivially copyable");
+
+// Bits of SHA-256 are already uniformly distributed, so they only need to be folded.
+struct BinaryPageIdHash {
+    std::size_t operator()(const BinaryPageId& id) const
+    {
+        return id.words[0] ^ id.words[1] ^ id.words[2] ^ id.words[3];
+    }
+};
+
+struct BinaryPageIdAndRank {
+    BinaryPageId id;
+    PageRank rank;
+};
+
+#endif /* SRC_BINARYPAGEID_HPP_ */
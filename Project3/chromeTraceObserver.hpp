@@ -0,0 +1,123 @@
+#ifndef SRC_CHROMETRACEOBSERVER_HPP_
+#define SRC_CHROMETRACEOBSERVER_HPP_
+
+#include <chrono>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "immutable/common.hpp"
+
+#include "pageRankObserver.hpp"
+
+// Records computations as Chrome trace events, viewable in chrome://tracing or Perfetto.
+// Phases are shown on thread 0, busy time of computing threads on threads 1, 2, ...
+// and difference, dangling ranks sum and allocated bytes as counters.
+class ChromeTraceObserver : public PageRankObserver {
+public:
+    ChromeTraceObserver()
+        : created(std::chrono::steady_clock::now())
+    {
+    }
+
+    // Trace is written to path after every computation.
+    ChromeTraceObserver(const std::string& pathArg)
+        : created(std::chrono::steady_clock::now())
+        , path(pathArg)
+    {
+    }
+
+    void onStart(const std::string& computerName, size_t networkSize) override
+    {
+        computation++;
+        std::stringstream args;
+        args << "{\"computer\":\"" << computerName << "\",\"networkSize\":" << networkSize << "}";
+        addEvent("computation " + std::to_string(computation), "i",
+            std::chrono::steady_clock::now(), std::chrono::nanoseconds(0), 0, args.str());
+    }
+
+    void onIteration(const PageRankIterationStatistics& statistics) override
+    {
+        std::string args = "{\"iteration\":" + std::to_string(statistics.iteration) + "}";
+
+        auto phaseStart = statistics.start;
+        addEvent("dangling", "X", phaseStart, statistics.danglingTime, 0, args);
+        phaseStart += statistics.danglingTime;
+        addEvent("update", "X", phaseStart, statistics.updateTime, 0, args);
+        phaseStart += statistics.updateTime;
+        addEvent("difference", "X", phaseStart, statistics.differenceTime, 0, args);
+
+        for (size_t thread = 0; thread < statistics.threadBusyTimes.size(); ++thread) {
+            addEvent("busy", "X", statistics.start, statistics.threadBusyTimes[thread],
+                thread + 1, args);
+        }
+
+        std::stringstream counters;
+        counters.precision(17);
+        counters << "{\"difference\":" << statistics.difference
+                 << ",\"danglingNodesRankSum\":" << statistics.danglingNodesRankSum
+                 << ",\"bytesAllocated\":" << statistics.bytesAllocated << "}";
+        addEvent("statistics", "C", statistics.start, std::chrono::nanoseconds(0), 0,
+            counters.str());
+    }
+
+    void onFinish(uint32_t iterations, bool converged) override
+    {
+        std::string args = "{\"iterations\":" + std::to_string(iterations)
+            + ",\"converged\":" + (converged ? "true" : "false") + "}";
+        addEvent("finish", "i", std::chrono::steady_clock::now(), std::chrono::nanoseconds(0),
+            0, args);
+
+        if (!path.empty()) {
+            std::ofstream file(path);
+            writeTrace(file);
+            ASSERT(file, "Not able to write trace to " << path);
+        }
+    }
+
+    void writeTrace(std::ostream& stream) const
+    {
+        stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        for (size_t event = 0; event < events.size(); ++event) {
+            stream << events[event] << (event + 1 < events.size() ? ",\n" : "\n");
+        }
+        stream << "]}\n";
+    }
+
+private:
+    void addEvent(const std::string& name,
+        const char* phase,
+        std::chrono::steady_clock::time_point start,
+        std::chrono::nanoseconds duration,
+        size_t thread,
+        const std::string& args)
+    {
+        std::stringstream event;
+        event.setf(std::ios::fixed);
+        event.precision(3);
+        event << "{\"name\":\"" << name << "\",\"cat\":\"pagerank\",\"ph\":\"" << phase
+              << "\",\"ts\":" << microseconds(start - created);
+        if (phase[0] == 'X') {
+            event << ",\"dur\":" << microseconds(duration);
+        } else if (phase[0] == 'i') {
+            event << ",\"s\":\"p\"";
+        }
+        event << ",\"pid\":" << computation << ",\"tid\":" << thread
+              << ",\"args\":" << args << "}";
+        events.push_back(event.str());
+    }
+
+    static double microseconds(std::chrono::nanoseconds duration)
+    {
+        return duration.count() / 1000.0;
+    }
+
+    std::chrono::steady_clock::time_point created;
+    std::string path;
+    uint32_t computation = 0;
+    std::vector<std::string> events;
+};
+
+#endif /* SRC_CHROMETRACEOBSERVER_HPP_ */
@@ -0,0 +1,125 @@
+#ifndef SRC_HEAPALLOCATIONCOUNTER_HPP_
+#define SRC_HEAPALLOCATIONCOUNTER_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Counts heap allocations made through operator new by all threads of the program,
+// so benchmarks can check that iterations of computers allocate nothing.
+// Global operator new and delete are replaced, so this header has to be included
+// in exactly one translation unit of a program.
+class HeapAllocationCounter {
+public:
+    static uint64_t getAllocations()
+    {
+        return allocations.load(std::memory_order_relaxed);
+    }
+
+    static void* allocate(std::size_t size)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        void* memory = std::malloc(size != 0 ? size : 1);
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+
+    static void* allocateAligned(std::size_t size, std::align_val_t alignment)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        std::size_t bytes = static_cast<std::size_t>(alignment);
+        // Size of aligned_alloc has to be a multiple of the alignment.
+        size = (size + bytes - 1) / bytes * bytes;
+        void* memory = std::aligned_alloc(bytes, size != 0 ? size : bytes);
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+
+private:
+    static inline std::atomic<uint64_t> allocations { 0 };
+};
+
+void* operator new(std::size_t size)
+{
+    return HeapAllocationCounter::allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return HeapAllocationCounter::allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return HeapAllocationCounter::allocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return HeapAllocationCounter::allocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return HeapAllocationCounter::allocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return HeapAllocationCounter::allocateAligned(size, alignment);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+#endif /* SRC_HEAPALLOCATIONCOUNTER_HPP_ */
@@ -0,0 +1,192 @@
+#ifndef SRC_HUGEPAGEARENA_HPP_
+#define SRC_HUGEPAGEARENA_HPP_
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "immutable/common.hpp"
+
+struct ArenaStatistics {
+    uint64_t allocationCount = 0;
+    // Bytes handed out by the arena and not returned yet.
+    size_t allocatedBytes = 0;
+    size_t peakBytes = 0;
+    // Memory mapped from the OS, including unused parts of chunks.
+    size_t mappedBytes = 0;
+    // Chunks backed by explicit (MAP_HUGETLB) or transparent huge pages.
+    size_t explicitHugePageChunks = 0;
+    size_t transparentHugePageChunks = 0;
+};
+
+// Bump allocator backed by huge pages.
+// Chunks are mapped with MAP_HUGETLB if the system has reserved huge pages,
+// otherwise they are aligned to huge page size and advised with MADV_HUGEPAGE.
+// Memory is given back to the OS only when the arena is destroyed.
+// Not thread safe.
+class HugePageArena {
+public:
+    static constexpr size_t hugePageSize = 2 * 1024 * 1024;
+
+    HugePageArena(size_t chunkSizeArg = 32 * hugePageSize)
+        : chunkSize(roundUp(chunkSizeArg, hugePageSize))
+    {
+    }
+
+    HugePageArena(const HugePageArena&) = delete;
+    HugePageArena& operator=(const HugePageArena&) = delete;
+
+    ~HugePageArena()
+    {
+        for (const auto& chunk : chunks) {
+            munmap(chunk.begin, chunk.size);
+        }
+    }
+
+    void* allocate(size_t bytes, size_t alignment)
+    {
+        if (chunks.empty() || !fits(chunks.back(), bytes, alignment)) {
+            mapChunk(bytes + alignment);
+        }
+
+        Chunk& chunk = chunks.back();
+        chunk.used = roundUp(chunk.used, alignment);
+        void* result = chunk.begin + chunk.used;
+        chunk.used += bytes;
+
+        statistics.allocationCount++;
+        statistics.allocatedBytes += bytes;
+        statistics.peakBytes = std::max(statistics.peakBytes, statistics.allocatedBytes);
+        return result;
+    }
+
+    // Memory is reused only if it was the last allocation.
+    void deallocate(void* pointer, size_t bytes)
+    {
+        statistics.allocatedBytes -= bytes;
+
+        Chunk& chunk = chunks.back();
+        if (static_cast<char*>(pointer) + bytes == chunk.begin + chunk.used) {
+            chunk.used -= bytes;
+        }
+    }
+
+    const ArenaStatistics& getStatistics() const
+    {
+        return statistics;
+    }
+
+private:
+    struct Chunk {
+        char* begin;
+        size_t size;
+        size_t used;
+    };
+
+    static size_t roundUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    static bool fits(const Chunk& chunk, size_t bytes, size_t alignment)
+    {
+        return roundUp(chunk.used, alignment) + bytes <= chunk.size;
+    }
+
+    void mapChunk(size_t minimalSize)
+    {
+        size_t size = std::max(chunkSize, roundUp(minimalSize, hugePageSize));
+
+        void* begin = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (begin != MAP_FAILED) {
+            statistics.explicitHugePageChunks++;
+        } else {
+            begin = mapAligned(size);
+            if (madvise(begin, size, MADV_HUGEPAGE) == 0) {
+                statistics.transparentHugePageChunks++;
+            }
+        }
+
+        chunks.push_back(Chunk { static_cast<char*>(begin), size, 0 });
+        statistics.mappedBytes += size;
+    }
+
+    // Transparent huge pages are used only for huge page aligned memory.
+    static void* mapAligned(size_t size)
+    {
+        size_t mappedSize = size + hugePageSize;
+        void* mapped = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        ASSERT(mapped != MAP_FAILED, "mmap error");
+
+        uintptr_t mappedBegin = reinterpret_cast<uintptr_t>(mapped);
+        uintptr_t begin = roundUp(mappedBegin, hugePageSize);
+        if (begin > mappedBegin) {
+            munmap(mapped, begin - mappedBegin);
+        }
+        if (mappedBegin + mappedSize > begin + size) {
+            munmap(reinterpret_cast<void*>(begin + size),
+                mappedBegin + mappedSize - begin - size);
+        }
+        return reinterpret_cast<void*>(begin);
+    }
+
+    size_t chunkSize;
+    std::vector<Chunk> chunks;
+    ArenaStatistics statistics;
+};
+
+// Standard allocator allocating from HugePageArena.
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator(HugePageArena& arenaArg)
+        : arena(&arenaArg)
+    {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other)
+        : arena(other.arena)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* pointer, size_t n)
+    {
+        arena->deallocate(pointer, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const
+    {
+        return arena == other.arena;
+    }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const
+    {
+        return arena != other.arena;
+    }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    HugePageArena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif /* SRC_HUGEPAGEARENA_HPP_ */
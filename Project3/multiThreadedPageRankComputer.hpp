@@ -1,163 +1,530 @@
 #ifndef SRC_MULTITHREADEDPAGERANKCOMPUTER_HPP_
 #define SRC_MULTITHREADEDPAGERANKCOMPUTER_HPP_
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <thread>
+#include <utility>
 
-#include <unordered_map>
 #include <vector>
 
 #include "immutable/network.hpp"
 #include "immutable/pageIdAndRank.hpp"
 #include "immutable/pageRankComputer.hpp"
 
+#include "binaryPageId.hpp"
+#include "hugePageArena.hpp"
+#include "pageBlockSums.hpp"
+#include "pageRankCheckpoint.hpp"
+#include "numaTopology.hpp"
+#include "pageRankControl.hpp"
+#include "pageRankGraph.hpp"
+#include "pageRankObserver.hpp"
+#include "pageRankResults.hpp"
+#include "threadsInfo.hpp"
+
+// Statistics of the last batch of networks.
+struct PageRankBatchStatistics {
+    size_t networks = 0;
+    // Networks computed by all threads together.
+    size_t parallelNetworks = 0;
+    double seconds = 0;
+    double networksPerSecond = 0;
+};
+
 class MultiThreadedPageRankComputer : public PageRankComputer {
 public:
-    MultiThreadedPageRankComputer(uint32_t numThreadsArg)
-        : numThreads(numThreadsArg) {};
+    static constexpr size_t defaultParallelNetworkSize = 1 << 14;
+
+    // In NUMA aware mode threads are pinned to NUMA nodes
+    // and ranks and edges of pages are placed on the node of the thread updating them.
+    MultiThreadedPageRankComputer(uint32_t numThreadsArg, bool numaAwareArg = false)
+        : numThreads(numThreadsArg)
+        , numaAware(numaAwareArg) {};
+
+    // Observer receives statistics of every iteration. Null disables statistics.
+    void setObserver(PageRankObserver* observerArg)
+    {
+        observer = observerArg;
+    }
 
     std::vector<PageIdAndRank> computeForNetwork(Network const& network,
         double alpha,
         uint32_t iterations,
         double tolerance) const
     {
-        generateIdentifiers(network);
+        return computeRanks(network, alpha, iterations, tolerance, PageRankResults::collectAll);
+    }
 
-        std::unordered_map<PageId, PageRank, PageIdHash> pageHashMap;
-        for (const auto& page : network.getPages()) {
-            pageHashMap[page.getId()] = 1.0 / network.getSize();
-        }
+    // In reproducible mode sums of ranks of dangling nodes and of differences are added
+    // in blocks of pages, see PageBlockSums, and threads own whole blocks.
+    // Ranks are then bit identical for any number of threads, in NUMA aware mode too,
+    // and equal to those of SingleThreadedPageRankComputer in reproducible mode.
+    void setReproducible(bool reproducibleArg)
+    {
+        reproducible = reproducibleArg;
+    }
 
-        std::unordered_map<PageId, uint32_t, PageIdHash> numLinks;
-        for (const auto& page : network.getPages()) {
-            numLinks[page.getId()] = page.getLinks().size();
-        }
+    // Checkpoints of ranks are written to options.path every options.interval iterations.
+    void setCheckpointing(const PageRankCheckpointOptions& options)
+    {
+        checkpointOptions = options;
+    }
 
-        std::vector<PageId> danglingNodes;
-        for (const auto& page : network.getPages()) {
-            if (page.getLinks().size() == 0) {
-                danglingNodes.push_back(page.getId());
-            }
-        }
-        const double danglingWeight = 1.0 / network.getSize();
+    // Resumes computation from the checkpoint, if it was written for the same network, alpha
+    // and reproducible mode, otherwise computes from the beginning. Iterations include those
+    // done before the checkpoint, a checkpoint written after more of them is not used.
+    // Ranks of a checkpoint written when the computation converged are returned as they are.
+    std::vector<PageIdAndRank> resumeForNetwork(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance) const
+    {
+        return computeRanks(network, alpha, iterations, tolerance, PageRankResults::collectAll,
+            nullptr, true);
+    }
+
+    // Computes ranks in a new thread. It can be cancelled or stopped by a deadline,
+    // then ranks of the last iteration are returned.
+    PageRankHandle computeForNetworkAsync(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance,
+        const PageRankAsyncOptions& options = PageRankAsyncOptions()) const
+    {
+        return PageRankHandle(
+            [this, &network, alpha, iterations, tolerance](PageRankControl& control) {
+                return computeRanks(network, alpha, iterations, tolerance,
+                    PageRankResults::collectAll, &control);
+            },
+            options);
+    }
+
+    // Computes ranks of every network, results are in order of networks
+    // and identical to results of computeForNetwork.
+    // Networks smaller than parallelNetworkSize are computed whole by one of the threads.
+    // Bigger ones are computed by all threads, one after another.
+    // In NUMA aware mode all networks are computed by all threads.
+    // Observer and checkpoints are not supported, they have to be disabled.
+    std::vector<std::vector<PageIdAndRank>> computeForNetworks(std::vector<Network> const& networks,
+        double alpha,
+        uint32_t iterations,
+        double tolerance,
+        size_t parallelNetworkSize = defaultParallelNetworkSize) const
+    {
+        // Networks computed at once would notify the observer from many threads
+        // and all of them would write checkpoints to the same file.
+        ASSERT(observer == nullptr && checkpointOptions.path.empty(),
+            "Batch computation supports neither observer nor checkpoints");
 
-        std::unordered_map<PageId, std::vector<PageId>, PageIdHash> edges;
-        for (const auto& page : network.getPages()) {
-            for (const auto& link : page.getLinks()) {
-                edges[link].push_back(page.getId());
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::vector<PageIdAndRank>> results(networks.size());
+        batchStatistics = PageRankBatchStatistics();
+
+        std::vector<size_t> smallNetworks;
+        for (size_t network = 0; network < networks.size(); ++network) {
+            if (numaAware || networks[network].getSize() >= parallelNetworkSize) {
+                results[network] = computeForNetwork(networks[network], alpha, iterations, tolerance);
+                batchStatistics.parallelNetworks++;
+            } else {
+                smallNetworks.push_back(network);
             }
         }
 
-        for (uint32_t i = 0; i < iterations; ++i) {
-            std::unordered_map<PageId, PageRank, PageIdHash>
-                previousPageHashMap = pageHashMap;
+        // Biggest networks are taken first, so threads finish at similar time.
+        std::stable_sort(smallNetworks.begin(), smallNetworks.end(),
+            [&networks](size_t network, size_t otherNetwork) {
+                return networks[network].getSize() > networks[otherNetwork].getSize();
+            });
 
-            double danglingNodesRankSum = getDanglingNodesRankSum(
-                danglingNodes,
-                previousPageHashMap);
+        std::atomic<size_t> nextNetwork(0);
+        auto computeSmallNetworks = [&]() {
+            // Every thread has its own computer, as computations write its statistics.
+            // It has neither observer nor checkpoints, like this one.
+            // Partitions are computed one after another by the thread,
+            // so sums are added in the same order as in computeForNetwork.
+            MultiThreadedPageRankComputer computer(numThreads);
+            computer.partitionsInline = true;
+            computer.reproducible = reproducible;
+            for (size_t index = nextNetwork++; index < smallNetworks.size(); index = nextNetwork++) {
+                size_t network = smallNetworks[index];
+                results[network] = computer.computeForNetwork(networks[network],
+                    alpha, iterations, tolerance);
+            }
+        };
 
-            danglingNodesRankSum *= alpha;
-            PageRank
-                pageRankWithoutLinks
-                = danglingNodesRankSum * danglingWeight
-                + (1.0 - alpha) / network.getSize();
+        uint32_t numberOfThreadsUsed = std::max<size_t>(1,
+            std::min<size_t>(numThreads, smallNetworks.size()));
+        std::vector<std::thread> batchThreads;
+        for (uint32_t threadNumber = 1; threadNumber < numberOfThreadsUsed; ++threadNumber) {
+            batchThreads.push_back(std::thread { computeSmallNetworks });
+        }
+        computeSmallNetworks();
+        for (auto& thread : batchThreads) {
+            thread.join();
+        }
 
-            updatePageRank(network,
-                pageHashMap,
-                previousPageHashMap,
-                edges,
-                numLinks,
-                alpha,
-                pageRankWithoutLinks);
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        batchStatistics.networks = networks.size();
+        batchStatistics.seconds = seconds.count();
+        batchStatistics.networksPerSecond = seconds.count() > 0 ? networks.size() / seconds.count() : 0;
+        return results;
+    }
 
-            double difference = getDifference(network,
-                pageHashMap,
-                previousPageHashMap);
+    // Ranks with 32 byte binary ids, see BinaryPageId.
+    std::vector<BinaryPageIdAndRank> computeBinaryForNetwork(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance) const
+    {
+        return computeRanks(network, alpha, iterations, tolerance,
+            PageRankResults::collectAllBinary);
+    }
 
-            if (difference < tolerance) {
-                std::vector<PageIdAndRank> result;
-                for (auto iter : pageHashMap) {
-                    result.push_back(PageIdAndRank(iter.first, iter.second));
-                }
+    // Returns k pages with the highest ranks, starting from the highest.
+    std::vector<PageIdAndRank> computeTopKForNetwork(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance,
+        size_t k) const
+    {
+        return computeRanks(network, alpha, iterations, tolerance,
+            [this, k](Network const& network, const PageRankGraph*, const PageRank* ranks) {
+                return PageRankResults::selectTopK(network, ranks, k, numThreads);
+            });
+    }
 
-                ASSERT(result.size() == network.getSize(),
-                    "Invalid result size=" << result.size()
-                                           << ", for network" << network);
-                return result;
-            }
-        }
-        ASSERT(false, "Not able to find result in iterations=" << iterations);
+    // Writes "<page id> <rank>" lines to output, starting from the highest rank.
+    void writeSortedForNetwork(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance,
+        std::ostream& output) const
+    {
+        computeRanks(network, alpha, iterations, tolerance,
+            [this, &output](Network const& network, const PageRankGraph*, const PageRank* ranks) {
+                PageRankResults::writeSorted(network, ranks, output, numThreads);
+            });
     }
 
     std::string getName() const
     {
         return "MultiThreadedPageRankComputer["
-            + std::to_string(this->numThreads) + "]";
+            + std::to_string(this->numThreads)
+            + (this->numaAware ? ",numa" : "") + "]";
+    }
+
+    // Memory used by graph and ranks in the last computation.
+    // Statistics cannot be read while a computation runs.
+    const ArenaStatistics& getArenaStatistics() const
+    {
+        assertNotComputing();
+        return arenaStatistics;
+    }
+
+    const PageRankCheckpointStatistics& getCheckpointStatistics() const
+    {
+        assertNotComputing();
+        return checkpointStatistics;
+    }
+
+    // Memory locality of the last computation in NUMA aware mode.
+    const NumaStatistics& getNumaStatistics() const
+    {
+        assertNotComputing();
+        return numaStatistics;
+    }
+
+    const PageRankBatchStatistics& getBatchStatistics() const
+    {
+        assertNotComputing();
+        return batchStatistics;
     }
 
 private:
-    class ThreadsInfo {
+    // Threads started once for the whole computation, which run its phases.
+    // The calling thread is thread 0. Phases are passed by pointer, so running them allocates nothing.
+    class WorkerPool {
     public:
-        ThreadsInfo(size_t numberOfNodes, uint32_t numThreads)
+        WorkerPool(uint32_t numberOfThreadsArg)
+            : numberOfThreads(numberOfThreadsArg)
         {
-            // Don't need more threads than number of nodes.
-            numberOfThreadsUsed = std::min(static_cast<uint32_t>(numberOfNodes), numThreads);
+            for (uint32_t threadNumber = 1; threadNumber < numberOfThreads; ++threadNumber) {
+                threads.push_back(std::thread { [this, threadNumber] { work(threadNumber); } });
+            }
+        }
 
-            // Divide nodes among threads equally.
-            // Threads in first group calculate for one more node than those in second group.
-            nodesPerThreadInFirstGroup = numberOfNodes / numThreads + 1;
-            nodesPerThreadInSecondGroup = numberOfNodes / numThreads;
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
 
-            numberOfThreadsInFirstGroup = numberOfNodes % numThreads;
+        ~WorkerPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+                generation++;
+            }
+            started.notify_all();
+            for (auto& thread : threads) {
+                thread.join();
+            }
         }
 
-        size_t getThreadFirstIndex(uint32_t threadNumber) const
+        // Runs function(threadNumber) for threads from 0 to numberOfThreadsUsed - 1
+        // and waits until all of them return.
+        template <typename Function>
+        void run(uint32_t numberOfThreadsUsed, Function& function)
         {
-            if (threadNumber < numberOfThreadsInFirstGroup) {
-                return threadNumber * nodesPerThreadInFirstGroup;
-            } else {
-                return numberOfThreadsInFirstGroup * nodesPerThreadInFirstGroup
-                    + (threadNumber - numberOfThreadsInFirstGroup)
-                    * nodesPerThreadInSecondGroup;
+            if (threads.empty() || numberOfThreadsUsed <= 1) {
+                for (uint32_t threadNumber = 0; threadNumber < numberOfThreadsUsed; ++threadNumber) {
+                    function(threadNumber);
+                }
+                return;
+            }
+            ASSERT(numberOfThreadsUsed <= numberOfThreads, "Not enough threads in pool");
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                phase = &runPhase<Function>;
+                phaseFunction = &function;
+                phaseThreads = numberOfThreadsUsed;
+                running = numberOfThreads - 1;
+                generation++;
             }
+            started.notify_all();
+
+            function(0);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [this] { return running == 0; });
         }
 
-        size_t getThreadLastIndex(uint32_t threadNumber) const
+    private:
+        template <typename Function>
+        static void runPhase(void* function, uint32_t threadNumber)
         {
-            if (threadNumber < numberOfThreadsInFirstGroup) {
-                return (threadNumber + 1) * nodesPerThreadInFirstGroup - 1;
-            } else {
-                return numberOfThreadsInFirstGroup * nodesPerThreadInFirstGroup
-                    + (threadNumber - numberOfThreadsInFirstGroup + 1)
-                    * nodesPerThreadInSecondGroup
-                    - 1;
-            }
+            (*static_cast<Function*>(function))(threadNumber);
         }
 
-        uint32_t getNumberOfThreadsUsed() const
+        void work(uint32_t threadNumber)
         {
-            return numberOfThreadsUsed;
+            uint64_t seenGeneration = 0;
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                started.wait(lock, [&] { return generation != seenGeneration; });
+                seenGeneration = generation;
+                if (stopping) {
+                    return;
+                }
+
+                if (threadNumber < phaseThreads) {
+                    auto phaseToRun = phase;
+                    void* function = phaseFunction;
+                    lock.unlock();
+                    phaseToRun(function, threadNumber);
+                    lock.lock();
+                }
+                if (--running == 0) {
+                    finished.notify_one();
+                }
+            }
         }
 
-    private:
-        uint32_t numberOfThreadsUsed;
-        size_t nodesPerThreadInFirstGroup;
-        size_t nodesPerThreadInSecondGroup;
-        size_t numberOfThreadsInFirstGroup;
+        uint32_t numberOfThreads;
+        std::vector<std::thread> threads;
+
+        std::mutex mutex;
+        std::condition_variable started;
+        std::condition_variable finished;
+
+        // Guarded by mutex.
+        void (*phase)(void*, uint32_t) = nullptr;
+        void* phaseFunction = nullptr;
+        uint32_t phaseThreads = 0;
+        uint32_t running = 0;
+        uint64_t generation = 0;
+        bool stopping = false;
     };
 
+    // Result is built by buildResult from network, its graph and ranks of its pages,
+    // before memory of the computation is released.
+    // Without control computation fails if it does not converge,
+    // with control it returns an empty result if it stops before the first iteration.
+    // When resuming, ranks and iteration are restored from the checkpoint.
+    template <typename ResultBuilder>
+    auto computeRanks(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance,
+        ResultBuilder buildResult,
+        PageRankControl* control = nullptr,
+        bool resume = false) const
+        -> decltype(buildResult(network, static_cast<const PageRankGraph*>(nullptr),
+            static_cast<const PageRank*>(nullptr)))
+    {
+        using Result = decltype(buildResult(network, static_cast<const PageRankGraph*>(nullptr),
+            static_cast<const PageRank*>(nullptr)));
+        PageRankComputationGuard guard(computing);
+
+        generateIdentifiers(network, control);
+        if (control != nullptr && control->endSetupPhase()) {
+            return Result();
+        }
+
+        if (numaAware) {
+            return computeRanksNuma(network, alpha, iterations, tolerance, buildResult, control,
+                resume);
+        }
+
+        // Whole graph and ranks are released at once when arena goes out of scope.
+        HugePageArena arena;
+        PageRankGraph graph(network, arena);
+        if (control != nullptr && control->endSetupPhase()) {
+            return Result();
+        }
+
+        ArenaVector<PageRank> pageRanks(network.getSize(), 1.0 / network.getSize(), arena);
+        ArenaVector<PageRank> previousPageRanks(network.getSize(), 0, arena);
+        // Buffers are swapped at the start of every iteration,
+        // ranks of the last iteration are in ranks.
+        PageRank* ranks = pageRanks.data();
+        PageRank* previousRanks = previousPageRanks.data();
+        const double danglingWeight = 1.0 / network.getSize();
+
+        PageRankCheckpointer checkpointer(checkpointOptions, network, graph, alpha, reproducible);
+        double restoredDifference = 0;
+        uint32_t firstIteration = resume ? checkpointer.restore(ranks, iterations, restoredDifference) : 0;
+
+        // Computation converged at the checkpoint, another iteration would change ranks.
+        if (firstIteration > 0 && restoredDifference < tolerance) {
+            PageRankIterationRecorder recorder(observer, getName(), network.getSize(), numThreads);
+            if (control != nullptr) {
+                control->endIteration(firstIteration, restoredDifference, true);
+            }
+            arenaStatistics = arena.getStatistics();
+            checkpointer.finish();
+            checkpointStatistics = checkpointer.getStatistics();
+            recorder.finish(firstIteration, true);
+            return buildResult(network, &graph, ranks);
+        }
+
+        PageBlockSums danglingNodesRankSums(reproducible ? graph.getSize() : 0);
+        PageBlockSums differenceSums(reproducible ? graph.getSize() : 0);
+
+        // Threads and sums of partitions live as long as the computation,
+        // so iterations do not allocate.
+        WorkerPool pool(partitionsInline ? 1 : ThreadsInfo(graph.getSize(), numThreads).getNumberOfThreadsUsed());
+        std::vector<double> threadSums(numThreads);
+
+        PageRankIterationRecorder recorder(observer, getName(), network.getSize(), numThreads);
+
+        for (uint32_t i = firstIteration; i < iterations; ++i) {
+            recorder.startIteration(i);
+
+            std::swap(ranks, previousRanks);
+
+            double danglingNodesRankSum = reproducible
+                ? getDanglingNodesRankBlockSum(graph,
+                    previousRanks,
+                    danglingNodesRankSums,
+                    pool,
+                    recorder)
+                : getDanglingNodesRankSum(
+                    graph.getDanglingNodes(),
+                    previousRanks,
+                    threadSums,
+                    pool,
+                    recorder);
+            const double danglingNodesRankSumBeforeAlpha = danglingNodesRankSum;
+            recorder.endPhase(PageRankIterationRecorder::Phase::dangling);
+
+            danglingNodesRankSum *= alpha;
+            PageRank
+                pageRankWithoutLinks
+                = danglingNodesRankSum * danglingWeight
+                + (1.0 - alpha) / network.getSize();
+
+            updatePageRank(graph,
+                ranks,
+                previousRanks,
+                alpha,
+                pageRankWithoutLinks,
+                pool,
+                recorder);
+            recorder.endPhase(PageRankIterationRecorder::Phase::update);
+
+            double difference = reproducible
+                ? getDifferenceBlockSum(graph,
+                    ranks,
+                    previousRanks,
+                    differenceSums,
+                    pool,
+                    recorder)
+                : getDifference(graph,
+                    ranks,
+                    previousRanks,
+                    threadSums,
+                    pool,
+                    recorder);
+            recorder.endPhase(PageRankIterationRecorder::Phase::difference);
+
+            recorder.endIteration(difference, danglingNodesRankSumBeforeAlpha,
+                arena.getStatistics().allocatedBytes);
+            checkpointer.endIteration(i + 1, ranks, difference);
+
+            bool converged = difference < tolerance;
+            if (control != nullptr ? control->endIteration(i + 1, difference, converged) : converged) {
+                arenaStatistics = arena.getStatistics();
+                checkpointer.finish();
+                checkpointStatistics = checkpointer.getStatistics();
+                recorder.finish(i + 1, converged);
+                return buildResult(network, &graph, ranks);
+            }
+        }
+        arenaStatistics = arena.getStatistics();
+        checkpointer.finish();
+        checkpointStatistics = checkpointer.getStatistics();
+        recorder.finish(iterations, false);
+        ASSERT(control != nullptr, "Not able to find result in iterations=" << iterations);
+        return buildResult(network, &graph, ranks);
+    }
+
+    // Runs function for a partition of the network in a new thread,
+    // or in the calling thread if partitions are computed inline.
+    template <typename Function, typename... Args>
+    void startPartition(std::vector<std::thread>& threads, Function function, Args... args) const
+    {
+        if (partitionsInline) {
+            function(args...);
+        } else {
+            threads.push_back(std::thread { function, args... });
+        }
+    }
+
     // Each thread generates id for part of the network.
+    // Stops early if control requests to stop.
     static void generateIdentifiersThreadFunction(Network const& network,
         size_t firstPageToUpdate,
-        size_t lastPageToUpdate)
+        size_t lastPageToUpdate,
+        const PageRankControl* control)
     {
         for (size_t index = firstPageToUpdate; index <= lastPageToUpdate;
              ++index) {
+            if (control != nullptr
+                && (index - firstPageToUpdate) % PageRankControl::setupCheckPages == 0
+                && control->isStopRequested()) {
+                return;
+            }
             const Page& page = network.getPages().at(index);
             page.generateId(network.getGenerator());
         }
     }
 
-    void generateIdentifiers(Network const& network) const
+    void generateIdentifiers(Network const& network, const PageRankControl* control) const
     {
         ThreadsInfo pagesThreadsInfo(network.getSize(), numThreads);
 
@@ -169,228 +536,695 @@ private:
             size_t firstPageToUpdate = pagesThreadsInfo.getThreadFirstIndex(threadNumber);
             size_t lastPageToUpdate = pagesThreadsInfo.getThreadLastIndex(threadNumber);
 
-            pagesThreads.push_back(std::thread {
+            startPartition(pagesThreads,
                 generateIdentifiersThreadFunction,
                 std::ref(network),
                 firstPageToUpdate,
-                lastPageToUpdate });
+                lastPageToUpdate,
+                control);
         }
-        for (uint32_t threadNumber = 0;
-             threadNumber < pagesThreadsInfo.getNumberOfThreadsUsed();
-             ++threadNumber) {
-            pagesThreads.at(threadNumber).join();
+        for (auto& thread : pagesThreads) {
+            thread.join();
         }
     }
 
     // Each thread calculates sum for part of the network.
     static void countDangleSumThreadFunction(
         uint32_t threadNumber,
-        const std::vector<PageId>& danglingNodes,
+        const ArenaVector<uint32_t>& danglingNodes,
         size_t firstDanglingNodeInSum,
         size_t lastDanglingNodeInSum,
         std::vector<double>& threadDanglingNodesRankSums,
-        const std::unordered_map<PageId,
-            PageRank,
-            PageIdHash>& previousPageHashMap)
+        const PageRank* previousPageRanks,
+        std::chrono::nanoseconds* busyTime)
     {
+        ThreadBusyTimer busyTimer(busyTime);
+
         double dangleSum = 0;
         for (size_t index = firstDanglingNodeInSum;
              index <= lastDanglingNodeInSum;
              ++index) {
-            dangleSum += previousPageHashMap.at(danglingNodes.at(index));
+            dangleSum += previousPageRanks[danglingNodes[index]];
         }
-        threadDanglingNodesRankSums.at(threadNumber) = dangleSum;
+        threadDanglingNodesRankSums[threadNumber] = dangleSum;
     }
 
+    // Sums of ranks of dangling nodes from network are stored in threadDanglingNodesRankSums.
+    // Index is a thread number.
     double getDanglingNodesRankSum(
-        const std::vector<PageId>& danglingNodes,
-        const std::unordered_map<PageId,
-            PageRank,
-            PageIdHash>& previousPageHashMap) const
+        const ArenaVector<uint32_t>& danglingNodes,
+        const PageRank* previousPageRanks,
+        std::vector<double>& threadDanglingNodesRankSums,
+        WorkerPool& pool,
+        PageRankIterationRecorder& recorder) const
     {
         ThreadsInfo danglingNodeThreadsInfo(danglingNodes.size(), numThreads);
 
-        // Sums of ranks of dangling nodes from network.
-        // Index is a thread number.
-        // Each thread calculates sum for part of the network.
-        std::vector<double> threadDanglingNodesRankSums(danglingNodeThreadsInfo.getNumberOfThreadsUsed());
-
-        std::vector<std::thread> danglingNodesThreads;
-        for (uint32_t threadNumber = 0; threadNumber
-             < danglingNodeThreadsInfo.getNumberOfThreadsUsed();
-             ++threadNumber) {
-
-            size_t firstDanglingNodeInSum = danglingNodeThreadsInfo.getThreadFirstIndex(threadNumber);
-            size_t lastDanglingNodeInSum = danglingNodeThreadsInfo.getThreadLastIndex(threadNumber);
-
-            danglingNodesThreads.push_back(std::thread {
-                countDangleSumThreadFunction,
-                threadNumber,
-                std::ref(danglingNodes),
-                firstDanglingNodeInSum,
-                lastDanglingNodeInSum,
-                std::ref(threadDanglingNodesRankSums),
-                std::ref(previousPageHashMap) });
-        }
-        for (uint32_t threadNumber = 0; threadNumber
-             < danglingNodeThreadsInfo.getNumberOfThreadsUsed();
-             ++threadNumber) {
-            danglingNodesThreads.at(threadNumber).join();
-        }
+        auto countDangleSum = [&](uint32_t threadNumber) {
+            countDangleSumThreadFunction(threadNumber,
+                danglingNodes,
+                danglingNodeThreadsInfo.getThreadFirstIndex(threadNumber),
+                danglingNodeThreadsInfo.getThreadLastIndex(threadNumber),
+                threadDanglingNodesRankSums,
+                previousPageRanks,
+                recorder.getThreadBusyTime(threadNumber));
+        };
+        pool.run(danglingNodeThreadsInfo.getNumberOfThreadsUsed(), countDangleSum);
 
         double danglingNodesRankSum = 0;
-        for (auto sum : threadDanglingNodesRankSums) {
-            danglingNodesRankSum += sum;
+        for (uint32_t threadNumber = 0;
+             threadNumber < danglingNodeThreadsInfo.getNumberOfThreadsUsed();
+             ++threadNumber) {
+            danglingNodesRankSum += threadDanglingNodesRankSums[threadNumber];
         }
         return danglingNodesRankSum;
     }
 
     // Each thread updates pagerank for part of the network.
     static void updatePageRankThreadFunction(
-        const Network& network,
+        const PageRankGraph& graph,
         size_t firstPageToUpdate,
         size_t lastPageToUpdate,
-        std::unordered_map<PageId, PageRank, PageIdHash>& pageHashMap,
-        const std::unordered_map<PageId,
-            PageRank,
-            PageIdHash>& previousPageHashMap,
-        const std::unordered_map<PageId,
-            std::vector<PageId>,
-            PageIdHash>& edges,
-        const std::unordered_map<PageId, uint32_t, PageIdHash>& numLinks,
+        PageRank* pageRanks,
+        const PageRank* previousPageRanks,
         double alpha,
-        PageRank pageRankWithoutLinks)
+        PageRank pageRankWithoutLinks,
+        std::chrono::nanoseconds* busyTime)
     {
-        for (size_t index = firstPageToUpdate; index <= lastPageToUpdate;
-             ++index) {
-            const PageId& pageId = network.getPages().at(index).getId();
-            PageRank& pageRank = pageHashMap.at(pageId);
+        ThreadBusyTimer busyTimer(busyTime);
+
+        const auto& numLinks = graph.getNumLinks();
+        const auto& inEdgesBegin = graph.getInEdgesBegin();
+        const auto& inEdges = graph.getInEdges();
+
+        for (size_t page = firstPageToUpdate; page <= lastPageToUpdate;
+             ++page) {
+            PageRank& pageRank = pageRanks[page];
             pageRank = pageRankWithoutLinks;
 
-            if (edges.count(pageId) > 0) {
-                for (const auto& link : edges.at(pageId)) {
-                    pageRank += alpha * previousPageHashMap.at(link)
-                        / numLinks.at(link);
-                }
+            for (size_t edge = inEdgesBegin[page]; edge < inEdgesBegin[page + 1];
+                 ++edge) {
+                uint32_t link = inEdges[edge];
+                pageRank += alpha * previousPageRanks[link] / numLinks[link];
             }
         }
     }
 
-    void updatePageRank(const Network& network,
-        std::unordered_map<PageId,
-            PageRank,
-            PageIdHash>& pageHashMap,
-        const std::unordered_map<PageId,
-            PageRank,
-            PageIdHash>& previousPageHashMap,
-        const std::unordered_map<PageId,
-            std::vector<PageId>,
-            PageIdHash>& edges,
-        const std::unordered_map<PageId,
-            uint32_t,
-            PageIdHash>& numLinks,
+    void updatePageRank(const PageRankGraph& graph,
+        PageRank* pageRanks,
+        const PageRank* previousPageRanks,
         double alpha,
-        PageRank pageRankWithoutLinks) const
+        PageRank pageRankWithoutLinks,
+        WorkerPool& pool,
+        PageRankIterationRecorder& recorder) const
     {
-        ThreadsInfo pagesThreadsInfo(network.getSize(), numThreads);
-
-        std::vector<std::thread> pagesThreads;
-        for (uint32_t threadNumber = 0;
-             threadNumber < pagesThreadsInfo.getNumberOfThreadsUsed();
-             ++threadNumber) {
-
-            size_t firstPageToUpdate = pagesThreadsInfo.getThreadFirstIndex(threadNumber);
-            size_t lastPageToUpdate = pagesThreadsInfo.getThreadLastIndex(threadNumber);
+        ThreadsInfo pagesThreadsInfo(graph.getSize(), numThreads);
 
-            pagesThreads.push_back(std::thread { updatePageRankThreadFunction,
-                std::ref(network),
-                firstPageToUpdate,
-                lastPageToUpdate,
-                std::ref(pageHashMap),
-                std::ref(previousPageHashMap),
-                std::ref(edges),
-                std::ref(numLinks),
+        auto updatePages = [&](uint32_t threadNumber) {
+            updatePageRankThreadFunction(graph,
+                pagesThreadsInfo.getThreadFirstIndex(threadNumber),
+                pagesThreadsInfo.getThreadLastIndex(threadNumber),
+                pageRanks,
+                previousPageRanks,
                 alpha,
-                pageRankWithoutLinks });
-        }
-        for (uint32_t threadNumber = 0;
-             threadNumber < pagesThreadsInfo.getNumberOfThreadsUsed();
-             ++threadNumber) {
-            pagesThreads.at(threadNumber).join();
-        }
+                pageRankWithoutLinks,
+                recorder.getThreadBusyTime(threadNumber));
+        };
+        pool.run(pagesThreadsInfo.getNumberOfThreadsUsed(), updatePages);
     }
 
     // Each thread calculates sum for part of the network.
     static void countDifferenceSumThreadFunction(
         uint32_t threadNumber,
-        const Network& network,
         size_t firstPageInSum,
         size_t lastPageInSum,
-        const std::unordered_map<PageId, PageRank, PageIdHash>& pageHashMap,
-        const std::unordered_map<PageId,
-            PageRank,
-            PageIdHash>& previousPageHashMap,
-        std::vector<double>& threadDifferenceRankSums)
+        const PageRank* pageRanks,
+        const PageRank* previousPageRanks,
+        std::vector<double>& threadDifferenceRankSums,
+        std::chrono::nanoseconds* busyTime)
     {
+        ThreadBusyTimer busyTimer(busyTime);
 
         double differenceSum = 0;
-        for (size_t index = firstPageInSum; index <= lastPageInSum; ++index) {
-            const PageId& pageId = network.getPages().at(index).getId();
-            differenceSum += std::abs(
-                previousPageHashMap.at(pageId) - pageHashMap.at(pageId));
+        for (size_t page = firstPageInSum; page <= lastPageInSum; ++page) {
+            differenceSum += std::abs(previousPageRanks[page] - pageRanks[page]);
         }
-        threadDifferenceRankSums.at(threadNumber) = differenceSum;
+        threadDifferenceRankSums[threadNumber] = differenceSum;
     }
 
-    double getDifference(const Network& network,
-        const std::unordered_map<PageId,
-            PageRank,
-            PageIdHash>& pageHashMap,
-        const std::unordered_map<PageId,
-            PageRank,
-            PageIdHash>& previousPageHashMap) const
+    // Sums of differences in pagerank between previousPageRanks and pageRanks
+    // are stored in threadDifferenceRankSums. Index is a thread number.
+    double getDifference(const PageRankGraph& graph,
+        const PageRank* pageRanks,
+        const PageRank* previousPageRanks,
+        std::vector<double>& threadDifferenceRankSums,
+        WorkerPool& pool,
+        PageRankIterationRecorder& recorder) const
     {
-        ThreadsInfo pagesThreadsInfo(network.getSize(), numThreads);
+        ThreadsInfo pagesThreadsInfo(graph.getSize(), numThreads);
 
-        // Sums of differences in pagerank between previousPageHashMap and pageHashMap.
-        // Index is a thread number.
-        // Each thread calculates sum for part of the network.
-        std::vector<double>
-            threadDifferenceRankSums(pagesThreadsInfo.getNumberOfThreadsUsed());
+        auto countDifferenceSum = [&](uint32_t threadNumber) {
+            countDifferenceSumThreadFunction(threadNumber,
+                pagesThreadsInfo.getThreadFirstIndex(threadNumber),
+                pagesThreadsInfo.getThreadLastIndex(threadNumber),
+                pageRanks,
+                previousPageRanks,
+                threadDifferenceRankSums,
+                recorder.getThreadBusyTime(threadNumber));
+        };
+        pool.run(pagesThreadsInfo.getNumberOfThreadsUsed(), countDifferenceSum);
 
-        std::vector<std::thread> rankSumDifferenceThreads;
+        double difference = 0;
         for (uint32_t threadNumber = 0;
              threadNumber < pagesThreadsInfo.getNumberOfThreadsUsed();
              ++threadNumber) {
+            difference += threadDifferenceRankSums[threadNumber];
+        }
+        return difference;
+    }
+
+    // Each thread calculates sums of blocks of pages from firstBlock to endBlock.
+    static void countDangleBlockSumsThreadFunction(
+        const ArenaVector<uint32_t>& danglingNodes,
+        size_t firstBlock,
+        size_t endBlock,
+        PageBlockSums& danglingNodesRankSums,
+        const PageRank* previousPageRanks,
+        std::chrono::nanoseconds* busyTime)
+    {
+        ThreadBusyTimer busyTimer(busyTime);
+
+        // Dangling nodes are ordered by page.
+        auto danglingNode = std::lower_bound(danglingNodes.begin(), danglingNodes.end(),
+            PageBlockSums::getBlockFirstPage(firstBlock));
+        auto endDanglingNode = std::lower_bound(danglingNode, danglingNodes.end(),
+            PageBlockSums::getBlockFirstPage(endBlock));
+        danglingNodesRankSums.sumSelectedPages(firstBlock, endBlock, danglingNode, endDanglingNode,
+            [&](uint32_t page) { return previousPageRanks[page]; });
+    }
+
+    double getDanglingNodesRankBlockSum(const PageRankGraph& graph,
+        const PageRank* previousPageRanks,
+        PageBlockSums& danglingNodesRankSums,
+        WorkerPool& pool,
+        PageRankIterationRecorder& recorder) const
+    {
+        ThreadsInfo blocksThreadsInfo(PageBlockSums::getNumberOfBlocks(graph.getSize()), numThreads);
+
+        auto countDangleBlockSums = [&](uint32_t threadNumber) {
+            countDangleBlockSumsThreadFunction(graph.getDanglingNodes(),
+                blocksThreadsInfo.getThreadFirstIndex(threadNumber),
+                blocksThreadsInfo.getThreadLastIndex(threadNumber) + 1,
+                danglingNodesRankSums,
+                previousPageRanks,
+                recorder.getThreadBusyTime(threadNumber));
+        };
+        pool.run(blocksThreadsInfo.getNumberOfThreadsUsed(), countDangleBlockSums);
+
+        return danglingNodesRankSums.getTotal();
+    }
+
+    // Each thread calculates sums of blocks of pages from firstBlock to endBlock.
+    static void countDifferenceBlockSumsThreadFunction(
+        size_t firstBlock,
+        size_t endBlock,
+        size_t numberOfPages,
+        const PageRank* pageRanks,
+        const PageRank* previousPageRanks,
+        PageBlockSums& differenceSums,
+        std::chrono::nanoseconds* busyTime)
+    {
+        ThreadBusyTimer busyTimer(busyTime);
+
+        differenceSums.sumPages(firstBlock, endBlock, numberOfPages, [&](size_t page) {
+            return std::abs(previousPageRanks[page] - pageRanks[page]);
+        });
+    }
+
+    double getDifferenceBlockSum(const PageRankGraph& graph,
+        const PageRank* pageRanks,
+        const PageRank* previousPageRanks,
+        PageBlockSums& differenceSums,
+        WorkerPool& pool,
+        PageRankIterationRecorder& recorder) const
+    {
+        ThreadsInfo blocksThreadsInfo(PageBlockSums::getNumberOfBlocks(graph.getSize()), numThreads);
+
+        auto countDifferenceBlockSums = [&](uint32_t threadNumber) {
+            countDifferenceBlockSumsThreadFunction(
+                blocksThreadsInfo.getThreadFirstIndex(threadNumber),
+                blocksThreadsInfo.getThreadLastIndex(threadNumber) + 1,
+                graph.getSize(),
+                pageRanks,
+                previousPageRanks,
+                differenceSums,
+                recorder.getThreadBusyTime(threadNumber));
+        };
+        pool.run(blocksThreadsInfo.getNumberOfThreadsUsed(), countDifferenceBlockSums);
+
+        return differenceSums.getTotal();
+    }
+
+    // Threads wait on barrier until all of them reach it.
+    class Barrier {
+    public:
+        Barrier(uint32_t numberOfThreadsArg)
+            : numberOfThreads(numberOfThreadsArg)
+            , waiting(0)
+            , generation(0)
+        {
+        }
+
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            uint64_t arrivalGeneration = generation;
+            if (++waiting == numberOfThreads) {
+                waiting = 0;
+                generation++;
+                allArrived.notify_all();
+            } else {
+                allArrived.wait(lock, [&] { return generation != arrivalGeneration; });
+            }
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable allArrived;
+        uint32_t numberOfThreads;
+        uint32_t waiting;
+        uint64_t generation;
+    };
+
+    // State shared by threads of NUMA aware computation.
+    struct NumaSharedState {
+        NumaSharedState(const PageRankGraph& graphArg,
+            const NumaTopology& topologyArg,
+            const ThreadsInfo& threadsInfoArg)
+            : graph(graphArg)
+            , topology(topologyArg)
+            , threadsInfo(threadsInfoArg)
+            , barrier(threadsInfoArg.getNumberOfThreadsUsed())
+            , threadDanglingNodesRankSums(threadsInfoArg.getNumberOfThreadsUsed())
+            , threadDifferenceRankSums(threadsInfoArg.getNumberOfThreadsUsed())
+            , threadLocalPages(threadsInfoArg.getNumberOfThreadsUsed())
+            , threadRemotePages(threadsInfoArg.getNumberOfThreadsUsed())
+        {
+        }
+
+        // Threads own pagesPerPart pages for every part given to them by threadsInfo.
+        size_t getThreadFirstPage(uint32_t threadNumber) const
+        {
+            return threadsInfo.getThreadFirstIndex(threadNumber) * pagesPerPart;
+        }
+
+        size_t getThreadLastPage(uint32_t threadNumber) const
+        {
+            return std::min((threadsInfo.getThreadLastIndex(threadNumber) + 1) * pagesPerPart,
+                       graph.getSize())
+                - 1;
+        }
+
+        const PageRankGraph& graph;
+        const NumaTopology& topology;
+        const ThreadsInfo& threadsInfo;
+        size_t pagesPerPart = 1;
+        Barrier barrier;
+
+        // Used only by thread 0.
+        PageRankIterationRecorder* recorder;
+        PageRankControl* control;
+        PageRankCheckpointer* checkpointer;
+        size_t bytesAllocated;
+
+        // Ranks are not initialised by the main thread,
+        // so each page of them is first touched by the thread owning it.
+        std::unique_ptr<PageRank[]> ranks;
+        std::unique_ptr<PageRank[]> otherRanks;
+        // Ranks restored from a checkpoint, or null to start from equal ranks.
+        const PageRank* initialRanks = nullptr;
+        uint32_t firstIteration = 0;
+        // Points to ranks or otherRanks after the computation stopped.
+        const PageRank* result = nullptr;
+        bool converged = false;
+        // Decision of control, written by thread 0.
+        bool stop = false;
+        uint32_t iterationsDone = 0;
+
+        double alpha;
+        uint32_t iterations;
+        double tolerance;
+
+        // Used instead of sums of threads in reproducible mode.
+        PageBlockSums* danglingNodesRankSums = nullptr;
+        PageBlockSums* differenceSums = nullptr;
+
+        // Index is a thread number.
+        std::vector<double> threadDanglingNodesRankSums;
+        std::vector<double> threadDifferenceRankSums;
+        std::vector<uint64_t> threadLocalPages;
+        std::vector<uint64_t> threadRemotePages;
+    };
+
+    // Each thread owns part of the pages. It keeps their in-edges in its own memory
+    // and is the only one writing their ranks.
+    static void numaThreadFunction(uint32_t threadNumber,
+        size_t node,
+        NumaSharedState& state)
+    {
+        const PageRankGraph& graph = state.graph;
+        bool pinned = state.topology.pinCurrentThreadToNode(node);
+
+        size_t firstPage = state.getThreadFirstPage(threadNumber);
+        size_t lastPage = state.getThreadLastPage(threadNumber);
+        // Owned blocks of pages in reproducible mode.
+        size_t firstBlock = firstPage / PageBlockSums::blockSize;
+        size_t endBlock = lastPage / PageBlockSums::blockSize + 1;
+
+        PageRank* ranks = state.ranks.get();
+        PageRank* previousRanks = state.otherRanks.get();
+        for (size_t page = firstPage; page <= lastPage; ++page) {
+            ranks[page] = state.initialRanks != nullptr
+                ? state.initialRanks[page]
+                : 1.0 / graph.getSize();
+            previousRanks[page] = 0;
+        }
+
+        // Local copy of the in-edge segment of owned pages.
+        size_t firstEdge = graph.getInEdgesBegin()[firstPage];
+        std::vector<size_t> inEdgesBegin;
+        for (size_t page = firstPage; page <= lastPage + 1; ++page) {
+            inEdgesBegin.push_back(graph.getInEdgesBegin()[page] - firstEdge);
+        }
+        std::vector<uint32_t> inEdges(graph.getInEdges().begin() + firstEdge,
+            graph.getInEdges().begin() + firstEdge + inEdgesBegin.back());
+
+        std::vector<uint32_t> danglingNodes;
+        for (size_t page = firstPage; page <= lastPage; ++page) {
+            if (graph.getNumLinks()[page] == 0) {
+                danglingNodes.push_back(page);
+            }
+        }
+
+        if (pinned) {
+            size_t pages = lastPage - firstPage + 1;
+            uint64_t& localPages = state.threadLocalPages.at(threadNumber);
+            uint64_t& remotePages = state.threadRemotePages.at(threadNumber);
+            state.topology.countPagePlacement(ranks + firstPage,
+                pages * sizeof(PageRank), node, localPages, remotePages);
+            state.topology.countPagePlacement(previousRanks + firstPage,
+                pages * sizeof(PageRank), node, localPages, remotePages);
+            state.topology.countPagePlacement(inEdgesBegin.data(),
+                inEdgesBegin.size() * sizeof(size_t), node, localPages, remotePages);
+            state.topology.countPagePlacement(inEdges.data(),
+                inEdges.size() * sizeof(uint32_t), node, localPages, remotePages);
+        }
+
+        const auto& numLinks = graph.getNumLinks();
+        const double danglingWeight = 1.0 / graph.getSize();
+        const double alpha = state.alpha;
 
-            size_t firstPageInSum = pagesThreadsInfo.getThreadFirstIndex(threadNumber);
-            size_t lastPageInSum = pagesThreadsInfo.getThreadLastIndex(threadNumber);
+        PageRankIterationRecorder& recorder = *state.recorder;
+        // Busy time of this thread is published before the second barrier of every iteration,
+        // so thread 0 can report busy times of all threads.
+        std::chrono::nanoseconds* publishedBusyTime = recorder.getThreadBusyTime(threadNumber);
+        std::chrono::nanoseconds busyTime { 0 };
 
-            rankSumDifferenceThreads.push_back(std::thread {
-                countDifferenceSumThreadFunction,
+        for (uint32_t i = state.firstIteration; i < state.iterations; ++i) {
+            if (threadNumber == 0) {
+                recorder.startIteration(i);
+            }
+
+            {
+                ThreadBusyTimer busyTimer(publishedBusyTime != nullptr ? &busyTime : nullptr);
+
+                std::swap(ranks, previousRanks);
+
+                if (state.danglingNodesRankSums != nullptr) {
+                    state.danglingNodesRankSums->sumSelectedPages(firstBlock, endBlock,
+                        danglingNodes.begin(), danglingNodes.end(),
+                        [&](uint32_t page) { return previousRanks[page]; });
+                } else {
+                    double dangleSum = 0;
+                    for (uint32_t danglingNode : danglingNodes) {
+                        dangleSum += previousRanks[danglingNode];
+                    }
+                    state.threadDanglingNodesRankSums.at(threadNumber) = dangleSum;
+                }
+            }
+
+            state.barrier.wait();
+
+            if (threadNumber == 0) {
+                recorder.endPhase(PageRankIterationRecorder::Phase::dangling);
+            }
+
+            ThreadBusyTimer busyTimer(publishedBusyTime != nullptr ? &busyTime : nullptr);
+
+            double danglingNodesRankSum = 0;
+            if (state.danglingNodesRankSums != nullptr) {
+                danglingNodesRankSum = state.danglingNodesRankSums->getTotal();
+            } else {
+                for (auto sum : state.threadDanglingNodesRankSums) {
+                    danglingNodesRankSum += sum;
+                }
+            }
+            const double danglingNodesRankSumBeforeAlpha = danglingNodesRankSum;
+            danglingNodesRankSum *= alpha;
+            PageRank pageRankWithoutLinks = danglingNodesRankSum * danglingWeight
+                + (1.0 - alpha) / graph.getSize();
+
+            // Returns difference of the updated rank.
+            auto updatePageRank = [&](size_t page) {
+                PageRank pageRank = pageRankWithoutLinks;
+                size_t localPage = page - firstPage;
+                for (size_t edge = inEdgesBegin[localPage];
+                     edge < inEdgesBegin[localPage + 1];
+                     ++edge) {
+                    uint32_t link = inEdges[edge];
+                    pageRank += alpha * previousRanks[link] / numLinks[link];
+                }
+                ranks[page] = pageRank;
+                return std::abs(previousRanks[page] - pageRank);
+            };
+            if (state.differenceSums != nullptr) {
+                state.differenceSums->sumPages(firstBlock, endBlock, graph.getSize(), updatePageRank);
+            } else {
+                double differenceSum = 0;
+                for (size_t page = firstPage; page <= lastPage; ++page) {
+                    differenceSum += updatePageRank(page);
+                }
+                state.threadDifferenceRankSums.at(threadNumber) = differenceSum;
+            }
+
+            busyTimer.stop();
+            if (publishedBusyTime != nullptr) {
+                *publishedBusyTime = busyTime;
+                busyTime = std::chrono::nanoseconds(0);
+            }
+
+            state.barrier.wait();
+
+            double difference = 0;
+            if (state.differenceSums != nullptr) {
+                difference = state.differenceSums->getTotal();
+            } else {
+                for (auto sum : state.threadDifferenceRankSums) {
+                    difference += sum;
+                }
+            }
+
+            // Every thread sees the same difference, so all of them stop together.
+            bool converged = difference < state.tolerance;
+            bool stop = converged;
+
+            if (recorder.isEnabled() || state.control != nullptr
+                || state.checkpointer->isEnabled()) {
+                if (threadNumber == 0) {
+                    recorder.endPhase(PageRankIterationRecorder::Phase::update);
+                    recorder.endIteration(difference, danglingNodesRankSumBeforeAlpha,
+                        state.bytesAllocated);
+                    state.checkpointer->endIteration(i + 1, ranks, difference);
+                    if (state.control != nullptr) {
+                        state.stop = state.control->endIteration(i + 1, difference, converged);
+                    }
+                }
+                // Others can not publish busy times until thread 0 reported them,
+                // overwrite ranks until they are copied to a checkpoint,
+                // and can not stop until thread 0 asked control.
+                state.barrier.wait();
+                if (state.control != nullptr) {
+                    stop = state.stop;
+                }
+            }
+
+            if (threadNumber == 0) {
+                state.iterationsDone = i + 1;
+            }
+            if (stop) {
+                if (threadNumber == 0) {
+                    state.result = ranks;
+                    state.converged = converged;
+                }
+                return;
+            }
+        }
+
+        if (threadNumber == 0) {
+            state.result = ranks;
+        }
+    }
+
+    template <typename ResultBuilder>
+    auto computeRanksNuma(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance,
+        ResultBuilder buildResult,
+        PageRankControl* control,
+        bool resume) const
+        -> decltype(buildResult(network, static_cast<const PageRankGraph*>(nullptr),
+            static_cast<const PageRank*>(nullptr)))
+    {
+        HugePageArena arena;
+        PageRankGraph graph(network, arena);
+        if (control != nullptr && control->endSetupPhase()) {
+            return decltype(buildResult(network, &graph, static_cast<const PageRank*>(nullptr)))();
+        }
+        NumaTopology topology;
+        // In reproducible mode threads get whole blocks of pages.
+        size_t pagesPerPart = reproducible ? PageBlockSums::blockSize : 1;
+        ThreadsInfo pagesThreadsInfo(reproducible
+                ? PageBlockSums::getNumberOfBlocks(graph.getSize())
+                : graph.getSize(),
+            numThreads);
+
+        numaStatistics = NumaStatistics();
+        numaStatistics.available = topology.isAvailable();
+
+        if (graph.getSize() == 0) {
+            if (control != nullptr) {
+                control->endIteration(0, 0, true);
+            }
+            return buildResult(network, &graph, nullptr);
+        }
+
+        PageRankIterationRecorder recorder(observer, getName(), network.getSize(),
+            pagesThreadsInfo.getNumberOfThreadsUsed());
+
+        PageRankCheckpointer checkpointer(checkpointOptions, network, graph, alpha, reproducible);
+        std::vector<PageRank> restoredRanks(resume ? graph.getSize() : 0);
+        double restoredDifference = 0;
+        uint32_t firstIteration = resume
+            ? checkpointer.restore(restoredRanks.data(), iterations, restoredDifference)
+            : 0;
+
+        // Computation converged at the checkpoint, another iteration would change ranks.
+        if (firstIteration > 0 && restoredDifference < tolerance) {
+            if (control != nullptr) {
+                control->endIteration(firstIteration, restoredDifference, true);
+            }
+            arenaStatistics = arena.getStatistics();
+            checkpointer.finish();
+            checkpointStatistics = checkpointer.getStatistics();
+            recorder.finish(firstIteration, true);
+            return buildResult(network, &graph, restoredRanks.data());
+        }
+
+        PageBlockSums danglingNodesRankSums(reproducible ? graph.getSize() : 0);
+        PageBlockSums differenceSums(reproducible ? graph.getSize() : 0);
+
+        NumaSharedState state(graph, topology, pagesThreadsInfo);
+        state.pagesPerPart = pagesPerPart;
+        if (reproducible) {
+            state.danglingNodesRankSums = &danglingNodesRankSums;
+            state.differenceSums = &differenceSums;
+        }
+        state.initialRanks = firstIteration > 0 ? restoredRanks.data() : nullptr;
+        state.firstIteration = firstIteration;
+        state.checkpointer = &checkpointer;
+        state.ranks.reset(new PageRank[graph.getSize()]);
+        state.otherRanks.reset(new PageRank[graph.getSize()]);
+        state.recorder = &recorder;
+        state.control = control;
+        state.bytesAllocated = arena.getStatistics().allocatedBytes
+            + 2 * graph.getSize() * sizeof(PageRank);
+        state.alpha = alpha;
+        state.iterations = iterations;
+        state.tolerance = tolerance;
+
+        std::vector<NumaNodeCounters> countersBefore = topology.readCounters();
+
+        // Threads are assigned to nodes in contiguous groups,
+        // so pages of every node form a contiguous range.
+        // Started threads iterate meanwhile, so the vector must not grow.
+        std::vector<std::thread> pagesThreads;
+        pagesThreads.reserve(pagesThreadsInfo.getNumberOfThreadsUsed());
+        for (uint32_t threadNumber = 0;
+             threadNumber < pagesThreadsInfo.getNumberOfThreadsUsed();
+             ++threadNumber) {
+            size_t node = static_cast<size_t>(threadNumber)
+                * topology.getNumberOfNodes()
+                / pagesThreadsInfo.getNumberOfThreadsUsed();
+
+            pagesThreads.push_back(std::thread {
+                numaThreadFunction,
                 threadNumber,
-                std::ref(network),
-                firstPageInSum,
-                lastPageInSum,
-                std::ref(pageHashMap),
-                std::ref(previousPageHashMap),
-                std::ref(threadDifferenceRankSums) });
+                node,
+                std::ref(state) });
         }
         for (uint32_t threadNumber = 0;
              threadNumber < pagesThreadsInfo.getNumberOfThreadsUsed();
              ++threadNumber) {
-            rankSumDifferenceThreads.at(threadNumber).join();
+            pagesThreads.at(threadNumber).join();
         }
 
-        double difference = 0;
-        for (auto sum : threadDifferenceRankSums) {
-            difference += sum;
+        std::vector<NumaNodeCounters> countersAfter = topology.readCounters();
+        for (size_t node = 0; node < countersAfter.size(); ++node) {
+            NumaNodeCounters counters;
+            counters.numaHit = countersAfter[node].numaHit - countersBefore[node].numaHit;
+            counters.numaMiss = countersAfter[node].numaMiss - countersBefore[node].numaMiss;
+            counters.localNode = countersAfter[node].localNode - countersBefore[node].localNode;
+            counters.otherNode = countersAfter[node].otherNode - countersBefore[node].otherNode;
+            numaStatistics.nodeCounters.push_back(counters);
         }
-        return difference;
+        for (uint32_t threadNumber = 0;
+             threadNumber < pagesThreadsInfo.getNumberOfThreadsUsed();
+             ++threadNumber) {
+            numaStatistics.localPages += state.threadLocalPages.at(threadNumber);
+            numaStatistics.remotePages += state.threadRemotePages.at(threadNumber);
+        }
+
+        arenaStatistics = arena.getStatistics();
+        checkpointer.finish();
+        checkpointStatistics = checkpointer.getStatistics();
+        recorder.finish(state.iterationsDone, state.converged);
+        ASSERT(state.converged || control != nullptr,
+            "Not able to find result in iterations=" << iterations);
+
+        return buildResult(network, &graph, state.result);
     }
 
 private:
+    void assertNotComputing() const
+    {
+        ASSERT(!computing.load(std::memory_order_acquire),
+            "Statistics of " << getName() << " read while it computes");
+    }
+
     uint32_t numThreads;
+    bool numaAware;
+    bool partitionsInline = false;
+    bool reproducible = false;
+    PageRankObserver* observer = nullptr;
+
+    PageRankCheckpointOptions checkpointOptions;
+
+    mutable std::atomic<bool> computing { false };
+    mutable ArenaStatistics arenaStatistics;
+    mutable PageRankCheckpointStatistics checkpointStatistics;
+    mutable NumaStatistics numaStatistics;
+    mutable PageRankBatchStatistics batchStatistics;
 };
 
 #endif /* SRC_MULTITHREADEDPAGERANKCOMPUTER_HPP_ */
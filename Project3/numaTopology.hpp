@@ -0,0 +1,189 @@
+#ifndef SRC_NUMATOPOLOGY_HPP_
+#define SRC_NUMATOPOLOGY_HPP_
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Counters from /sys/devices/system/node/node<N>/numastat.
+struct NumaNodeCounters {
+    uint64_t numaHit = 0;
+    uint64_t numaMiss = 0;
+    uint64_t localNode = 0;
+    uint64_t otherNode = 0;
+};
+
+// Memory locality of a NUMA aware computation.
+struct NumaStatistics {
+    // False if the OS does not expose NUMA information.
+    bool available = false;
+
+    // Pages of rank slices and in-edge segments placed on the node
+    // of the thread that owns them, and on other nodes.
+    uint64_t localPages = 0;
+    uint64_t remotePages = 0;
+
+    // Change of numastat counters of every node during the computation.
+    // Counters are system wide, so other processes are included.
+    std::vector<NumaNodeCounters> nodeCounters;
+};
+
+// NUMA nodes and their cpus read from sysfs.
+// Without NUMA information the whole machine is a single node.
+class NumaTopology {
+public:
+    NumaTopology()
+    {
+        std::ifstream online(nodesPath + "online");
+        std::string nodeList;
+        if (online >> nodeList) {
+            for (int node : parseList(nodeList)) {
+                std::ifstream cpuList(nodePath(node) + "cpulist");
+                std::string cpus;
+                cpuList >> cpus;
+                nodeIds.push_back(node);
+                nodeCpus.push_back(parseList(cpus));
+            }
+        }
+        available = !nodeIds.empty();
+
+        if (!available) {
+            nodeIds.push_back(0);
+            nodeCpus.push_back({});
+        }
+    }
+
+    bool isAvailable() const
+    {
+        return available;
+    }
+
+    size_t getNumberOfNodes() const
+    {
+        return nodeIds.size();
+    }
+
+    // Returns false if the thread could not be pinned.
+    bool pinCurrentThreadToNode(size_t node) const
+    {
+        if (!available || nodeCpus.at(node).empty()) {
+            return false;
+        }
+
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (int cpu : nodeCpus.at(node)) {
+            CPU_SET(cpu, &cpuSet);
+        }
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+    }
+
+    std::vector<NumaNodeCounters> readCounters() const
+    {
+        std::vector<NumaNodeCounters> counters(getNumberOfNodes());
+        if (!available) {
+            return counters;
+        }
+
+        for (size_t node = 0; node < getNumberOfNodes(); ++node) {
+            std::ifstream numaStat(nodePath(nodeIds[node]) + "numastat");
+            std::string name;
+            uint64_t value;
+            while (numaStat >> name >> value) {
+                if (name == "numa_hit") {
+                    counters[node].numaHit = value;
+                } else if (name == "numa_miss") {
+                    counters[node].numaMiss = value;
+                } else if (name == "local_node") {
+                    counters[node].localNode = value;
+                } else if (name == "other_node") {
+                    counters[node].otherNode = value;
+                }
+            }
+        }
+        return counters;
+    }
+
+    // Adds pages of [begin, begin + bytes) to local or remote pages
+    // depending on whether they reside on node.
+    // Pages that were not touched yet are skipped.
+    void countPagePlacement(const void* begin,
+        size_t bytes,
+        size_t node,
+        uint64_t& localPages,
+        uint64_t& remotePages) const
+    {
+        if (!available || bytes == 0) {
+            return;
+        }
+
+        const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+        uintptr_t first = reinterpret_cast<uintptr_t>(begin) & ~(pageSize - 1);
+        uintptr_t end = reinterpret_cast<uintptr_t>(begin) + bytes;
+
+        std::vector<void*> pages;
+        for (uintptr_t page = first; page < end; page += pageSize) {
+            pages.push_back(reinterpret_cast<void*>(page));
+        }
+
+        // With null nodes move_pages only reports node of every page.
+        std::vector<int> status(pages.size());
+        if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr,
+                status.data(), 0)
+            != 0) {
+            return;
+        }
+
+        for (int pageNode : status) {
+            if (pageNode == nodeIds.at(node)) {
+                localPages++;
+            } else if (pageNode >= 0) {
+                remotePages++;
+            }
+        }
+    }
+
+private:
+    static std::string nodePath(int node)
+    {
+        return nodesPath + "node" + std::to_string(node) + "/";
+    }
+
+    // Parses lists like "0-3,8,10-11".
+    static std::vector<int> parseList(const std::string& list)
+    {
+        std::vector<int> result;
+        std::stringstream stream(list);
+        std::string range;
+        while (std::getline(stream, range, ',')) {
+            if (range.empty()) {
+                continue;
+            }
+
+            size_t dashPos = range.find('-');
+            int first = std::stoi(range.substr(0, dashPos));
+            int last = dashPos == std::string::npos
+                ? first
+                : std::stoi(range.substr(dashPos + 1));
+            for (int value = first; value <= last; ++value) {
+                result.push_back(value);
+            }
+        }
+        return result;
+    }
+
+    static inline const std::string nodesPath = "/sys/devices/system/node/";
+
+    bool available;
+    std::vector<int> nodeIds;
+    std::vector<std::vector<int>> nodeCpus;
+};
+
+#endif /* SRC_NUMATOPOLOGY_HPP_ */
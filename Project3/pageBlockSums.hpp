@@ -0,0 +1,85 @@
+#ifndef SRC_PAGEBLOCKSUMS_HPP_
+#define SRC_PAGEBLOCKSUMS_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Sum of values of pages that does not depend on how pages are divided among threads.
+// Pages are divided into blocks of blockSize pages. Values of a block are added
+// in order of pages, starting from zero, then block sums are added in a fixed pairwise tree.
+// Threads have to own whole blocks.
+class PageBlockSums {
+public:
+    static constexpr size_t blockSize = 2048;
+
+    static size_t getNumberOfBlocks(size_t numberOfPages)
+    {
+        return (numberOfPages + blockSize - 1) / blockSize;
+    }
+
+    static size_t getBlockFirstPage(size_t block)
+    {
+        return block * blockSize;
+    }
+
+    PageBlockSums(size_t numberOfPages)
+        : sums(getNumberOfBlocks(numberOfPages), 0)
+    {
+    }
+
+    // Sets sums of blocks from firstBlock to endBlock to sums of value(page) of their pages.
+    template <typename Value>
+    void sumPages(size_t firstBlock, size_t endBlock, size_t numberOfPages, Value value)
+    {
+        for (size_t block = firstBlock; block < endBlock; ++block) {
+            size_t endPage = std::min(getBlockFirstPage(block + 1), numberOfPages);
+            double sum = 0;
+            for (size_t page = getBlockFirstPage(block); page < endPage; ++page) {
+                sum += value(page);
+            }
+            sums[block] = sum;
+        }
+    }
+
+    // Sets sums of blocks from firstBlock to endBlock to sums of value(page)
+    // of the given pages, which have to be sorted and lie in these blocks.
+    template <typename Iterator, typename Value>
+    void sumSelectedPages(size_t firstBlock, size_t endBlock,
+        Iterator page, Iterator endPage, Value value)
+    {
+        std::fill(sums.begin() + firstBlock, sums.begin() + endBlock, 0);
+        while (page != endPage) {
+            size_t block = *page / blockSize;
+            size_t endBlockPage = getBlockFirstPage(block + 1);
+            double sum = 0;
+            for (; page != endPage && *page < endBlockPage; ++page) {
+                sum += value(*page);
+            }
+            sums[block] = sum;
+        }
+    }
+
+    double getTotal() const
+    {
+        return addPairwise(sums.data(), sums.size());
+    }
+
+private:
+    // Tree depends only on the number of blocks.
+    static double addPairwise(const double* values, size_t count)
+    {
+        if (count == 0) {
+            return 0;
+        }
+        if (count == 1) {
+            return values[0];
+        }
+        size_t half = count / 2;
+        return addPairwise(values, half) + addPairwise(values + half, count - half);
+    }
+
+    std::vector<double> sums;
+};
+
+#endif /* SRC_PAGEBLOCKSUMS_HPP_ */
@@ -0,0 +1,118 @@
+// Test that iterations of page rank computers allocate no heap memory.
+// Runs both computers, in plain and reproducible mode, and fails with exit code 1
+// if any iteration after the first one allocated, as counted by HeapAllocationCounter.
+//
+// Usage: pageRankAllocationTest
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "immutable/network.hpp"
+#include "immutable/pageRankComputer.hpp"
+
+#include "heapAllocationCounter.hpp"
+#include "multiThreadedPageRankComputer.hpp"
+#include "pageRankObserver.hpp"
+#include "singleThreadedPageRankComputer.hpp"
+
+namespace {
+
+const uint32_t PAGES = 20000;
+const uint32_t MAX_LINKS = 6;
+// Enough iterations to be counted, networks converge before the limit.
+const uint32_t MIN_ITERATIONS = 3;
+
+class ContentIdGenerator : public IdGenerator {
+public:
+    PageId generateId(std::string const& content) const override
+    {
+        return PageId(content);
+    }
+};
+
+// Random network with dangling pages and pages linking to themselves.
+Network generateNetwork(IdGenerator const& generator)
+{
+    Network network(generator);
+    std::mt19937 random(PAGES);
+    for (uint32_t page = 0; page < PAGES; ++page) {
+        Page newPage("page" + std::to_string(page));
+        uint32_t links = random() % MAX_LINKS;
+        for (uint32_t link = 0; link < links; ++link) {
+            newPage.addLink(generator.generateId("page" + std::to_string(random() % PAGES)));
+        }
+        network.addPage(newPage);
+    }
+    return network;
+}
+
+// Counts iterations and heap allocations made after the first iteration ended.
+class IterationCounter : public PageRankObserver {
+public:
+    void onIteration(const PageRankIterationStatistics&) override
+    {
+        uint64_t allocations = HeapAllocationCounter::getAllocations();
+        if (iterations > 0) {
+            iterationAllocations += allocations - lastAllocations;
+        }
+        lastAllocations = allocations;
+        iterations++;
+    }
+
+    uint32_t iterations = 0;
+    uint64_t iterationAllocations = 0;
+
+private:
+    uint64_t lastAllocations = 0;
+};
+
+// Returns true if iterations of computer allocated nothing.
+template <typename Computer>
+bool checkComputer(Computer& computer, Network const& network, bool reproducible)
+{
+    IterationCounter counter;
+    computer.setObserver(&counter);
+    computer.setReproducible(reproducible);
+    computer.computeForNetwork(network, 0.85, 1000, 1e-12);
+    computer.setObserver(nullptr);
+
+    std::string mode = reproducible ? " (reproducible)" : "";
+    if (counter.iterations < MIN_ITERATIONS) {
+        std::cerr << computer.getName() << mode << " ran only "
+                  << counter.iterations << " iterations" << std::endl;
+        return false;
+    }
+    if (counter.iterationAllocations != 0) {
+        std::cerr << computer.getName() << mode << " allocated heap memory "
+                  << counter.iterationAllocations << " times in "
+                  << counter.iterations - 1 << " iterations" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main()
+{
+    ContentIdGenerator generator;
+    Network network = generateNetwork(generator);
+
+    bool passed = true;
+    for (bool reproducible : { false, true }) {
+        SingleThreadedPageRankComputer single;
+        passed = checkComputer(single, network, reproducible) && passed;
+
+        for (uint32_t threads : { 1u, 2u, 4u }) {
+            for (bool numaAware : { false, true }) {
+                MultiThreadedPageRankComputer multi(threads, numaAware);
+                passed = checkComputer(multi, network, reproducible) && passed;
+            }
+        }
+    }
+
+    std::cout << (passed ? "ALL TESTS PASSED" : "TESTS FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,492 @@
+// Benchmark of page rank computers and id generators on synthetic networks.
+// Every measurement is printed to stdout as a single line JSON object.
+//
+// Usage: pageRankBenchmark [--scale=S] [--edge-factor=E] [--max-threads=T]
+//                          [--repetitions=R] [--graphs=rmat,ba,er,dangling]
+//                          [--id-pages=P] [--batch-networks=N] [--batch-pages=B]
+//                          [--reproducible]
+// Networks have 2^S pages and about E links per page.
+// Batches have N networks of up to B pages.
+// Benchmark fails if an iteration of a computer allocates heap memory.
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "immutable/network.hpp"
+#include "immutable/pageRankComputer.hpp"
+
+#include "heapAllocationCounter.hpp"
+#include "multiThreadedPageRankComputer.hpp"
+#include "pageRankObserver.hpp"
+#include "sha256IdCache.hpp"
+#include "sha256IdGenerator.hpp"
+#include "shardedPageRankComputer.hpp"
+#include "singleThreadedPageRankComputer.hpp"
+
+namespace {
+
+// Id of a page is its content, so links can be created before ids are generated.
+class ContentIdGenerator : public IdGenerator {
+public:
+    PageId generateId(std::string const& content) const override
+    {
+        return PageId(content);
+    }
+};
+
+std::string pageContent(uint32_t page)
+{
+    return "page" + std::to_string(page);
+}
+
+// Builds networks from lists of links.
+class SyntheticNetworkGenerator {
+public:
+    SyntheticNetworkGenerator(uint32_t seed)
+        : random(seed)
+    {
+    }
+
+    // Recursive matrix graph with Graph500 parameters.
+    Network generateRmat(IdGenerator const& generator, uint32_t scale, uint32_t edgeFactor)
+    {
+        const double a = 0.57, b = 0.19, c = 0.19;
+        uint32_t size = 1u << scale;
+        std::vector<std::vector<uint32_t>> links(size);
+        std::uniform_real_distribution<double> probability(0, 1);
+
+        for (uint64_t edge = 0; edge < static_cast<uint64_t>(size) * edgeFactor; ++edge) {
+            uint32_t from = 0, to = 0;
+            for (uint32_t bit = 0; bit < scale; ++bit) {
+                double p = probability(random);
+                bool fromBit = p >= a + b;
+                bool toBit = (p >= a && p < a + b) || p >= a + b + c;
+                from |= static_cast<uint32_t>(fromBit) << bit;
+                to |= static_cast<uint32_t>(toBit) << bit;
+            }
+            links[from].push_back(to);
+        }
+        return buildNetwork(generator, links);
+    }
+
+    // Preferential attachment, every new page links to edgeFactor existing pages.
+    Network generateBarabasiAlbert(IdGenerator const& generator, uint32_t size, uint32_t edgeFactor)
+    {
+        std::vector<std::vector<uint32_t>> links(size);
+        // Every page appears here once per link it takes part in.
+        std::vector<uint32_t> endpoints;
+
+        uint32_t initialSize = std::min(size, edgeFactor + 1);
+        for (uint32_t page = 0; page < initialSize; ++page) {
+            for (uint32_t other = 0; other < initialSize; ++other) {
+                if (page != other) {
+                    links[page].push_back(other);
+                    endpoints.push_back(page);
+                    endpoints.push_back(other);
+                }
+            }
+        }
+
+        for (uint32_t page = initialSize; page < size; ++page) {
+            for (uint32_t link = 0; link < edgeFactor; ++link) {
+                std::uniform_int_distribution<size_t> endpoint(0, endpoints.size() - 1);
+                uint32_t target = endpoints[endpoint(random)];
+                links[page].push_back(target);
+                endpoints.push_back(target);
+            }
+            for (uint32_t link = 0; link < edgeFactor; ++link) {
+                endpoints.push_back(page);
+            }
+        }
+        return buildNetwork(generator, links);
+    }
+
+    // Every link has uniformly random ends.
+    Network generateErdosRenyi(IdGenerator const& generator, uint32_t size, uint32_t edgeFactor)
+    {
+        std::vector<std::vector<uint32_t>> links(size);
+        std::uniform_int_distribution<uint32_t> page(0, size - 1);
+        for (uint64_t edge = 0; edge < static_cast<uint64_t>(size) * edgeFactor; ++edge) {
+            links[page(random)].push_back(page(random));
+        }
+        return buildNetwork(generator, links);
+    }
+
+    // Erdos-Renyi graph in which most of the pages have no links.
+    Network generateManyDangling(IdGenerator const& generator,
+        uint32_t size,
+        uint32_t edgeFactor,
+        double danglingFraction = 0.8)
+    {
+        std::vector<std::vector<uint32_t>> links(size);
+        uint32_t linkingPages = std::max<uint32_t>(1, size * (1 - danglingFraction));
+        std::uniform_int_distribution<uint32_t> source(0, linkingPages - 1);
+        std::uniform_int_distribution<uint32_t> target(0, size - 1);
+        for (uint64_t edge = 0; edge < static_cast<uint64_t>(size) * edgeFactor; ++edge) {
+            links[source(random)].push_back(target(random));
+        }
+        return buildNetwork(generator, links);
+    }
+
+private:
+    static Network buildNetwork(IdGenerator const& generator,
+        const std::vector<std::vector<uint32_t>>& links)
+    {
+        Network network(generator);
+        for (uint32_t page = 0; page < links.size(); ++page) {
+            Page newPage(pageContent(page));
+            for (uint32_t link : links[page]) {
+                newPage.addLink(PageId(pageContent(link)));
+            }
+            network.addPage(newPage);
+        }
+        return network;
+    }
+
+    std::mt19937_64 random;
+};
+
+// Counts iterations and heap allocations made after the first iteration ended.
+class IterationCounter : public PageRankObserver {
+public:
+    void onIteration(const PageRankIterationStatistics&) override
+    {
+        uint64_t allocations = HeapAllocationCounter::getAllocations();
+        if (iterations > 0) {
+            iterationAllocations += allocations - lastAllocations;
+        }
+        lastAllocations = allocations;
+        iterations++;
+    }
+
+    uint32_t iterations = 0;
+    uint64_t iterationAllocations = 0;
+
+private:
+    uint64_t lastAllocations = 0;
+};
+
+size_t countLinks(Network const& network)
+{
+    size_t links = 0;
+    for (const auto& page : network.getPages()) {
+        links += page.getLinks().size();
+    }
+    return links;
+}
+
+// Resets peak resident set size, so it can be measured for every run separately.
+void resetPeakRss()
+{
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+}
+
+// Peak resident set size in kilobytes.
+long getPeakRssKb()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stol(line.substr(6));
+        }
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+struct Options {
+    uint32_t scale = 16;
+    uint32_t edgeFactor = 8;
+    uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t repetitions = 3;
+    uint32_t idPages = 200;
+    uint32_t batchNetworks = 2000;
+    uint32_t batchPages = 400;
+    bool reproducible = false;
+    std::vector<std::string> graphs = { "rmat", "ba", "er", "dangling" };
+    double alpha = 0.85;
+    uint32_t iterations = 100;
+    double tolerance = 1e-10;
+};
+
+Options parseOptions(int argc, char* argv[])
+{
+    Options options;
+    for (int arg = 1; arg < argc; ++arg) {
+        std::string option(argv[arg]);
+        size_t equalPos = option.find('=');
+        std::string name = option.substr(0, equalPos);
+        std::string value = equalPos == std::string::npos ? "" : option.substr(equalPos + 1);
+
+        if (name == "--scale") {
+            options.scale = std::stoul(value);
+        } else if (name == "--edge-factor") {
+            options.edgeFactor = std::stoul(value);
+        } else if (name == "--max-threads") {
+            options.maxThreads = std::stoul(value);
+        } else if (name == "--repetitions") {
+            options.repetitions = std::stoul(value);
+        } else if (name == "--id-pages") {
+            options.idPages = std::stoul(value);
+        } else if (name == "--batch-networks") {
+            options.batchNetworks = std::stoul(value);
+        } else if (name == "--batch-pages") {
+            options.batchPages = std::stoul(value);
+        } else if (name == "--reproducible") {
+            options.reproducible = true;
+        } else if (name == "--graphs") {
+            options.graphs.clear();
+            std::stringstream graphs(value);
+            std::string graph;
+            while (std::getline(graphs, graph, ',')) {
+                options.graphs.push_back(graph);
+            }
+        } else {
+            std::cerr << "Unknown option " << option << std::endl;
+            exit(1);
+        }
+    }
+    return options;
+}
+
+Network generateNetwork(const std::string& graph,
+    IdGenerator const& generator,
+    uint32_t size,
+    uint32_t edgeFactor)
+{
+    SyntheticNetworkGenerator networkGenerator(size);
+    if (graph == "rmat") {
+        uint32_t scale = 0;
+        while ((2u << scale) <= size) {
+            scale++;
+        }
+        return networkGenerator.generateRmat(generator, scale, edgeFactor);
+    } else if (graph == "ba") {
+        return networkGenerator.generateBarabasiAlbert(generator, size, edgeFactor);
+    } else if (graph == "er") {
+        return networkGenerator.generateErdosRenyi(generator, size, edgeFactor);
+    } else if (graph == "dangling") {
+        return networkGenerator.generateManyDangling(generator, size, edgeFactor);
+    }
+    std::cerr << "Unknown graph " << graph << std::endl;
+    exit(1);
+}
+
+// Runs computer and prints the best of repetitions.
+template <typename Computer>
+void benchmarkComputer(Computer& computer,
+    const std::string& experiment,
+    const std::string& graph,
+    uint32_t threads,
+    Network const& network,
+    const Options& options)
+{
+    IterationCounter counter;
+    computer.setObserver(&counter);
+    computer.setReproducible(options.reproducible);
+
+    double bestSeconds = 0;
+    uint32_t iterations = 0;
+    long peakRssKb = 0;
+    for (uint32_t repetition = 0; repetition < options.repetitions; ++repetition) {
+        counter = IterationCounter();
+        resetPeakRss();
+
+        auto start = std::chrono::steady_clock::now();
+        computer.computeForNetwork(network, options.alpha, options.iterations, options.tolerance);
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        peakRssKb = std::max(peakRssKb, getPeakRssKb());
+        if (repetition == 0 || seconds.count() < bestSeconds) {
+            bestSeconds = seconds.count();
+            iterations = counter.iterations;
+        }
+        if (counter.iterationAllocations != 0) {
+            std::cerr << computer.getName() << " allocated heap memory "
+                      << counter.iterationAllocations << " times in "
+                      << counter.iterations - 1 << " iterations" << std::endl;
+            exit(1);
+        }
+    }
+    computer.setObserver(nullptr);
+
+    size_t links = countLinks(network);
+    std::cout << "{\"benchmark\":\"computer\""
+              << ",\"experiment\":\"" << experiment << "\""
+              << ",\"computer\":\"" << computer.getName() << "\""
+              << ",\"reproducible\":" << (options.reproducible ? "true" : "false")
+              << ",\"graph\":\"" << graph << "\""
+              << ",\"threads\":" << threads
+              << ",\"pages\":" << network.getSize()
+              << ",\"links\":" << links
+              << ",\"iterations\":" << iterations
+              << ",\"seconds\":" << bestSeconds
+              << ",\"edgesPerSecondPerIteration\":"
+              << (bestSeconds > 0 ? links * static_cast<double>(iterations) / bestSeconds : 0)
+              << ",\"peakRssKb\":" << peakRssKb << "}" << std::endl;
+}
+
+// Runs sharded computer and prints the best of repetitions. Workers are processes,
+// so peak resident set size is that of the caller, which does not build the graph.
+void benchmarkSharded(const std::string& graph,
+    uint32_t shards,
+    Network const& network,
+    const Options& options)
+{
+    ShardedPageRankComputer computer(shards);
+    double bestSeconds = 0;
+    long peakRssKb = 0;
+    for (uint32_t repetition = 0; repetition < options.repetitions; ++repetition) {
+        resetPeakRss();
+
+        auto start = std::chrono::steady_clock::now();
+        computer.computeForNetwork(network, options.alpha, options.iterations, options.tolerance);
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        peakRssKb = std::max(peakRssKb, getPeakRssKb());
+        if (repetition == 0 || seconds.count() < bestSeconds) {
+            bestSeconds = seconds.count();
+        }
+    }
+
+    const ShardedPageRankStatistics& statistics = computer.getShardedStatistics();
+    std::cout << "{\"benchmark\":\"computer\""
+              << ",\"experiment\":\"sharded\""
+              << ",\"computer\":\"" << computer.getName() << "\""
+              << ",\"graph\":\"" << graph << "\""
+              << ",\"threads\":" << statistics.workers
+              << ",\"pages\":" << network.getSize()
+              << ",\"links\":" << countLinks(network)
+              << ",\"boundaryPages\":" << statistics.boundaryPages
+              << ",\"seconds\":" << bestSeconds
+              << ",\"peakRssKb\":" << peakRssKb << "}" << std::endl;
+}
+
+// Compares computing small networks one after another with computing them as a batch.
+void benchmarkBatch(IdGenerator const& generator, const std::string& graph, const Options& options)
+{
+    std::vector<Network> networks;
+    std::mt19937 random(options.batchNetworks);
+    std::uniform_int_distribution<uint32_t> size(1, options.batchPages);
+    for (uint32_t network = 0; network < options.batchNetworks; ++network) {
+        networks.push_back(generateNetwork(graph, generator, size(random), options.edgeFactor));
+    }
+
+    auto printResult = [&](const std::string& experiment, uint32_t threads, double seconds) {
+        std::cout << "{\"benchmark\":\"batch\""
+                  << ",\"experiment\":\"" << experiment << "\""
+                  << ",\"graph\":\"" << graph << "\""
+                  << ",\"threads\":" << threads
+                  << ",\"networks\":" << networks.size()
+                  << ",\"seconds\":" << seconds
+                  << ",\"networksPerSecond\":" << (seconds > 0 ? networks.size() / seconds : 0)
+                  << "}" << std::endl;
+    };
+
+    // Differences of small networks with cycles may shrink only by alpha every iteration,
+    // so they get more iterations than big ones need.
+    uint32_t iterations = std::max<uint32_t>(options.iterations, 1000);
+
+    for (uint32_t threads = 1; threads <= options.maxThreads; ++threads) {
+        MultiThreadedPageRankComputer computer(threads);
+
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& network : networks) {
+            computer.computeForNetwork(network, options.alpha, iterations, options.tolerance);
+        }
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        printResult("perNetwork", threads, seconds.count());
+
+        computer.computeForNetworks(networks, options.alpha, iterations, options.tolerance);
+        printResult("batch", threads, computer.getBatchStatistics().seconds);
+    }
+}
+
+void benchmarkIdGenerator(IdGenerator const& generator,
+    const std::string& name,
+    const Options& options)
+{
+    for (size_t contentSize : { 64, 4096, 65536 }) {
+        std::string content(contentSize, 'x');
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t page = 0; page < options.idPages; ++page) {
+            content[page % contentSize] = 'a' + page % 26;
+            generator.generateId(content);
+        }
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        std::cout << "{\"benchmark\":\"idGenerator\""
+                  << ",\"generator\":\"" << name << "\""
+                  << ",\"contentBytes\":" << contentSize
+                  << ",\"pages\":" << options.idPages
+                  << ",\"seconds\":" << seconds.count()
+                  << ",\"idsPerSecond\":" << options.idPages / seconds.count()
+                  << "}" << std::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options = parseOptions(argc, argv);
+    ContentIdGenerator generator;
+    uint32_t size = 1u << options.scale;
+
+    for (const auto& graph : options.graphs) {
+        Network network = generateNetwork(graph, generator, size, options.edgeFactor);
+
+        SingleThreadedPageRankComputer singleThreaded;
+        benchmarkComputer(singleThreaded, "single", graph, 1, network, options);
+
+        // Strong scaling: the same network for every number of threads.
+        for (uint32_t threads = 1; threads <= options.maxThreads; ++threads) {
+            MultiThreadedPageRankComputer multiThreaded(threads);
+            benchmarkComputer(multiThreaded, "strong", graph, threads, network, options);
+        }
+
+        // Shards are processes, the reproducible mode does not apply to them.
+        if (!options.reproducible) {
+            for (uint32_t shards = 1; shards <= options.maxThreads; ++shards) {
+                benchmarkSharded(graph, shards, network, options);
+            }
+        }
+
+        // Weak scaling: network grows with number of threads.
+        for (uint32_t threads = 1; threads <= options.maxThreads; ++threads) {
+            Network scaledNetwork = generateNetwork(graph, generator, size * threads,
+                options.edgeFactor);
+            MultiThreadedPageRankComputer multiThreaded(threads);
+            benchmarkComputer(multiThreaded, "weak", graph, threads, scaledNetwork, options);
+        }
+
+        benchmarkBatch(generator, graph, options);
+    }
+
+    benchmarkIdGenerator(Sha256IdGenerator(), "Sha256IdGenerator", options);
+
+    // The first run fills the cache, the second one finds every id in it.
+    std::string cachePath = "pageRankBenchmark.idcache";
+    std::remove(cachePath.c_str());
+    for (const char* name : { "CachedSha256IdGenerator[cold]", "CachedSha256IdGenerator[warm]" }) {
+        CachedSha256IdGenerator cachedGenerator(cachePath);
+        benchmarkIdGenerator(cachedGenerator, name, options);
+    }
+    std::remove(cachePath.c_str());
+    return 0;
+}
@@ -0,0 +1,278 @@
+#ifndef SRC_PAGERANKCHECKPOINT_HPP_
+#define SRC_PAGERANKCHECKPOINT_HPP_
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "immutable/network.hpp"
+#include "immutable/pageIdAndRank.hpp"
+
+#include "pageRankGraph.hpp"
+
+struct PageRankCheckpointOptions {
+    // Empty path disables checkpoints.
+    std::string path;
+    // Checkpoint is written after every interval iterations.
+    uint32_t interval = 10;
+};
+
+struct PageRankCheckpointStatistics {
+    uint32_t written = 0;
+    uint32_t failed = 0;
+    // Iterations done before the last written checkpoint.
+    uint32_t lastIteration = 0;
+    // Iterations done before the checkpoint computation resumed from.
+    uint32_t resumedIteration = 0;
+};
+
+// Writes ranks and iteration counter to a file in a background thread.
+// Ranks are copied to a pending buffer, while the writer thread writes the other one,
+// so iterations do not wait for the file. A pending checkpoint not yet taken by the writer
+// is replaced by a newer one.
+// File is replaced atomically, so it always contains a whole checkpoint.
+// Without a path all methods return immediately.
+// Checkpoint is restored only by a computation of the same network, with the same alpha
+// and mode of summing ranks, see setReproducible of computers.
+class PageRankCheckpointer {
+public:
+    PageRankCheckpointer(const PageRankCheckpointOptions& optionsArg,
+        Network const& network,
+        const PageRankGraph& graph,
+        double alpha,
+        bool reproducible)
+        : options(optionsArg)
+        , size(graph.getSize())
+        , fingerprint(0)
+    {
+        if (isEnabled()) {
+            fingerprint = computeFingerprint(network, graph, alpha, reproducible);
+            pendingRanks.resize(size);
+            writtenRanks.resize(size);
+            writer = std::thread { [this] { writeCheckpoints(); } };
+        }
+    }
+
+    PageRankCheckpointer(const PageRankCheckpointer&) = delete;
+    PageRankCheckpointer& operator=(const PageRankCheckpointer&) = delete;
+
+    ~PageRankCheckpointer()
+    {
+        finish();
+    }
+
+    bool isEnabled() const
+    {
+        return !options.path.empty();
+    }
+
+    // Reads ranks of the checkpoint if it was written for the same computation
+    // after at most maxIterations iterations, so a computation limited to them passed it.
+    // Saves difference of ranks in the iteration before the checkpoint to difference,
+    // so a computation converged at the checkpoint is not continued.
+    // Returns number of iterations done before the checkpoint, or 0 if there is none.
+    uint32_t restore(PageRank* ranks, uint32_t maxIterations, double& difference)
+    {
+        if (!isEnabled()) {
+            return 0;
+        }
+
+        int fd = open(options.path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return 0;
+        }
+        Header header;
+        bool valid = readAll(fd, &header, sizeof(header))
+            && header.magic == magic
+            && header.size == size
+            && header.fingerprint == fingerprint
+            && header.iterations <= maxIterations;
+        std::vector<PageRank> restoredRanks(size);
+        valid = valid && readAll(fd, restoredRanks.data(), size * sizeof(PageRank));
+        close(fd);
+
+        if (!valid) {
+            return 0;
+        }
+        std::memcpy(ranks, restoredRanks.data(), size * sizeof(PageRank));
+        difference = header.difference;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        statistics.resumedIteration = header.iterations;
+        return header.iterations;
+    }
+
+    // Called after every iteration with ranks and difference of that iteration.
+    void endIteration(uint32_t iterationsDone, const PageRank* ranks, double difference)
+    {
+        if (!isEnabled() || options.interval == 0 || iterationsDone % options.interval != 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::memcpy(pendingRanks.data(), ranks, size * sizeof(PageRank));
+            pendingIteration = iterationsDone;
+            pendingDifference = difference;
+            hasPending = true;
+        }
+        changed.notify_all();
+    }
+
+    // Waits until the pending checkpoint is written and stops the writer.
+    void finish()
+    {
+        if (writer.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            changed.notify_all();
+            writer.join();
+        }
+    }
+
+    PageRankCheckpointStatistics getStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return statistics;
+    }
+
+private:
+    static constexpr uint64_t magic = 0x33746e696f706b63ull; // "ckpoint3" read as little endian
+
+    struct Header {
+        uint64_t magic;
+        uint64_t size;
+        uint64_t fingerprint;
+        uint32_t iterations;
+        uint32_t padding;
+        double difference;
+    };
+
+    // FNV-1a of alpha, mode, page ids in graph order and links of the graph,
+    // identifies the prepared network. Ids are hashed with their lengths,
+    // so different lists of ids cannot give the same bytes.
+    static uint64_t computeFingerprint(Network const& network,
+        const PageRankGraph& graph,
+        double alpha,
+        bool reproducible)
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        auto add = [&hash](const void* data, size_t bytes) {
+            const uint8_t* byte = static_cast<const uint8_t*>(data);
+            for (size_t index = 0; index < bytes; ++index) {
+                hash = (hash ^ byte[index]) * 0x100000001b3ull;
+            }
+        };
+        add(&alpha, sizeof(alpha));
+        uint8_t mode = reproducible;
+        add(&mode, sizeof(mode));
+        for (const auto& page : network.getPages()) {
+            const std::string& id = page.getId().id;
+            uint64_t length = id.size();
+            add(&length, sizeof(length));
+            add(id.data(), id.size());
+        }
+        add(graph.getNumLinks().data(), graph.getNumLinks().size() * sizeof(uint32_t));
+        add(graph.getInEdgesBegin().data(), graph.getInEdgesBegin().size() * sizeof(size_t));
+        add(graph.getInEdges().data(), graph.getInEdges().size() * sizeof(uint32_t));
+        return hash;
+    }
+
+    static bool readAll(int fd, void* data, size_t bytes)
+    {
+        char* position = static_cast<char*>(data);
+        while (bytes > 0) {
+            ssize_t result = read(fd, position, bytes);
+            if (result <= 0) {
+                return false;
+            }
+            position += result;
+            bytes -= result;
+        }
+        return true;
+    }
+
+    static bool writeAll(int fd, const void* data, size_t bytes)
+    {
+        const char* position = static_cast<const char*>(data);
+        while (bytes > 0) {
+            ssize_t result = write(fd, position, bytes);
+            if (result <= 0) {
+                return false;
+            }
+            position += result;
+            bytes -= result;
+        }
+        return true;
+    }
+
+    // Written to a temporary file, which replaces the checkpoint after it is synced.
+    bool writeFile(uint32_t iterations, double difference) const
+    {
+        std::string temporaryPath = options.path + ".tmp";
+        int fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            return false;
+        }
+        Header header { magic, size, fingerprint, iterations, 0, difference };
+        bool written = writeAll(fd, &header, sizeof(header))
+            && writeAll(fd, writtenRanks.data(), size * sizeof(PageRank))
+            && fsync(fd) == 0;
+        written = close(fd) == 0 && written;
+        return written && rename(temporaryPath.c_str(), options.path.c_str()) == 0;
+    }
+
+    void writeCheckpoints()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this] { return hasPending || stopping; });
+            if (!hasPending) {
+                return;
+            }
+            std::swap(pendingRanks, writtenRanks);
+            uint32_t iterations = pendingIteration;
+            double difference = pendingDifference;
+            hasPending = false;
+
+            lock.unlock();
+            bool written = writeFile(iterations, difference);
+            lock.lock();
+
+            if (written) {
+                statistics.written++;
+                statistics.lastIteration = iterations;
+            } else {
+                statistics.failed++;
+            }
+        }
+    }
+
+    PageRankCheckpointOptions options;
+    uint64_t size;
+    uint64_t fingerprint;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::thread writer;
+
+    // Guarded by mutex, writtenRanks is used only by the writer thread.
+    std::vector<PageRank> pendingRanks;
+    std::vector<PageRank> writtenRanks;
+    uint32_t pendingIteration = 0;
+    double pendingDifference = 0;
+    bool hasPending = false;
+    bool stopping = false;
+    PageRankCheckpointStatistics statistics;
+};
+
+#endif /* SRC_PAGERANKCHECKPOINT_HPP_ */
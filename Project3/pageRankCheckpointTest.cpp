@@ -0,0 +1,176 @@
+// Test that computations resumed from checkpoints return the same ranks
+// as uninterrupted ones, also when the checkpoint was written at the iteration
+// which converged. Checkpoints of other networks with the same links, or of the other
+// reproducible mode, are not used. Fails with exit code 1.
+//
+// Usage: pageRankCheckpointTest [checkpoint path]
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "immutable/network.hpp"
+#include "immutable/pageIdAndRank.hpp"
+
+#include "multiThreadedPageRankComputer.hpp"
+#include "pageRankCheckpoint.hpp"
+#include "singleThreadedPageRankComputer.hpp"
+
+namespace {
+
+const uint32_t PAGES = 3000;
+const uint32_t MAX_LINKS = 6;
+const double ALPHA = 0.85;
+const uint32_t ITERATIONS = 1000;
+const double TOLERANCE = 1e-12;
+
+class ContentIdGenerator : public IdGenerator {
+public:
+    PageId generateId(std::string const& content) const override
+    {
+        return PageId(content);
+    }
+};
+
+// Networks generated with different prefixes differ only in ids of their pages.
+Network generateNetwork(IdGenerator const& generator, const std::string& prefix = "page")
+{
+    Network network(generator);
+    std::mt19937 random(PAGES);
+    for (uint32_t page = 0; page < PAGES; ++page) {
+        Page newPage(prefix + std::to_string(page));
+        uint32_t links = random() % MAX_LINKS;
+        for (uint32_t link = 0; link < links; ++link) {
+            newPage.addLink(generator.generateId(prefix + std::to_string(random() % PAGES)));
+        }
+        network.addPage(newPage);
+    }
+    return network;
+}
+
+bool sameRanks(const std::vector<PageIdAndRank>& first, const std::vector<PageIdAndRank>& second)
+{
+    if (first.size() != second.size()) {
+        return false;
+    }
+    for (size_t page = 0; page < first.size(); ++page) {
+        if (!(first[page].id == second[page].id)
+            || std::memcmp(&first[page].rank, &second[page].rank, sizeof(PageRank)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Computer>
+bool check(Computer& computer, Network const& network, const std::string& path, uint32_t interval)
+{
+    std::string name = computer.getName() + " with interval " + std::to_string(interval);
+    unlink(path.c_str());
+    computer.setCheckpointing(PageRankCheckpointOptions());
+    auto uninterrupted = computer.computeForNetwork(network, ALPHA, ITERATIONS, TOLERANCE);
+
+    PageRankCheckpointOptions options;
+    options.path = path;
+    options.interval = interval;
+    computer.setCheckpointing(options);
+    computer.computeForNetwork(network, ALPHA, ITERATIONS, TOLERANCE);
+    uint32_t lastIteration = computer.getCheckpointStatistics().lastIteration;
+
+    bool passed = true;
+    auto resumed = computer.resumeForNetwork(network, ALPHA, ITERATIONS, TOLERANCE);
+    if (computer.getCheckpointStatistics().resumedIteration != lastIteration
+        || !sameRanks(uninterrupted, resumed)) {
+        std::cerr << name << " resumed from iteration " << lastIteration
+                  << " differs from uninterrupted computation" << std::endl;
+        passed = false;
+    }
+
+    // Computation limited to iterations done before the converged checkpoint
+    // has no iteration left, it returns ranks of the checkpoint.
+    if (interval == 1) {
+        resumed = computer.resumeForNetwork(network, ALPHA, lastIteration, TOLERANCE);
+        if (!sameRanks(uninterrupted, resumed)) {
+            std::cerr << name << " limited to " << lastIteration
+                      << " iterations differs from uninterrupted computation" << std::endl;
+            passed = false;
+        }
+    }
+
+    computer.setCheckpointing(PageRankCheckpointOptions());
+    unlink(path.c_str());
+    return passed;
+}
+
+// Checkpoint written by computer is not restored for the other network or in the other mode.
+template <typename Computer>
+bool checkOtherComputation(Computer& computer,
+    Network const& network,
+    Network const& otherNetwork,
+    const std::string& path)
+{
+    unlink(path.c_str());
+    PageRankCheckpointOptions options;
+    options.path = path;
+    options.interval = 1;
+    computer.setCheckpointing(options);
+    computer.computeForNetwork(network, ALPHA, ITERATIONS, TOLERANCE);
+
+    bool passed = true;
+    computer.resumeForNetwork(otherNetwork, ALPHA, ITERATIONS, TOLERANCE);
+    if (computer.getCheckpointStatistics().resumedIteration != 0) {
+        std::cerr << computer.getName() << " resumed from checkpoint of network with other ids"
+                  << std::endl;
+        passed = false;
+    }
+
+    // The previous computation replaced the checkpoint.
+    computer.computeForNetwork(network, ALPHA, ITERATIONS, TOLERANCE);
+    computer.setReproducible(true);
+    computer.resumeForNetwork(network, ALPHA, ITERATIONS, TOLERANCE);
+    if (computer.getCheckpointStatistics().resumedIteration != 0) {
+        std::cerr << computer.getName() << " resumed in reproducible mode from checkpoint"
+                  << " of the other mode" << std::endl;
+        passed = false;
+    }
+
+    computer.setReproducible(false);
+    computer.setCheckpointing(PageRankCheckpointOptions());
+    unlink(path.c_str());
+    return passed;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::string path = argc > 1 ? argv[1] : "pageRankCheckpointTest.ckpt";
+    ContentIdGenerator generator;
+    Network network = generateNetwork(generator);
+
+    bool passed = true;
+    // With interval 1 the checkpoint is written at the iteration which converged.
+    for (uint32_t interval : { 1u, 7u }) {
+        SingleThreadedPageRankComputer single;
+        passed = check(single, network, path, interval) && passed;
+
+        for (bool numaAware : { false, true }) {
+            MultiThreadedPageRankComputer multi(3, numaAware);
+            passed = check(multi, network, path, interval) && passed;
+        }
+    }
+
+    Network otherNetwork = generateNetwork(generator, "other");
+    SingleThreadedPageRankComputer single;
+    passed = checkOtherComputation(single, network, otherNetwork, path) && passed;
+    MultiThreadedPageRankComputer multi(3);
+    passed = checkOtherComputation(multi, network, otherNetwork, path) && passed;
+
+    std::cout << (passed ? "ALL TESTS PASSED" : "TESTS FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
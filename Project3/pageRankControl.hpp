@@ -0,0 +1,217 @@
+#ifndef SRC_PAGERANKCONTROL_HPP_
+#define SRC_PAGERANKCONTROL_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "immutable/common.hpp"
+#include "immutable/pageIdAndRank.hpp"
+
+enum class PageRankStatus {
+    converged,
+    cancelled,
+    deadlineExceeded,
+    // All iterations were done without reaching tolerance.
+    notConverged
+};
+
+struct PageRankProgress {
+    uint32_t iterations = 0;
+    // Sum of absolute differences between ranks of the last two iterations.
+    double residual = 0;
+    std::chrono::steady_clock::duration elapsed { 0 };
+};
+
+struct PageRankAsyncOptions {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    // Called after every iteration by a thread of the computation.
+    std::function<void(const PageRankProgress&)> onProgress;
+};
+
+// Decides between iterations whether computation should go on.
+// Computers given a control return ranks of the last iteration instead of failing
+// when they stop before convergence. They check it also while preparing the computation,
+// every setupCheckPages pages, and return no ranks if they stop before the first iteration.
+class PageRankControl {
+public:
+    static constexpr size_t setupCheckPages = 1024;
+
+    PageRankControl(const PageRankAsyncOptions& optionsArg)
+        : options(optionsArg)
+        , start(std::chrono::steady_clock::now())
+        , cancelled(false)
+        , status(PageRankStatus::notConverged)
+    {
+    }
+
+    // May be called from any thread, takes effect after the current iteration.
+    void cancel()
+    {
+        cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    // Called by computers after every iteration. Returns true if computation should stop.
+    bool endIteration(uint32_t iterations, double residual, bool converged)
+    {
+        auto now = std::chrono::steady_clock::now();
+        progress.iterations = iterations;
+        progress.residual = residual;
+        progress.elapsed = now - start;
+        if (options.onProgress) {
+            options.onProgress(progress);
+        }
+
+        if (converged) {
+            status = PageRankStatus::converged;
+            return true;
+        }
+        return stopAt(now);
+    }
+
+    // May be called by any thread preparing the computation.
+    bool isStopRequested() const
+    {
+        return cancelled.load(std::memory_order_relaxed)
+            || std::chrono::steady_clock::now() >= options.deadline;
+    }
+
+    // Called by computers between phases of preparing the computation.
+    // Returns true if computation should stop before the first iteration.
+    bool endSetupPhase()
+    {
+        auto now = std::chrono::steady_clock::now();
+        progress.elapsed = now - start;
+        return stopAt(now);
+    }
+
+    PageRankStatus getStatus() const
+    {
+        return status;
+    }
+
+    const PageRankProgress& getProgress() const
+    {
+        return progress;
+    }
+
+private:
+    bool stopAt(std::chrono::steady_clock::time_point now)
+    {
+        if (cancelled.load(std::memory_order_relaxed)) {
+            status = PageRankStatus::cancelled;
+        } else if (now >= options.deadline) {
+            status = PageRankStatus::deadlineExceeded;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    PageRankAsyncOptions options;
+    std::chrono::steady_clock::time_point start;
+    std::atomic<bool> cancelled;
+    PageRankStatus status;
+    PageRankProgress progress;
+};
+
+struct PageRankAsyncResult {
+    PageRankStatus status;
+    uint32_t iterations;
+    double residual;
+    // Ranks of the last iteration, final only if status is converged.
+    // Empty if computation stopped before the first iteration.
+    std::vector<PageIdAndRank> ranks;
+};
+
+// Computers write their statistics during computations, so they run one computation at a time.
+// Guard marks computer as computing and fails if it already is.
+class PageRankComputationGuard {
+public:
+    PageRankComputationGuard(std::atomic<bool>& computingArg)
+        : computing(computingArg)
+    {
+        ASSERT(!computing.exchange(true, std::memory_order_acquire),
+            "Computer runs another computation, computations of a computer cannot overlap");
+    }
+
+    PageRankComputationGuard(const PageRankComputationGuard&) = delete;
+    PageRankComputationGuard& operator=(const PageRankComputationGuard&) = delete;
+
+    ~PageRankComputationGuard()
+    {
+        computing.store(false, std::memory_order_release);
+    }
+
+private:
+    std::atomic<bool>& computing;
+};
+
+// Future of a computation running in its own thread.
+// Network and computer have to outlive the handle. The computer cannot start
+// another computation and its statistics cannot be read until the computation ends.
+// Destroying a handle that was not waited for cancels its computation.
+class PageRankHandle {
+public:
+    // Computation gets the control it has to pass to the computer.
+    template <typename Computation>
+    PageRankHandle(Computation computation, const PageRankAsyncOptions& options)
+        : control(std::make_shared<PageRankControl>(options))
+    {
+        std::shared_ptr<PageRankControl> computationControl = control;
+        result = std::async(std::launch::async, [computation, computationControl]() {
+            std::vector<PageIdAndRank> ranks = computation(*computationControl);
+            const PageRankProgress& progress = computationControl->getProgress();
+            return PageRankAsyncResult { computationControl->getStatus(),
+                progress.iterations, progress.residual, std::move(ranks) };
+        });
+    }
+
+    PageRankHandle(PageRankHandle&&) = default;
+    PageRankHandle& operator=(PageRankHandle&&) = delete;
+
+    ~PageRankHandle()
+    {
+        if (result.valid()) {
+            control->cancel();
+            result.wait();
+        }
+    }
+
+    void cancel()
+    {
+        control->cancel();
+    }
+
+    bool isReady() const
+    {
+        return waitFor(std::chrono::seconds(0));
+    }
+
+    void wait() const
+    {
+        result.wait();
+    }
+
+    // Returns true if the computation finished within timeout.
+    template <typename Rep, typename Period>
+    bool waitFor(const std::chrono::duration<Rep, Period>& timeout) const
+    {
+        return result.wait_for(timeout) == std::future_status::ready;
+    }
+
+    // Waits for the result. Can be called only once.
+    PageRankAsyncResult get()
+    {
+        return result.get();
+    }
+
+private:
+    std::shared_ptr<PageRankControl> control;
+    std::future<PageRankAsyncResult> result;
+};
+
+#endif /* SRC_PAGERANKCONTROL_HPP_ */
@@ -0,0 +1,182 @@
+#ifndef SRC_PAGERANKGRAPH_HPP_
+#define SRC_PAGERANKGRAPH_HPP_
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "immutable/network.hpp"
+
+#include "binaryPageId.hpp"
+#include "hugePageArena.hpp"
+
+// Index based representation of a network.
+// Pages are numbered by their position in network.getPages().
+// Page ids have to be generated before the graph is created.
+// All the memory of the graph comes from the arena.
+class PageRankGraph {
+public:
+    PageRankGraph(Network const& network, HugePageArena& arena)
+        : size(network.getSize())
+        , numLinks(network.getSize(), arena)
+        , danglingNodes(arena)
+        , inEdgesBegin(network.getSize() + 1, 0, arena)
+        , inEdges(arena)
+        , binaryIds(arena)
+    {
+        size_t numberOfLinks = 0;
+        size_t numberOfDanglingNodes = 0;
+        for (const auto& page : network.getPages()) {
+            numberOfLinks += page.getLinks().size();
+            numberOfDanglingNodes += page.getLinks().size() == 0;
+        }
+        danglingNodes.reserve(numberOfDanglingNodes);
+
+        // Target of every link in network order.
+        // Links to pages outside of the network have no target,
+        // but they still count as links of their source.
+        std::vector<uint32_t> linkTargets;
+        linkTargets.reserve(numberOfLinks);
+        if (!findLinkTargetsByBinaryId(network, arena, linkTargets)) {
+            findLinkTargetsById(network, arena, linkTargets);
+        }
+
+        size_t link = 0;
+        for (uint32_t index = 0; index < size; ++index) {
+            const Page& page = network.getPages()[index];
+            numLinks[index] = page.getLinks().size();
+            if (page.getLinks().size() == 0) {
+                danglingNodes.push_back(index);
+            }
+
+            for (size_t i = 0; i < page.getLinks().size(); ++i, ++link) {
+                if (linkTargets[link] != noTarget) {
+                    inEdgesBegin[linkTargets[link] + 1]++;
+                }
+            }
+        }
+
+        for (size_t index = 0; index < size; ++index) {
+            inEdgesBegin[index + 1] += inEdgesBegin[index];
+        }
+
+        // In-edges of every page are ordered by their source page.
+        inEdges.resize(inEdgesBegin[size]);
+        std::vector<size_t> nextInEdge(inEdgesBegin.begin(), inEdgesBegin.end() - 1);
+        link = 0;
+        for (uint32_t index = 0; index < size; ++index) {
+            for (size_t i = 0; i < numLinks[index]; ++i, ++link) {
+                if (linkTargets[link] != noTarget) {
+                    inEdges[nextInEdge[linkTargets[link]]++] = index;
+                }
+            }
+        }
+    }
+
+    size_t getSize() const
+    {
+        return size;
+    }
+
+    // Number of outgoing links of every page.
+    const ArenaVector<uint32_t>& getNumLinks() const
+    {
+        return numLinks;
+    }
+
+    // Pages without outgoing links.
+    const ArenaVector<uint32_t>& getDanglingNodes() const
+    {
+        return danglingNodes;
+    }
+
+    // Sources of links to page are
+    // inEdges[inEdgesBegin[page]] ... inEdges[inEdgesBegin[page + 1] - 1].
+    const ArenaVector<size_t>& getInEdgesBegin() const
+    {
+        return inEdgesBegin;
+    }
+
+    const ArenaVector<uint32_t>& getInEdges() const
+    {
+        return inEdges;
+    }
+
+    // Binary forms of page ids if all of them are SHA-256 hex digests, otherwise empty.
+    const ArenaVector<BinaryPageId>& getBinaryIds() const
+    {
+        return binaryIds;
+    }
+
+private:
+    static constexpr uint32_t noTarget = UINT32_MAX;
+
+    // Used when ids are SHA-256 hex digests, so their binary forms are the keys.
+    // Binary ids are kept for results.
+    // Returns false, without finding any targets, if some page id is not a hex digest.
+    bool findLinkTargetsByBinaryId(Network const& network,
+        HugePageArena& arena,
+        std::vector<uint32_t>& linkTargets)
+    {
+        binaryIds.resize(size);
+        for (uint32_t index = 0; index < size; ++index) {
+            if (!BinaryPageId::fromHex(network.getPages()[index].getId().id, binaryIds[index])) {
+                binaryIds.clear();
+                binaryIds.shrink_to_fit();
+                return false;
+            }
+        }
+
+        // Keys refer to binary ids of the graph, so ids are not copied.
+        std::unordered_map<std::reference_wrapper<const BinaryPageId>,
+            uint32_t,
+            BinaryPageIdHash,
+            std::equal_to<BinaryPageId>,
+            ArenaAllocator<std::pair<const std::reference_wrapper<const BinaryPageId>, uint32_t>>>
+            pageIndex(size, BinaryPageIdHash(), std::equal_to<BinaryPageId>(), arena);
+        for (uint32_t index = 0; index < size; ++index) {
+            pageIndex.emplace(std::cref(binaryIds[index]), index);
+        }
+
+        for (const auto& page : network.getPages()) {
+            for (const auto& link : page.getLinks()) {
+                BinaryPageId id;
+                auto iter = BinaryPageId::fromHex(link.id, id) ? pageIndex.find(id) : pageIndex.end();
+                linkTargets.push_back(iter != pageIndex.end() ? iter->second : noTarget);
+            }
+        }
+        return true;
+    }
+
+    void findLinkTargetsById(Network const& network,
+        HugePageArena& arena,
+        std::vector<uint32_t>& linkTargets) const
+    {
+        // Keys refer to ids of network pages, so ids are not copied.
+        std::unordered_map<std::reference_wrapper<const PageId>,
+            uint32_t,
+            PageIdHash,
+            std::equal_to<PageId>,
+            ArenaAllocator<std::pair<const std::reference_wrapper<const PageId>, uint32_t>>>
+            pageIndex(size, PageIdHash(), std::equal_to<PageId>(), arena);
+        for (uint32_t index = 0; index < size; ++index) {
+            pageIndex.emplace(std::cref(network.getPages()[index].getId()), index);
+        }
+
+        for (const auto& page : network.getPages()) {
+            for (const auto& link : page.getLinks()) {
+                auto iter = pageIndex.find(link);
+                linkTargets.push_back(iter != pageIndex.end() ? iter->second : noTarget);
+            }
+        }
+    }
+
+    size_t size;
+    ArenaVector<uint32_t> numLinks;
+    ArenaVector<uint32_t> danglingNodes;
+    ArenaVector<size_t> inEdgesBegin;
+    ArenaVector<uint32_t> inEdges;
+    ArenaVector<BinaryPageId> binaryIds;
+};
+
+#endif /* SRC_PAGERANKGRAPH_HPP_ */
@@ -0,0 +1,174 @@
+#ifndef SRC_PAGERANKOBSERVER_HPP_
+#define SRC_PAGERANKOBSERVER_HPP_
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Statistics of a single iteration of page rank computation.
+struct PageRankIterationStatistics {
+    uint32_t iteration = 0;
+    std::chrono::steady_clock::time_point start;
+
+    // Sum of absolute differences between ranks of this and previous iteration.
+    double difference = 0;
+    // Sum of ranks of dangling nodes before the iteration.
+    double danglingNodesRankSum = 0;
+
+    // Wall time of phases. Computers that update ranks and calculate
+    // difference in one pass report the whole pass as update time.
+    std::chrono::nanoseconds danglingTime { 0 };
+    std::chrono::nanoseconds updateTime { 0 };
+    std::chrono::nanoseconds differenceTime { 0 };
+
+    // Time threads spent working in this iteration. Index is a thread number.
+    std::vector<std::chrono::nanoseconds> threadBusyTimes;
+
+    // Bytes allocated for graph and ranks of the computation.
+    size_t bytesAllocated = 0;
+};
+
+// Receives progress of page rank computation.
+// Methods are never called concurrently during a single computation.
+class PageRankObserver {
+public:
+    virtual ~PageRankObserver() {}
+
+    virtual void onStart(const std::string& computerName, size_t networkSize)
+    {
+        (void)computerName;
+        (void)networkSize;
+    }
+
+    virtual void onIteration(const PageRankIterationStatistics& statistics) = 0;
+
+    // Called also when computation did not converge, before it fails.
+    virtual void onFinish(uint32_t iterations, bool converged)
+    {
+        (void)iterations;
+        (void)converged;
+    }
+};
+
+// Gathers iteration statistics for computers.
+// Without an observer all methods return immediately,
+// so computations without observers do not measure anything.
+class PageRankIterationRecorder {
+public:
+    enum class Phase {
+        dangling,
+        update,
+        difference
+    };
+
+    PageRankIterationRecorder(PageRankObserver* observerArg,
+        const std::string& computerName,
+        size_t networkSize,
+        uint32_t numThreads)
+        : observer(observerArg)
+    {
+        if (observer != nullptr) {
+            statistics.threadBusyTimes.resize(numThreads);
+            observer->onStart(computerName, networkSize);
+        }
+    }
+
+    bool isEnabled() const
+    {
+        return observer != nullptr;
+    }
+
+    void startIteration(uint32_t iteration)
+    {
+        if (observer != nullptr) {
+            statistics.iteration = iteration;
+            statistics.start = std::chrono::steady_clock::now();
+            statistics.danglingTime = statistics.updateTime = statistics.differenceTime
+                = std::chrono::nanoseconds(0);
+            for (auto& busyTime : statistics.threadBusyTimes) {
+                busyTime = std::chrono::nanoseconds(0);
+            }
+            phaseStart = statistics.start;
+        }
+    }
+
+    // Phase lasted since the previous phase ended or the iteration started.
+    void endPhase(Phase phase)
+    {
+        if (observer != nullptr) {
+            auto now = std::chrono::steady_clock::now();
+            switch (phase) {
+            case Phase::dangling:
+                statistics.danglingTime += now - phaseStart;
+                break;
+            case Phase::update:
+                statistics.updateTime += now - phaseStart;
+                break;
+            case Phase::difference:
+                statistics.differenceTime += now - phaseStart;
+                break;
+            }
+            phaseStart = now;
+        }
+    }
+
+    // Busy time of thread threadNumber, or nullptr without an observer.
+    std::chrono::nanoseconds* getThreadBusyTime(uint32_t threadNumber)
+    {
+        return observer != nullptr ? &statistics.threadBusyTimes.at(threadNumber) : nullptr;
+    }
+
+    void endIteration(double difference, double danglingNodesRankSum, size_t bytesAllocated)
+    {
+        if (observer != nullptr) {
+            statistics.difference = difference;
+            statistics.danglingNodesRankSum = danglingNodesRankSum;
+            statistics.bytesAllocated = bytesAllocated;
+            observer->onIteration(statistics);
+        }
+    }
+
+    void finish(uint32_t iterations, bool converged)
+    {
+        if (observer != nullptr) {
+            observer->onFinish(iterations, converged);
+        }
+    }
+
+private:
+    PageRankObserver* observer;
+    PageRankIterationStatistics statistics;
+    std::chrono::steady_clock::time_point phaseStart;
+};
+
+// Adds time between its creation and destruction or stop() to busyTime,
+// unless busyTime is null.
+class ThreadBusyTimer {
+public:
+    ThreadBusyTimer(std::chrono::nanoseconds* busyTimeArg)
+        : busyTime(busyTimeArg)
+    {
+        if (busyTime != nullptr) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ThreadBusyTimer()
+    {
+        stop();
+    }
+
+    void stop()
+    {
+        if (busyTime != nullptr) {
+            *busyTime += std::chrono::steady_clock::now() - start;
+            busyTime = nullptr;
+        }
+    }
+
+private:
+    std::chrono::nanoseconds* busyTime;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif /* SRC_PAGERANKOBSERVER_HPP_ */
@@ -0,0 +1,195 @@
+#ifndef SRC_PAGERANKRESULTS_HPP_
+#define SRC_PAGERANKRESULTS_HPP_
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "immutable/network.hpp"
+#include "immutable/pageIdAndRank.hpp"
+
+#include "binaryPageId.hpp"
+#include "pageRankGraph.hpp"
+
+// Builds results of computers from ranks indexed by position of pages in network
+// and from the graph of the network, if the computer built one.
+// Pages with equal ranks are ordered by their position in network.
+class PageRankResults {
+public:
+    static std::vector<PageIdAndRank> collectAll(Network const& network,
+        const PageRankGraph*,
+        const PageRank* ranks)
+    {
+        std::vector<PageIdAndRank> result;
+        result.reserve(network.getSize());
+        for (size_t page = 0; page < network.getSize(); ++page) {
+            result.push_back(PageIdAndRank(network.getPages()[page].getId(), ranks[page]));
+        }
+
+        ASSERT(result.size() == network.getSize(),
+            "Invalid result size=" << result.size()
+                                   << ", for network" << network);
+        return result;
+    }
+
+    // Binary ids are taken from the graph, which converted hex ids while it was built.
+    // Only ids which are not hex digests, or ids of networks without graph, are converted here.
+    static std::vector<BinaryPageIdAndRank> collectAllBinary(Network const& network,
+        const PageRankGraph* graph,
+        const PageRank* ranks)
+    {
+        std::vector<BinaryPageIdAndRank> result(network.getSize());
+        bool binaryIds = graph != nullptr && !graph->getBinaryIds().empty();
+        for (size_t page = 0; page < network.getSize(); ++page) {
+            result[page].id = !binaryIds
+                ? BinaryPageId::fromPageId(network.getPages()[page].getId())
+                : graph->getBinaryIds()[page];
+            result[page].rank = ranks[page];
+        }
+        return result;
+    }
+
+    // Returns k pages with the highest ranks, starting from the highest.
+    // Each thread selects k best pages of its part of the network,
+    // then k best of the candidates are chosen.
+    static std::vector<PageIdAndRank> selectTopK(Network const& network,
+        const PageRank* ranks,
+        size_t k,
+        uint32_t numThreads)
+    {
+        const size_t size = network.getSize();
+        k = std::min(k, size);
+        HigherRank higherRank { ranks };
+
+        std::vector<std::vector<uint32_t>> threadCandidates(getNumberOfThreadsUsed(size, numThreads));
+        runInThreads(threadCandidates.size(), [&](uint32_t threadNumber) {
+            std::vector<uint32_t>& candidates = threadCandidates[threadNumber];
+            for (size_t page = getThreadFirstPage(size, threadCandidates.size(), threadNumber);
+                 page < getThreadFirstPage(size, threadCandidates.size(), threadNumber + 1);
+                 ++page) {
+                candidates.push_back(page);
+            }
+
+            if (candidates.size() > k) {
+                std::nth_element(candidates.begin(), candidates.begin() + k, candidates.end(),
+                    higherRank);
+                candidates.resize(k);
+            }
+        });
+
+        std::vector<uint32_t> candidates;
+        for (const auto& threadCandidate : threadCandidates) {
+            candidates.insert(candidates.end(), threadCandidate.begin(), threadCandidate.end());
+        }
+        std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end(),
+            higherRank);
+
+        std::vector<PageIdAndRank> result;
+        result.reserve(k);
+        for (size_t index = 0; index < k; ++index) {
+            uint32_t page = candidates[index];
+            result.push_back(PageIdAndRank(network.getPages()[page].getId(), ranks[page]));
+        }
+        return result;
+    }
+
+    // Writes "<page id> <rank>" lines starting from the highest rank.
+    // Ranks are written with all significant digits, so different ranks stay different.
+    // Only page numbers are sorted, ids are written straight from network pages.
+    // Each thread sorts its part of the network, parts are merged while writing.
+    static void writeSorted(Network const& network,
+        const PageRank* ranks,
+        std::ostream& output,
+        uint32_t numThreads)
+    {
+        const size_t size = network.getSize();
+        const uint32_t numberOfThreadsUsed = getNumberOfThreadsUsed(size, numThreads);
+        HigherRank higherRank { ranks };
+
+        std::vector<uint32_t> pages(size);
+        runInThreads(numberOfThreadsUsed, [&](uint32_t threadNumber) {
+            size_t firstPage = getThreadFirstPage(size, numberOfThreadsUsed, threadNumber);
+            size_t endPage = getThreadFirstPage(size, numberOfThreadsUsed, threadNumber + 1);
+            for (size_t page = firstPage; page < endPage; ++page) {
+                pages[page] = page;
+            }
+            std::sort(pages.begin() + firstPage, pages.begin() + endPage, higherRank);
+        });
+
+        // Next unwritten position of every part.
+        std::vector<size_t> positions;
+        std::vector<size_t> ends;
+        auto lowerInOutput = [&](uint32_t part, uint32_t otherPart) {
+            return higherRank(pages[positions[otherPart]], pages[positions[part]]);
+        };
+        std::priority_queue<uint32_t, std::vector<uint32_t>, decltype(lowerInOutput)>
+            parts(lowerInOutput);
+        for (uint32_t threadNumber = 0; threadNumber < numberOfThreadsUsed; ++threadNumber) {
+            positions.push_back(getThreadFirstPage(size, numberOfThreadsUsed, threadNumber));
+            ends.push_back(getThreadFirstPage(size, numberOfThreadsUsed, threadNumber + 1));
+            if (positions.back() < ends.back()) {
+                parts.push(threadNumber);
+            }
+        }
+
+        std::streamsize precision = output.precision(std::numeric_limits<PageRank>::max_digits10);
+        while (!parts.empty()) {
+            uint32_t part = parts.top();
+            parts.pop();
+
+            uint32_t page = pages[positions[part]++];
+            output << network.getPages()[page].getId() << ' ' << ranks[page] << '\n';
+
+            if (positions[part] < ends[part]) {
+                parts.push(part);
+            }
+        }
+        output.precision(precision);
+        output.flush();
+    }
+
+private:
+    struct HigherRank {
+        const PageRank* ranks;
+
+        bool operator()(uint32_t page, uint32_t otherPage) const
+        {
+            return ranks[page] > ranks[otherPage]
+                || (ranks[page] == ranks[otherPage] && page < otherPage);
+        }
+    };
+
+    static uint32_t getNumberOfThreadsUsed(size_t size, uint32_t numThreads)
+    {
+        return std::max<size_t>(1, std::min<size_t>(size, numThreads));
+    }
+
+    static size_t getThreadFirstPage(size_t size, size_t numberOfThreads, size_t threadNumber)
+    {
+        return size * threadNumber / numberOfThreads;
+    }
+
+    // Runs function for every thread number, in the calling thread if there is only one.
+    template <typename Function>
+    static void runInThreads(uint32_t numberOfThreads, Function function)
+    {
+        if (numberOfThreads == 1) {
+            function(0);
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        for (uint32_t threadNumber = 0; threadNumber < numberOfThreads; ++threadNumber) {
+            threads.push_back(std::thread { function, threadNumber });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+};
+
+#endif /* SRC_PAGERANKRESULTS_HPP_ */
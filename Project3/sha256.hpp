@@ -0,0 +1,152 @@
+#ifndef SRC_SHA256_HPP_
+#define SRC_SHA256_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+// SHA-256 as specified in FIPS 180-4.
+class Sha256 {
+public:
+    using Digest = std::array<uint8_t, 32>;
+
+    static Digest digest(const void* data, size_t size)
+    {
+        Sha256 sha256;
+        sha256.update(data, size);
+        return sha256.finish();
+    }
+
+    Sha256()
+        : state { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 }
+        , bufferSize(0)
+        , totalSize(0)
+    {
+    }
+
+    void update(const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        totalSize += size;
+
+        if (bufferSize > 0) {
+            size_t copied = std::min(size, blockSize - bufferSize);
+            std::memcpy(buffer.data() + bufferSize, bytes, copied);
+            bufferSize += copied;
+            bytes += copied;
+            size -= copied;
+            if (bufferSize < blockSize) {
+                return;
+            }
+            processBlock(buffer.data());
+            bufferSize = 0;
+        }
+
+        for (; size >= blockSize; bytes += blockSize, size -= blockSize) {
+            processBlock(bytes);
+        }
+
+        std::memcpy(buffer.data(), bytes, size);
+        bufferSize = size;
+    }
+
+    Digest finish()
+    {
+        uint64_t totalBits = totalSize * 8;
+
+        buffer[bufferSize++] = 0x80;
+        if (bufferSize > blockSize - 8) {
+            std::memset(buffer.data() + bufferSize, 0, blockSize - bufferSize);
+            processBlock(buffer.data());
+            bufferSize = 0;
+        }
+        std::memset(buffer.data() + bufferSize, 0, blockSize - 8 - bufferSize);
+        for (size_t byte = 0; byte < 8; ++byte) {
+            buffer[blockSize - 1 - byte] = static_cast<uint8_t>(totalBits >> (8 * byte));
+        }
+        processBlock(buffer.data());
+
+        Digest digest;
+        for (size_t word = 0; word < 8; ++word) {
+            for (size_t byte = 0; byte < 4; ++byte) {
+                digest[4 * word + byte] = static_cast<uint8_t>(state[word] >> (24 - 8 * byte));
+            }
+        }
+        return digest;
+    }
+
+private:
+    static constexpr size_t blockSize = 64;
+
+    static uint32_t rotateRight(uint32_t value, uint32_t bits)
+    {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    void processBlock(const uint8_t* block)
+    {
+        static constexpr uint32_t roundConstants[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+
+        uint32_t schedule[64];
+        for (size_t word = 0; word < 16; ++word) {
+            schedule[word] = static_cast<uint32_t>(block[4 * word]) << 24
+                | static_cast<uint32_t>(block[4 * word + 1]) << 16
+                | static_cast<uint32_t>(block[4 * word + 2]) << 8
+                | static_cast<uint32_t>(block[4 * word + 3]);
+        }
+        for (size_t word = 16; word < 64; ++word) {
+            uint32_t s0 = rotateRight(schedule[word - 15], 7) ^ rotateRight(schedule[word - 15], 18)
+                ^ (schedule[word - 15] >> 3);
+            uint32_t s1 = rotateRight(schedule[word - 2], 17) ^ rotateRight(schedule[word - 2], 19)
+                ^ (schedule[word - 2] >> 10);
+            schedule[word] = schedule[word - 16] + s0 + schedule[word - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (size_t round = 0; round < 64; ++round) {
+            uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+            uint32_t choice = (e & f) ^ (~e & g);
+            uint32_t temp1 = h + s1 + choice + roundConstants[round] + schedule[round];
+            uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+            uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t temp2 = s0 + majority;
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + temp1;
+            d = c;
+            c = b;
+            b = a;
+            a = temp1 + temp2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+
+    std::array<uint32_t, 8> state;
+    std::array<uint8_t, blockSize> buffer;
+    size_t bufferSize;
+    uint64_t totalSize;
+};
+
+#endif /* SRC_SHA256_HPP_ */
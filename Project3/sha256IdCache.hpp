@@ -0,0 +1,389 @@
+#ifndef SRC_SHA256IDCACHE_HPP_
+#define SRC_SHA256IDCACHE_HPP_
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "immutable/common.hpp"
+#include "immutable/idGenerator.hpp"
+#include "immutable/pageId.hpp"
+
+#include "binaryPageId.hpp"
+#include "sha256IdGenerator.hpp"
+
+// Cheap identification of page content: its length and a 128-bit hash.
+struct ContentFingerprint {
+    uint64_t length;
+    uint64_t hash[2];
+
+    // Non-cryptographic hash processing 16 bytes per step.
+    static ContentFingerprint of(const char* data, size_t length)
+    {
+        uint64_t first = 0x9e3779b97f4a7c15ull ^ length;
+        uint64_t second = 0xc2b2ae3d27d4eb4full;
+
+        size_t position = 0;
+        for (; position + 16 <= length; position += 16) {
+            first = mix(first ^ read(data + position), 0xa0761d6478bd642full);
+            second = mix(second ^ read(data + position + 8), 0xe7037ed1a0b428dbull);
+            first += second;
+        }
+
+        uint64_t tail[2] = { 0, 0 };
+        std::memcpy(tail, data + position, length - position);
+        first = mix(first ^ tail[0], 0x8ebc6af09c88c6e3ull);
+        second = mix(second ^ tail[1] ^ first, 0x589965cc75374cc3ull);
+
+        ContentFingerprint fingerprint;
+        fingerprint.length = length;
+        fingerprint.hash[0] = finalize(first ^ second);
+        fingerprint.hash[1] = finalize(second + first);
+        return fingerprint;
+    }
+
+    bool operator==(const ContentFingerprint& other) const
+    {
+        return length == other.length && hash[0] == other.hash[0] && hash[1] == other.hash[1];
+    }
+
+private:
+    static uint64_t read(const char* data)
+    {
+        uint64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    // Folds 128-bit product.
+    static uint64_t mix(uint64_t value, uint64_t multiplier)
+    {
+        unsigned __int128 product = static_cast<unsigned __int128>(value) * multiplier;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+    }
+
+    static uint64_t finalize(uint64_t value)
+    {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ull;
+        value ^= value >> 33;
+        return value;
+    }
+};
+
+// Memory mapped file mapping content fingerprints to SHA-256 ids.
+// Open addressing table, lookups are lock-free and inserts take a slot with compare and swap,
+// so generator threads and processes can share one file.
+// Every opening of the file starts a new generation, slots remember the last one which used them.
+// When all slots near a fingerprint are taken, the one used longest ago is overwritten,
+// unless all of them were used in this generation, then the id is not cached.
+// Readers copy a slot and check that its version did not change meanwhile.
+// Every process using the file holds a shared flock on it. The file is created
+// or cleared only under an exclusive one, given when no other process uses it,
+// so no process has it mapped while it is truncated. Slots left being written
+// by a process which died are emptied then.
+class Sha256IdCache {
+public:
+    // Capacity is rounded up to a power of two. A file with different capacity is recreated,
+    // it is an error if another process uses it.
+    Sha256IdCache(const std::string& path, size_t capacityArg = 1 << 20)
+        : capacity(roundUpToPowerOfTwo(capacityArg))
+        , fileSize(sizeof(Header) + capacity * sizeof(Slot))
+    {
+        fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        ASSERT(fd != -1, "open error " << path);
+
+        // A process initializing the file holds the exclusive lock until it is done,
+        // so others wait for the shared lock.
+        bool exclusive = flock(fd, LOCK_EX | LOCK_NB) == 0;
+        ASSERT(exclusive || errno == EWOULDBLOCK, "flock error");
+        if (!exclusive) {
+            ASSERT(flock(fd, LOCK_SH) == 0, "flock error");
+        }
+
+        bool valid = hasValidHeader();
+        if (!valid) {
+            ASSERT(exclusive, "cache file " << path << " is used with a different capacity");
+            // Shrinking to zero and growing again clears all slots.
+            ASSERT(ftruncate(fd, 0) == 0 && ftruncate(fd, fileSize) == 0, "ftruncate error");
+        }
+
+        void* mapping = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ASSERT(mapping != MAP_FAILED, "mmap error");
+
+        header = static_cast<Header*>(mapping);
+        slots = reinterpret_cast<Slot*>(header + 1);
+
+        if (!valid) {
+            header->magic = magic;
+            header->capacity = capacity;
+        } else if (exclusive) {
+            releaseAbandonedSlots();
+        }
+        generation = header->generation.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (exclusive) {
+            // Other processes can use the file from now on.
+            ASSERT(flock(fd, LOCK_SH) == 0, "flock error");
+        }
+    }
+
+    Sha256IdCache(const Sha256IdCache&) = delete;
+    Sha256IdCache& operator=(const Sha256IdCache&) = delete;
+
+    ~Sha256IdCache()
+    {
+        munmap(header, fileSize);
+        // Releases the shared lock.
+        close(fd);
+    }
+
+    bool find(const ContentFingerprint& fingerprint, BinaryPageId& id)
+    {
+        for (size_t probe = 0; probe < maxProbes; ++probe) {
+            Slot& slot = slots[(fingerprint.hash[0] + probe) & (capacity - 1)];
+            uint32_t state = slot.state.load(std::memory_order_acquire);
+            if (kind(state) == empty) {
+                return false;
+            }
+
+            Entry entry;
+            if (readSlot(slot, state, entry) && entry.fingerprint == fingerprint) {
+                id = entry.id;
+                touch(slot);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void insert(const ContentFingerprint& fingerprint, const BinaryPageId& id)
+    {
+        Slot* oldest = nullptr;
+        uint32_t oldestState = 0;
+        uint32_t oldestAge = 0;
+        for (size_t probe = 0; probe < maxProbes; ++probe) {
+            Slot& slot = slots[(fingerprint.hash[0] + probe) & (capacity - 1)];
+            uint32_t state = slot.state.load(std::memory_order_acquire);
+            if (kind(state) == empty && claimSlot(slot, state)) {
+                writeSlot(slot, state, fingerprint, id);
+                return;
+            }
+
+            Entry entry;
+            if (!readSlot(slot, state, entry)) {
+                continue;
+            }
+            if (entry.fingerprint == fingerprint) {
+                touch(slot);
+                return;
+            }
+            uint32_t age = generation - slot.generation.load(std::memory_order_relaxed);
+            if (age > oldestAge) {
+                oldest = &slot;
+                oldestState = state;
+                oldestAge = age;
+            }
+        }
+
+        // Slot fails to be claimed if it was changed since it was read.
+        if (oldest != nullptr && claimSlot(*oldest, oldestState)) {
+            writeSlot(*oldest, oldestState, fingerprint, id);
+        }
+    }
+
+private:
+    static constexpr uint64_t magic = 0x3230656863616469ull; // "idache02" read as little endian
+    static constexpr size_t maxProbes = 16;
+
+    // Slot state holds its kind in the lowest bits and the number of its writes above them.
+    static constexpr uint32_t empty = 0;
+    static constexpr uint32_t writing = 1;
+    static constexpr uint32_t ready = 2;
+    static constexpr uint32_t kindBits = 2;
+
+    struct alignas(64) Header {
+        uint64_t magic;
+        uint64_t capacity;
+        std::atomic<uint32_t> generation;
+    };
+
+    struct Entry {
+        ContentFingerprint fingerprint;
+        BinaryPageId id;
+    };
+
+    // A slot is a single cache line.
+    struct alignas(64) Slot {
+        std::atomic<uint32_t> state;
+        // Generation which used the slot last, only chooses slots to overwrite.
+        std::atomic<uint32_t> generation;
+        ContentFingerprint fingerprint;
+        BinaryPageId id;
+    };
+
+    static_assert(sizeof(Slot) == 64, "Slot has to fill a cache line");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free,
+        "Slot state has to be lock free to be shared through a file");
+
+    static uint32_t kind(uint32_t state)
+    {
+        return state & ((1u << kindBits) - 1);
+    }
+
+    static uint32_t withKind(uint32_t state, uint32_t newKind)
+    {
+        return (state >> kindBits) << kindBits | newKind;
+    }
+
+    static uint32_t nextVersion(uint32_t state, uint32_t newKind)
+    {
+        return withKind(state + (1u << kindBits), newKind);
+    }
+
+    // Copies entry of a ready slot, returns false if the slot is not ready
+    // or was overwritten while it was copied.
+    static bool readSlot(const Slot& slot, uint32_t state, Entry& entry)
+    {
+        if (kind(state) != ready) {
+            return false;
+        }
+        std::memcpy(&entry.fingerprint, &slot.fingerprint, sizeof(entry.fingerprint));
+        std::memcpy(&entry.id, &slot.id, sizeof(entry.id));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.state.load(std::memory_order_relaxed) == state;
+    }
+
+    // Changes slot from state to writing, fails if the slot is not in state any more.
+    static bool claimSlot(Slot& slot, uint32_t& state)
+    {
+        uint32_t newState = nextVersion(state, writing);
+        if (!slot.state.compare_exchange_strong(state, newState, std::memory_order_acquire)) {
+            return false;
+        }
+        state = newState;
+        // Writes of the entry are not visible before the state.
+        std::atomic_thread_fence(std::memory_order_release);
+        return true;
+    }
+
+    void writeSlot(Slot& slot, uint32_t state, const ContentFingerprint& fingerprint,
+        const BinaryPageId& id)
+    {
+        std::memcpy(&slot.fingerprint, &fingerprint, sizeof(fingerprint));
+        std::memcpy(&slot.id, &id, sizeof(id));
+        slot.generation.store(generation, std::memory_order_relaxed);
+        slot.state.store(withKind(state, ready), std::memory_order_release);
+    }
+
+    // Slot is written only when its generation changes, so repeated hits do not dirty the file.
+    void touch(Slot& slot)
+    {
+        if (slot.generation.load(std::memory_order_relaxed) != generation) {
+            slot.generation.store(generation, std::memory_order_relaxed);
+        }
+    }
+
+    // Called with the exclusive lock, so no process is writing a slot.
+    void releaseAbandonedSlots()
+    {
+        for (size_t index = 0; index < capacity; ++index) {
+            uint32_t state = slots[index].state.load(std::memory_order_relaxed);
+            if (kind(state) == writing) {
+                slots[index].state.store(nextVersion(state, empty), std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns true if the file has the size and header of a cache of this capacity.
+    bool hasValidHeader() const
+    {
+        struct stat fileStat;
+        ASSERT(fstat(fd, &fileStat) == 0, "fstat error");
+        if (static_cast<size_t>(fileStat.st_size) != fileSize) {
+            return false;
+        }
+        Header fileHeader;
+        return pread(fd, &fileHeader, sizeof(fileHeader), 0) == sizeof(fileHeader)
+            && fileHeader.magic == magic
+            && fileHeader.capacity == capacity;
+    }
+
+    static size_t roundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 1;
+        while (result < value) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    size_t capacity;
+    size_t fileSize;
+    int fd;
+    uint32_t generation;
+    Header* header;
+    Slot* slots;
+};
+
+// Sha256IdGenerator that remembers ids of contents in a Sha256IdCache file,
+// so only contents not seen in previous runs are hashed with SHA-256.
+class CachedSha256IdGenerator : public IdGenerator {
+public:
+    CachedSha256IdGenerator(const std::string& cachePath, size_t cacheCapacity = 1 << 20)
+        : cache(cachePath, cacheCapacity)
+        , hits(0)
+        , misses(0)
+    {
+    }
+
+    PageId generateId(std::string const& content) const override
+    {
+        return generateBinaryId(content).toPageId();
+    }
+
+    BinaryPageId generateBinaryId(std::string const& content) const
+    {
+        // Same content as hashed by Sha256IdGenerator.
+        ContentFingerprint fingerprint
+            = ContentFingerprint::of(content.c_str(), std::strlen(content.c_str()));
+
+        BinaryPageId id;
+        if (cache.find(fingerprint, id)) {
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return id;
+        }
+
+        misses.fetch_add(1, std::memory_order_relaxed);
+        id = generator.generateBinaryId(content);
+        cache.insert(fingerprint, id);
+        return id;
+    }
+
+    uint64_t getHits() const
+    {
+        return hits.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getMisses() const
+    {
+        return misses.load(std::memory_order_relaxed);
+    }
+
+private:
+    Sha256IdGenerator generator;
+    mutable Sha256IdCache cache;
+    mutable std::atomic<uint64_t> hits;
+    mutable std::atomic<uint64_t> misses;
+};
+
+#endif /* SRC_SHA256IDCACHE_HPP_ */
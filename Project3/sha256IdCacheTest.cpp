@@ -0,0 +1,113 @@
+// Test of the persistent id cache reopened in later runs: new contents are cached
+// in a cache filled by a previous run, and slots left being written by a process
+// which died are reused. Fails with exit code 1.
+//
+// Usage: sha256IdCacheTest [cache path]
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "binaryPageId.hpp"
+#include "sha256IdCache.hpp"
+#include "sha256IdGenerator.hpp"
+
+namespace {
+
+const size_t CAPACITY = 64;
+const uint32_t OLD_CONTENTS = 4 * CAPACITY;
+const uint32_t NEW_CONTENTS = CAPACITY / 2;
+
+// Layout of the cache file: a header and slots, each of them a cache line
+// starting with its state.
+const size_t SLOT_BYTES = 64;
+const uint32_t WRITING_STATE = 1;
+
+std::string content(const std::string& prefix, uint32_t number)
+{
+    return prefix + " content " + std::to_string(number);
+}
+
+// Generates ids of contents with a cache opened at path, returns number of cache hits.
+// Fails if some id differs from the uncached one.
+uint64_t generateIds(const std::string& path, size_t capacity, const std::string& prefix,
+    uint32_t contents, bool& passed)
+{
+    Sha256IdGenerator generator;
+    CachedSha256IdGenerator cachedGenerator(path, capacity);
+    for (uint32_t number = 0; number < contents; ++number) {
+        std::string text = content(prefix, number);
+        if (!(cachedGenerator.generateBinaryId(text) == generator.generateBinaryId(text))) {
+            std::cerr << "wrong id of " << text << std::endl;
+            passed = false;
+        }
+    }
+    return cachedGenerator.getHits();
+}
+
+bool fullCacheTakesNewContents(const std::string& path)
+{
+    unlink(path.c_str());
+    bool passed = true;
+    generateIds(path, CAPACITY, "old", OLD_CONTENTS, passed);
+
+    // Contents of the previous run take all slots, they are overwritten by the new ones.
+    if (generateIds(path, CAPACITY, "new", NEW_CONTENTS, passed) != 0) {
+        std::cerr << "new contents found in cache" << std::endl;
+        passed = false;
+    }
+    uint64_t hits = generateIds(path, CAPACITY, "new", NEW_CONTENTS, passed);
+    if (hits != NEW_CONTENTS) {
+        std::cerr << "only " << hits << " of " << NEW_CONTENTS
+                  << " new contents cached in full cache" << std::endl;
+        passed = false;
+    }
+
+    unlink(path.c_str());
+    return passed;
+}
+
+bool abandonedSlotsAreReused(const std::string& path)
+{
+    unlink(path.c_str());
+    bool passed = true;
+    // A cache smaller than the probe window, so every content may use every slot.
+    const size_t capacity = 8;
+    generateIds(path, capacity, "first", 0, passed);
+
+    // As if processes died while writing every slot.
+    int fd = open(path.c_str(), O_RDWR);
+    for (size_t slot = 1; slot <= capacity; ++slot) {
+        if (pwrite(fd, &WRITING_STATE, sizeof(WRITING_STATE), slot * SLOT_BYTES)
+            != sizeof(WRITING_STATE)) {
+            std::cerr << "pwrite error" << std::endl;
+            passed = false;
+        }
+    }
+    close(fd);
+
+    generateIds(path, capacity, "second", 1, passed);
+    if (generateIds(path, capacity, "second", 1, passed) != 1) {
+        std::cerr << "abandoned slots not reused" << std::endl;
+        passed = false;
+    }
+
+    unlink(path.c_str());
+    return passed;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::string path = argc > 1 ? argv[1] : "sha256IdCacheTest.cache";
+
+    bool passed = fullCacheTakesNewContents(path);
+    passed = abandonedSlotsAreReused(path) && passed;
+
+    std::cout << (passed ? "ALL TESTS PASSED" : "TESTS FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,665 @@
+#ifndef SRC_SHARDEDPAGERANKCOMPUTER_HPP_
+#define SRC_SHARDEDPAGERANKCOMPUTER_HPP_
+
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <functional>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "immutable/network.hpp"
+#include "immutable/pageIdAndRank.hpp"
+#include "immutable/pageRankComputer.hpp"
+
+#include "pageRankControl.hpp"
+#include "pageRankResults.hpp"
+#include "threadsInfo.hpp"
+
+struct ShardedPageRankStatistics {
+    uint32_t workers = 0;
+    // Workers started again after they died.
+    uint32_t restarts = 0;
+    // Pages whose ranks workers got from other workers, summed over workers.
+    size_t boundaryPages = 0;
+};
+
+// Computes ranks in worker processes, each of them owning a contiguous range of pages.
+// The caller only generates ids, the graph is never built whole. Every worker reads links
+// of all pages, but finds their targets only among its own pages, so it keeps in-edges
+// and an index of ids of its own pages only.
+// Every worker has a POSIX shared memory segment with ranks of its pages, followed by slots
+// for ranks of other workers' pages it needs: sources of its in-edges and dangling nodes
+// it sums. After every iteration owners of these boundary pages write their ranks there.
+// Workers synchronise twice per iteration on barriers made of per-worker counters.
+// Pages and sums are divided as by MultiThreadedPageRankComputer with numShards threads,
+// so both computers return identical ranks.
+// A phase of an iteration writes only buffers of the next one, so it can be done again.
+// A worker which dies is started again and continues from the last barrier it reached,
+// while other workers wait. After maxRestarts restarts in one computation other workers
+// are stopped, then the computation fails.
+class ShardedPageRankComputer : public PageRankComputer {
+public:
+    ShardedPageRankComputer(uint32_t numShardsArg, uint32_t maxRestartsArg = 3)
+        : numShards(numShardsArg)
+        , maxRestarts(maxRestartsArg) {};
+
+    std::vector<PageIdAndRank> computeForNetwork(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance) const
+    {
+        return computeRanks(network, alpha, iterations, tolerance, PageRankResults::collectAll);
+    }
+
+    std::string getName() const
+    {
+        return "ShardedPageRankComputer[" + std::to_string(numShards) + "]";
+    }
+
+    // Workers of the last computation.
+    // Statistics cannot be read while a computation runs.
+    const ShardedPageRankStatistics& getShardedStatistics() const
+    {
+        ASSERT(!computing.load(std::memory_order_acquire),
+            "Statistics of " << getName() << " read while it computes");
+        return shardedStatistics;
+    }
+
+private:
+    // Exit status of workers stopped because another one failed.
+    static constexpr int stoppedStatus = 2;
+
+    // Barrier counter and partial sums of a single worker, on its own cache line.
+    struct alignas(64) ShardState {
+        // Number of the last barrier the worker reached.
+        std::atomic<uint32_t> barrier { 0 };
+        double danglingNodesRankSum = 0;
+        double difference = 0;
+    };
+
+    struct alignas(64) ControlHeader {
+        std::atomic<uint32_t> stopped { 0 };
+        uint32_t iterationsDone = 0;
+        uint32_t converged = 0;
+    };
+
+    // Mapping of a named POSIX shared memory object.
+    class SharedMemory {
+    public:
+        SharedMemory() = default;
+
+        SharedMemory(SharedMemory&& other)
+            : bytes(other.bytes)
+            , mapping(other.mapping)
+        {
+            other.mapping = nullptr;
+        }
+
+        SharedMemory(const SharedMemory&) = delete;
+        SharedMemory& operator=(const SharedMemory&) = delete;
+
+        ~SharedMemory()
+        {
+            if (mapping != nullptr) {
+                munmap(mapping, bytes);
+            }
+        }
+
+        // An existing object keeps its content.
+        void create(const std::string& name, size_t size)
+        {
+            map(name, O_CREAT, size);
+        }
+
+        void open(const std::string& name)
+        {
+            map(name, 0, 0);
+        }
+
+        void* get() const
+        {
+            return mapping;
+        }
+
+    private:
+        void map(const std::string& name, int flags, size_t size)
+        {
+            int fd = shm_open(name.c_str(), O_RDWR | flags, 0600);
+            ASSERT(fd != -1, "shm_open error " << name);
+            if (flags & O_CREAT) {
+                ASSERT(ftruncate(fd, size) == 0, "ftruncate error");
+            } else {
+                struct stat objectStat;
+                ASSERT(fstat(fd, &objectStat) == 0, "fstat error");
+                size = objectStat.st_size;
+            }
+
+            bytes = size;
+            mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ASSERT(mapping != MAP_FAILED, "mmap error");
+            ASSERT(close(fd) == 0, "close error");
+        }
+
+        size_t bytes = 0;
+        void* mapping = nullptr;
+    };
+
+    // Segment of a worker: numbers of pages of other workers it requested, in increasing order,
+    // then two buffers, for alternate iterations, of ranks of its own pages followed by ranks
+    // of the requested ones.
+    class ShardSegment {
+    public:
+        struct alignas(64) Header {
+            uint64_t ownPages;
+            uint64_t requestedPages;
+        };
+
+        static size_t getBytes(size_t ownPages, size_t requestedPages)
+        {
+            return getRanksOffset(requestedPages)
+                + 2 * (ownPages + requestedPages) * sizeof(PageRank);
+        }
+
+        // Header has to be written before.
+        ShardSegment(void* mapping)
+            : header(static_cast<Header*>(mapping))
+            , requested(reinterpret_cast<uint32_t*>(header + 1))
+        {
+            PageRank* firstRanks = reinterpret_cast<PageRank*>(
+                static_cast<char*>(mapping) + getRanksOffset(header->requestedPages));
+            ranks[0] = firstRanks;
+            ranks[1] = firstRanks + header->ownPages + header->requestedPages;
+        }
+
+        Header* header;
+        uint32_t* requested;
+        PageRank* ranks[2];
+
+    private:
+        static size_t getRanksOffset(size_t requestedPages)
+        {
+            size_t offset = sizeof(Header) + requestedPages * sizeof(uint32_t);
+            return (offset + alignof(Header) - 1) / alignof(Header) * alignof(Header);
+        }
+    };
+
+    // Everything workers get from the caller.
+    struct Job {
+        Network const& network;
+        double alpha;
+        uint32_t iterations;
+        double tolerance;
+        uint32_t numberOfShards;
+        ThreadsInfo pagesShardsInfo;
+        ThreadsInfo danglingShardsInfo;
+        std::string name;
+        ControlHeader* header;
+        ShardState* states;
+
+        std::string getShardName(uint32_t shard) const
+        {
+            return name + "." + std::to_string(shard);
+        }
+    };
+
+    template <typename ResultBuilder>
+    auto computeRanks(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance,
+        ResultBuilder buildResult) const
+        -> decltype(buildResult(network, static_cast<const PageRankGraph*>(nullptr),
+            static_cast<const PageRank*>(nullptr)))
+    {
+        PageRankComputationGuard guard(computing);
+        for (const auto& page : network.getPages()) {
+            page.generateId(network.getGenerator());
+        }
+
+        shardedStatistics = ShardedPageRankStatistics();
+        if (network.getSize() == 0) {
+            return buildResult(network, nullptr, nullptr);
+        }
+
+        size_t numberOfDanglingNodes = 0;
+        for (const auto& page : network.getPages()) {
+            numberOfDanglingNodes += page.getLinks().size() == 0;
+        }
+        ThreadsInfo pagesShardsInfo(network.getSize(), numShards);
+        uint32_t numberOfShardsUsed = pagesShardsInfo.getNumberOfThreadsUsed();
+
+        static std::atomic<uint32_t> computationCounter(0);
+        std::string name = "/pageRank." + std::to_string(getpid())
+            + "." + std::to_string(computationCounter++);
+
+        // Mapping of the control segment stays valid for the caller and forked workers,
+        // so its name is not needed.
+        SharedMemory control;
+        control.create(name, sizeof(ControlHeader) + numberOfShardsUsed * sizeof(ShardState));
+        ASSERT(shm_unlink(name.c_str()) == 0, "shm_unlink error");
+        ControlHeader* header = new (control.get()) ControlHeader();
+        ShardState* states = new (header + 1) ShardState[numberOfShardsUsed];
+
+        Job job { network, alpha, iterations, tolerance, numberOfShardsUsed, pagesShardsInfo,
+            ThreadsInfo(numberOfDanglingNodes, numShards), name, header, states };
+        removeShardSegments(job);
+
+        shardedStatistics.workers = numberOfShardsUsed;
+        std::vector<pid_t> workers(numberOfShardsUsed, 0);
+        for (uint32_t shard = 0; shard < numberOfShardsUsed; ++shard) {
+            workers[shard] = startWorker(job, shard);
+            if (workers[shard] == -1) {
+                workers[shard] = 0;
+                stopWorkers(job, workers);
+                ASSERT(false, "fork error");
+            }
+        }
+        superviseWorkers(job, workers);
+
+        std::vector<PageRank> ranks(network.getSize());
+        for (uint32_t shard = 0; shard < numberOfShardsUsed; ++shard) {
+            SharedMemory memory;
+            memory.open(job.getShardName(shard));
+            ShardSegment segment(memory.get());
+            const PageRank* shardRanks = segment.ranks[header->iterationsDone % 2];
+            std::copy(shardRanks, shardRanks + segment.header->ownPages,
+                ranks.begin() + pagesShardsInfo.getThreadFirstIndex(shard));
+            shardedStatistics.boundaryPages += segment.header->requestedPages;
+        }
+        removeShardSegments(job);
+
+        ASSERT(header->converged,
+            "Not able to find result in iterations=" << iterations);
+        return buildResult(network, nullptr, ranks.data());
+    }
+
+    // Computation of a single shard in a worker process.
+    class ShardWorker {
+    public:
+        ShardWorker(const Job& jobArg, uint32_t shardArg)
+            : job(jobArg)
+            , shard(shardArg)
+            , state(job.states[shard])
+            , firstPage(job.pagesShardsInfo.getThreadFirstIndex(shard))
+            , ownPages(job.pagesShardsInfo.getThreadLastIndex(shard) - firstPage + 1)
+        {
+        }
+
+        void run()
+        {
+            buildInEdges();
+
+            // Worker started again finds its segment and skips phases it has done.
+            uint32_t reached = state.barrier.load(std::memory_order_acquire);
+            memory.create(job.getShardName(shard),
+                ShardSegment::getBytes(ownPages, requested.size()));
+            if (reached == 0) {
+                ShardSegment::Header* header = static_cast<ShardSegment::Header*>(memory.get());
+                header->ownPages = ownPages;
+                header->requestedPages = requested.size();
+            }
+            ShardSegment segment(memory.get());
+            if (reached == 0) {
+                std::copy(requested.begin(), requested.end(), segment.requested);
+            }
+
+            size_t size = job.network.getSize();
+            passBarrier(1, reached, [&]() {
+                std::fill(segment.ranks[0], segment.ranks[0] + ownPages, 1.0 / size);
+            });
+            findRequesters();
+            passBarrier(2, reached, [&]() { sendBoundaryRanks(segment, 0); });
+
+            const double alpha = job.alpha;
+            const double danglingWeight = 1.0 / size;
+            for (uint32_t i = 0; i < job.iterations; ++i) {
+                const PageRank* previousRanks = segment.ranks[i % 2];
+                PageRank* ranks = segment.ranks[(i + 1) % 2];
+                uint32_t danglingBarrier = 3 + 2 * i;
+                uint32_t differenceBarrier = danglingBarrier + 1;
+
+                passBarrier(danglingBarrier, reached, [&]() {
+                    // Shards without dangling nodes add zero, which does not change the sum.
+                    double dangleSum = 0;
+                    for (uint32_t node : danglingNodes) {
+                        dangleSum += previousRanks[node];
+                    }
+                    state.danglingNodesRankSum = dangleSum;
+                });
+
+                // Sums of earlier barriers may be overwritten already, they are read only
+                // if the phase after the barrier is done.
+                double danglingNodesRankSum = 0;
+                if (danglingBarrier >= reached) {
+                    for (uint32_t otherShard = 0; otherShard < job.numberOfShards; ++otherShard) {
+                        danglingNodesRankSum += job.states[otherShard].danglingNodesRankSum;
+                    }
+                }
+                danglingNodesRankSum *= alpha;
+                PageRank pageRankWithoutLinks = danglingNodesRankSum * danglingWeight
+                    + (1.0 - alpha) / size;
+
+                passBarrier(differenceBarrier, reached, [&]() {
+                    double differenceSum = 0;
+                    for (size_t page = 0; page < ownPages; ++page) {
+                        PageRank pageRank = pageRankWithoutLinks;
+                        for (size_t edge = inEdgesBegin[page]; edge < inEdgesBegin[page + 1]; ++edge) {
+                            uint32_t link = inEdges[edge];
+                            pageRank += alpha * previousRanks[link] / numLinks[link];
+                        }
+                        ranks[page] = pageRank;
+                        differenceSum += std::abs(previousRanks[page] - pageRank);
+                    }
+                    state.difference = differenceSum;
+                    sendBoundaryRanks(segment, (i + 1) % 2);
+                });
+
+                if (differenceBarrier < reached) {
+                    continue;
+                }
+                double difference = 0;
+                for (uint32_t otherShard = 0; otherShard < job.numberOfShards; ++otherShard) {
+                    difference += job.states[otherShard].difference;
+                }
+
+                // Every shard sees the same difference, so all of them stop together.
+                if (difference < job.tolerance) {
+                    if (shard == 0) {
+                        job.header->iterationsDone = i + 1;
+                        job.header->converged = 1;
+                    }
+                    return;
+                }
+            }
+        }
+
+    private:
+        // Pages requested by another worker and where their ranks go.
+        struct Requester {
+            SharedMemory memory;
+            ShardSegment segment;
+            size_t firstRequested;
+            size_t endRequested;
+        };
+
+        // In-edges and dangling nodes refer to ranks in the segment,
+        // pages of other workers follow own pages.
+        void buildInEdges()
+        {
+            const auto& pages = job.network.getPages();
+            const size_t endPage = firstPage + ownPages;
+
+            // Keys refer to ids of network pages, so ids are not copied.
+            std::unordered_map<std::reference_wrapper<const PageId>,
+                uint32_t,
+                PageIdHash,
+                std::equal_to<PageId>>
+                pageIndex(ownPages);
+            for (uint32_t page = 0; page < ownPages; ++page) {
+                pageIndex.emplace(std::cref(pages[firstPage + page].getId()), page);
+            }
+
+            // In-edges of every page are ordered by their source page, sources are numbers
+            // of pages in network until requested pages are known.
+            inEdgesBegin.assign(ownPages + 1, 0);
+            for (const auto& page : pages) {
+                for (const auto& link : page.getLinks()) {
+                    auto iter = pageIndex.find(link);
+                    if (iter != pageIndex.end()) {
+                        inEdgesBegin[iter->second + 1]++;
+                    }
+                }
+            }
+            for (size_t page = 0; page < ownPages; ++page) {
+                inEdgesBegin[page + 1] += inEdgesBegin[page];
+            }
+            inEdges.resize(inEdgesBegin[ownPages]);
+            std::vector<size_t> nextInEdge(inEdgesBegin.begin(), inEdgesBegin.end() - 1);
+            for (uint32_t source = 0; source < pages.size(); ++source) {
+                for (const auto& link : pages[source].getLinks()) {
+                    auto iter = pageIndex.find(link);
+                    if (iter != pageIndex.end()) {
+                        inEdges[nextInEdge[iter->second]++] = source;
+                    }
+                }
+            }
+
+            if (shard < job.danglingShardsInfo.getNumberOfThreadsUsed()) {
+                size_t firstNode = job.danglingShardsInfo.getThreadFirstIndex(shard);
+                size_t lastNode = job.danglingShardsInfo.getThreadLastIndex(shard);
+                size_t node = 0;
+                for (uint32_t page = 0; page < pages.size() && node <= lastNode; ++page) {
+                    if (pages[page].getLinks().size() == 0) {
+                        if (node >= firstNode) {
+                            danglingNodes.push_back(page);
+                        }
+                        ++node;
+                    }
+                }
+            }
+
+            for (uint32_t page : inEdges) {
+                if (page < firstPage || page >= endPage) {
+                    requested.push_back(page);
+                }
+            }
+            for (uint32_t page : danglingNodes) {
+                if (page < firstPage || page >= endPage) {
+                    requested.push_back(page);
+                }
+            }
+            std::sort(requested.begin(), requested.end());
+            requested.erase(std::unique(requested.begin(), requested.end()), requested.end());
+
+            auto getRankIndex = [&](uint32_t page) -> uint32_t {
+                if (page >= firstPage && page < endPage) {
+                    return page - firstPage;
+                }
+                return ownPages + (std::lower_bound(requested.begin(), requested.end(), page)
+                    - requested.begin());
+            };
+            for (uint32_t& page : inEdges) {
+                page = getRankIndex(page);
+            }
+            for (uint32_t& page : danglingNodes) {
+                page = getRankIndex(page);
+            }
+
+            numLinks.resize(ownPages + requested.size());
+            for (size_t page = 0; page < ownPages; ++page) {
+                numLinks[page] = pages[firstPage + page].getLinks().size();
+            }
+            for (size_t index = 0; index < requested.size(); ++index) {
+                numLinks[ownPages + index] = pages[requested[index]].getLinks().size();
+            }
+        }
+
+        // Called after the first barrier, when segments of all workers exist.
+        void findRequesters()
+        {
+            uint32_t lastPage = firstPage + ownPages - 1;
+            for (uint32_t otherShard = 0; otherShard < job.numberOfShards; ++otherShard) {
+                if (otherShard == shard) {
+                    continue;
+                }
+                SharedMemory otherMemory;
+                otherMemory.open(job.getShardName(otherShard));
+                ShardSegment otherSegment(otherMemory.get());
+
+                const uint32_t* begin = otherSegment.requested;
+                const uint32_t* end = begin + otherSegment.header->requestedPages;
+                const uint32_t* first = std::lower_bound(begin, end, firstPage);
+                const uint32_t* last = std::upper_bound(first, end, lastPage);
+                if (first != last) {
+                    requesters.push_back(Requester { std::move(otherMemory), otherSegment,
+                        static_cast<size_t>(first - begin), static_cast<size_t>(last - begin) });
+                }
+            }
+        }
+
+        // Writes ranks of own pages in the buffer to segments of workers which requested them.
+        void sendBoundaryRanks(const ShardSegment& segment, int buffer)
+        {
+            const PageRank* ranks = segment.ranks[buffer];
+            for (Requester& requester : requesters) {
+                PageRank* requesterRanks = requester.segment.ranks[buffer]
+                    + requester.segment.header->ownPages;
+                for (size_t index = requester.firstRequested; index < requester.endRequested;
+                     ++index) {
+                    requesterRanks[index] = ranks[requester.segment.requested[index] - firstPage];
+                }
+            }
+        }
+
+        // Phase is done only if the barrier was not reached before.
+        template <typename Phase>
+        void passBarrier(uint32_t barrier, uint32_t reached, Phase phase)
+        {
+            if (barrier > reached) {
+                phase();
+                state.barrier.store(barrier, std::memory_order_release);
+            }
+
+            for (uint32_t otherShard = 0; otherShard < job.numberOfShards; ++otherShard) {
+                uint32_t checks = 0;
+                while (job.states[otherShard].barrier.load(std::memory_order_acquire) < barrier) {
+                    if (job.header->stopped.load(std::memory_order_relaxed)) {
+                        _exit(stoppedStatus);
+                    }
+                    if (++checks < 1000) {
+                        sched_yield();
+                    } else {
+                        usleep(100);
+                    }
+                }
+            }
+        }
+
+        const Job& job;
+        uint32_t shard;
+        ShardState& state;
+        uint32_t firstPage;
+        uint32_t ownPages;
+
+        std::vector<size_t> inEdgesBegin;
+        std::vector<uint32_t> inEdges;
+        std::vector<uint32_t> danglingNodes;
+        std::vector<uint32_t> numLinks;
+        std::vector<uint32_t> requested;
+
+        SharedMemory memory;
+        std::vector<Requester> requesters;
+    };
+
+    static pid_t startWorker(const Job& job, uint32_t shard)
+    {
+        pid_t pid = fork();
+        if (pid == 0) {
+            ShardWorker(job, shard).run();
+            _exit(0);
+        }
+        return pid;
+    }
+
+    // Workers are polled, so children of the caller are not reaped.
+    // Failed workers are started again until restarts run out, then the others are stopped.
+    void superviseWorkers(const Job& job, std::vector<pid_t>& workers) const
+    {
+        size_t running = workers.size();
+        bool failed = false;
+        uint32_t failedShard = 0;
+        int failedStatus = 0;
+
+        useconds_t pollInterval = 50;
+        while (running > 0) {
+            bool exited = false;
+            for (uint32_t shard = 0; shard < workers.size(); ++shard) {
+                if (workers[shard] == 0) {
+                    continue;
+                }
+                int status;
+                pid_t pid = waitpid(workers[shard], &status, WNOHANG);
+                if (pid == 0 || (pid == -1 && errno == EINTR)) {
+                    continue;
+                }
+                ASSERT(pid != -1, "waitpid error");
+                workers[shard] = 0;
+                running--;
+                exited = true;
+
+                if (WIFEXITED(status)
+                    && (WEXITSTATUS(status) == 0 || WEXITSTATUS(status) == stoppedStatus)) {
+                    continue;
+                }
+                if (!failed && shardedStatistics.restarts < maxRestarts) {
+                    shardedStatistics.restarts++;
+                    pid = startWorker(job, shard);
+                    if (pid != -1) {
+                        workers[shard] = pid;
+                        running++;
+                        continue;
+                    }
+                }
+                if (!failed) {
+                    failed = true;
+                    failedShard = shard;
+                    failedStatus = status;
+                    job.header->stopped.store(1, std::memory_order_relaxed);
+                }
+            }
+
+            if (exited) {
+                pollInterval = 50;
+            } else {
+                usleep(pollInterval);
+                pollInterval = std::min<useconds_t>(2 * pollInterval, 1000);
+            }
+        }
+
+        if (failed) {
+            removeShardSegments(job);
+            ASSERT(false, "Shard worker " << failedShard << " failed with status=" << failedStatus
+                                          << " after restarts=" << shardedStatistics.restarts);
+        }
+    }
+
+    // Used when starting workers failed, workers which started are stopped.
+    static void stopWorkers(const Job& job, const std::vector<pid_t>& workers)
+    {
+        job.header->stopped.store(1, std::memory_order_relaxed);
+        for (pid_t worker : workers) {
+            if (worker != 0) {
+                waitpid(worker, nullptr, 0);
+            }
+        }
+        removeShardSegments(job);
+    }
+
+    // Segments of workers outlive them, so they are removed by the caller.
+    static void removeShardSegments(const Job& job)
+    {
+        for (uint32_t shard = 0; shard < job.numberOfShards; ++shard) {
+            shm_unlink(job.getShardName(shard).c_str());
+        }
+    }
+
+    uint32_t numShards;
+    uint32_t maxRestarts;
+
+    mutable std::atomic<bool> computing { false };
+    mutable ShardedPageRankStatistics shardedStatistics;
+};
+
+#endif /* SRC_SHARDEDPAGERANKCOMPUTER_HPP_ */
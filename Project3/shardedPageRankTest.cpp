@@ -0,0 +1,191 @@
+// Test that ShardedPageRankComputer returns the same ranks as MultiThreadedPageRankComputer
+// with as many threads as shards, also when one of its workers is killed and started again.
+// Fails with exit code 1.
+//
+// Usage: shardedPageRankTest
+
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "immutable/network.hpp"
+#include "immutable/pageIdAndRank.hpp"
+
+#include "multiThreadedPageRankComputer.hpp"
+#include "shardedPageRankComputer.hpp"
+
+namespace {
+
+const double ALPHA = 0.85;
+const uint32_t ITERATIONS = 1000;
+const double TOLERANCE = 1e-12;
+const uint32_t KILL_ATTEMPTS = 20;
+
+class ContentIdGenerator : public IdGenerator {
+public:
+    PageId generateId(std::string const& content) const override
+    {
+        return PageId(content);
+    }
+};
+
+Network generateNetwork(IdGenerator const& generator, uint32_t pages, uint32_t maxLinks)
+{
+    Network network(generator);
+    std::mt19937 random(pages);
+    for (uint32_t page = 0; page < pages; ++page) {
+        Page newPage("page" + std::to_string(page));
+        uint32_t links = random() % maxLinks;
+        for (uint32_t link = 0; link < links; ++link) {
+            newPage.addLink(generator.generateId("page" + std::to_string(random() % pages)));
+        }
+        network.addPage(newPage);
+    }
+    return network;
+}
+
+bool sameRanks(const std::vector<PageIdAndRank>& first, const std::vector<PageIdAndRank>& second)
+{
+    if (first.size() != second.size()) {
+        return false;
+    }
+    for (size_t page = 0; page < first.size(); ++page) {
+        if (!(first[page].id == second[page].id)
+            || std::memcmp(&first[page].rank, &second[page].rank, sizeof(PageRank)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Process ids of children of this process, read from /proc.
+std::vector<pid_t> getChildren()
+{
+    std::vector<pid_t> children;
+    DIR* proc = opendir("/proc");
+    if (proc == nullptr) {
+        return children;
+    }
+    while (struct dirent* entry = readdir(proc)) {
+        pid_t pid = atoi(entry->d_name);
+        if (pid <= 0) {
+            continue;
+        }
+        std::ifstream stat(std::string("/proc/") + entry->d_name + "/stat");
+        std::string line;
+        std::getline(stat, line);
+        // Name of the process is in parentheses, state and parent id follow them.
+        size_t nameEnd = line.rfind(')');
+        if (nameEnd == std::string::npos) {
+            continue;
+        }
+        char state;
+        pid_t parent;
+        if (sscanf(line.c_str() + nameEnd + 1, " %c %d", &state, &parent) == 2
+            && parent == getpid() && state != 'Z') {
+            children.push_back(pid);
+        }
+    }
+    closedir(proc);
+    return children;
+}
+
+bool sameAsMultiThreaded(Network const& network)
+{
+    bool passed = true;
+    for (uint32_t shards : { 1u, 2u, 3u, 4u, 7u }) {
+        MultiThreadedPageRankComputer multi(shards);
+        ShardedPageRankComputer sharded(shards);
+        auto expected = multi.computeForNetwork(network, ALPHA, ITERATIONS, TOLERANCE);
+        auto ranks = sharded.computeForNetwork(network, ALPHA, ITERATIONS, TOLERANCE);
+        if (!sameRanks(expected, ranks)) {
+            std::cerr << sharded.getName() << " differs from " << multi.getName() << std::endl;
+            passed = false;
+        }
+
+        const ShardedPageRankStatistics& statistics = sharded.getShardedStatistics();
+        if (statistics.workers != std::min<size_t>(shards, network.getSize())
+            || statistics.restarts != 0
+            || (statistics.workers > 1 && statistics.boundaryPages == 0)) {
+            std::cerr << sharded.getName() << " has workers=" << statistics.workers
+                      << " restarts=" << statistics.restarts
+                      << " boundaryPages=" << statistics.boundaryPages << std::endl;
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+// Kills the first worker found, waits longer in every attempt to kill it at a later barrier.
+bool killedShardIsRestarted(Network const& network)
+{
+    const uint32_t shards = 3;
+    auto expected = MultiThreadedPageRankComputer(shards)
+                        .computeForNetwork(network, ALPHA, ITERATIONS, TOLERANCE);
+
+    bool passed = true;
+    uint32_t restarted = 0;
+    for (uint32_t attempt = 0; attempt < KILL_ATTEMPTS; ++attempt) {
+        ShardedPageRankComputer sharded(shards);
+        std::atomic<bool> done(false);
+        std::vector<PageIdAndRank> ranks;
+        std::thread computation([&]() {
+            ranks = sharded.computeForNetwork(network, ALPHA, ITERATIONS, TOLERANCE);
+            done = true;
+        });
+
+        std::vector<pid_t> children;
+        while (!done && (children = getChildren()).empty()) {
+            std::this_thread::yield();
+        }
+        if (!done) {
+            usleep(attempt * 1000);
+            kill(children[0], SIGKILL);
+        }
+        computation.join();
+
+        if (!sameRanks(expected, ranks)) {
+            std::cerr << sharded.getName() << " with killed worker differs from multi threaded"
+                      << std::endl;
+            passed = false;
+        }
+        restarted += sharded.getShardedStatistics().restarts;
+    }
+
+    if (restarted == 0) {
+        std::cerr << "no worker killed in " << KILL_ATTEMPTS << " attempts" << std::endl;
+        passed = false;
+    }
+    return passed;
+}
+
+}
+
+int main()
+{
+    ContentIdGenerator generator;
+
+    bool passed = true;
+    // Small networks have shards with a single page or without dangling nodes.
+    for (uint32_t pages : { 1u, 5u, 3000u }) {
+        Network network = generateNetwork(generator, pages, 6);
+        passed = sameAsMultiThreaded(network) && passed;
+    }
+    passed = killedShardIsRestarted(generateNetwork(generator, 20000, 6)) && passed;
+
+    std::cout << (passed ? "ALL TESTS PASSED" : "TESTS FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
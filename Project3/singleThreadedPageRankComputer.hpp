@@ -1,94 +1,294 @@
 #ifndef SRC_SINGLETHREADEDPAGERANKCOMPUTER_HPP_
 #define SRC_SINGLETHREADEDPAGERANKCOMPUTER_HPP_
 
-#include <unordered_map>
+#include <atomic>
+#include <ostream>
+#include <utility>
 #include <vector>
 
 #include "immutable/network.hpp"
 #include "immutable/pageIdAndRank.hpp"
 #include "immutable/pageRankComputer.hpp"
 
+#include "binaryPageId.hpp"
+#include "hugePageArena.hpp"
+#include "pageBlockSums.hpp"
+#include "pageRankCheckpoint.hpp"
+#include "pageRankControl.hpp"
+#include "pageRankGraph.hpp"
+#include "pageRankObserver.hpp"
+#include "pageRankResults.hpp"
+
 class SingleThreadedPageRankComputer : public PageRankComputer {
 public:
     SingleThreadedPageRankComputer() {};
 
+    // Observer receives statistics of every iteration. Null disables statistics.
+    void setObserver(PageRankObserver* observerArg)
+    {
+        observer = observerArg;
+    }
+
     std::vector<PageIdAndRank> computeForNetwork(Network const& network,
         double alpha,
         uint32_t iterations,
         double tolerance) const
     {
-        std::unordered_map<PageId, PageRank, PageIdHash> pageHashMap;
-        for (const auto& page : network.getPages()) {
-            page.generateId(network.getGenerator());
-            pageHashMap[page.getId()] = 1.0 / network.getSize();
-        }
+        return computeRanks(network, alpha, iterations, tolerance, PageRankResults::collectAll);
+    }
 
-        std::unordered_map<PageId, uint32_t, PageIdHash> numLinks;
-        for (const auto& page : network.getPages()) {
-            numLinks[page.getId()] = page.getLinks().size();
-        }
+    // In reproducible mode sums of ranks of dangling nodes and of differences are added
+    // in blocks of pages, see PageBlockSums. Ranks are then bit identical to those
+    // of MultiThreadedPageRankComputer in reproducible mode with any number of threads.
+    void setReproducible(bool reproducibleArg)
+    {
+        reproducible = reproducibleArg;
+    }
+
+    // Checkpoints of ranks are written to options.path every options.interval iterations.
+    void setCheckpointing(const PageRankCheckpointOptions& options)
+    {
+        checkpointOptions = options;
+    }
+
+    // Resumes computation from the checkpoint, if it was written for the same network, alpha
+    // and reproducible mode, otherwise computes from the beginning. Iterations include those
+    // done before the checkpoint, a checkpoint written after more of them is not used.
+    // Ranks of a checkpoint written when the computation converged are returned as they are.
+    std::vector<PageIdAndRank> resumeForNetwork(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance) const
+    {
+        return computeRanks(network, alpha, iterations, tolerance, PageRankResults::collectAll,
+            nullptr, true);
+    }
+
+    // Computes ranks in a new thread. It can be cancelled or stopped by a deadline,
+    // then ranks of the last iteration are returned.
+    PageRankHandle computeForNetworkAsync(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance,
+        const PageRankAsyncOptions& options = PageRankAsyncOptions()) const
+    {
+        return PageRankHandle(
+            [this, &network, alpha, iterations, tolerance](PageRankControl& control) {
+                return computeRanks(network, alpha, iterations, tolerance,
+                    PageRankResults::collectAll, &control);
+            },
+            options);
+    }
+
+    // Ranks with 32 byte binary ids, see BinaryPageId.
+    std::vector<BinaryPageIdAndRank> computeBinaryForNetwork(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance) const
+    {
+        return computeRanks(network, alpha, iterations, tolerance,
+            PageRankResults::collectAllBinary);
+    }
+
+    // Returns k pages with the highest ranks, starting from the highest.
+    std::vector<PageIdAndRank> computeTopKForNetwork(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance,
+        size_t k) const
+    {
+        return computeRanks(network, alpha, iterations, tolerance,
+            [k](Network const& network, const PageRankGraph*, const PageRank* ranks) {
+                return PageRankResults::selectTopK(network, ranks, k, 1);
+            });
+    }
+
+    // Writes "<page id> <rank>" lines to output, starting from the highest rank.
+    void writeSortedForNetwork(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance,
+        std::ostream& output) const
+    {
+        computeRanks(network, alpha, iterations, tolerance,
+            [&output](Network const& network, const PageRankGraph*, const PageRank* ranks) {
+                PageRankResults::writeSorted(network, ranks, output, 1);
+            });
+    }
+
+    std::string getName() const
+    {
+        return "SingleThreadedPageRankComputer";
+    }
+
+    // Memory used by graph and ranks in the last computation.
+    // Statistics cannot be read while a computation runs.
+    const ArenaStatistics& getArenaStatistics() const
+    {
+        assertNotComputing();
+        return arenaStatistics;
+    }
+
+    const PageRankCheckpointStatistics& getCheckpointStatistics() const
+    {
+        assertNotComputing();
+        return checkpointStatistics;
+    }
+
+private:
+    // Result is built by buildResult from network, its graph and ranks of its pages,
+    // before memory of the computation is released.
+    // Without control computation fails if it does not converge,
+    // with control it returns an empty result if it stops before the first iteration.
+    // When resuming, ranks and iteration are restored from the checkpoint.
+    template <typename ResultBuilder>
+    auto computeRanks(Network const& network,
+        double alpha,
+        uint32_t iterations,
+        double tolerance,
+        ResultBuilder buildResult,
+        PageRankControl* control = nullptr,
+        bool resume = false) const
+        -> decltype(buildResult(network, static_cast<const PageRankGraph*>(nullptr),
+            static_cast<const PageRank*>(nullptr)))
+    {
+        using Result = decltype(buildResult(network, static_cast<const PageRankGraph*>(nullptr),
+            static_cast<const PageRank*>(nullptr)));
+        PageRankComputationGuard guard(computing);
 
-        std::vector<PageId> danglingNodes;
-        for (const auto& page : network.getPages()) {
-            if (page.getLinks().size() == 0) {
-                danglingNodes.push_back(page.getId());
+        for (size_t page = 0; page < network.getSize(); ++page) {
+            if (control != nullptr && page % PageRankControl::setupCheckPages == 0
+                && control->isStopRequested()) {
+                break;
             }
+            network.getPages()[page].generateId(network.getGenerator());
         }
+        if (control != nullptr && control->endSetupPhase()) {
+            return Result();
+        }
+
+        // Whole graph and ranks are released at once when arena goes out of scope.
+        HugePageArena arena;
+        PageRankGraph graph(network, arena);
+        if (control != nullptr && control->endSetupPhase()) {
+            return Result();
+        }
+        const auto& numLinks = graph.getNumLinks();
+        const auto& inEdgesBegin = graph.getInEdgesBegin();
+        const auto& inEdges = graph.getInEdges();
+
+        ArenaVector<PageRank> pageRanks(network.getSize(), 1.0 / network.getSize(), arena);
+        ArenaVector<PageRank> previousPageRanks(network.getSize(), 0, arena);
+        // Buffers are swapped at the start of every iteration,
+        // ranks of the last iteration are in ranks.
+        PageRank* ranks = pageRanks.data();
+        PageRank* previousRanks = previousPageRanks.data();
         const double danglingWeight = 1.0 / network.getSize();
 
-        std::unordered_map<PageId, std::vector<PageId>, PageIdHash> edges;
-        for (const auto& page : network.getPages()) {
-            for (const auto& link : page.getLinks()) {
-                edges[link].push_back(page.getId());
+        PageRankCheckpointer checkpointer(checkpointOptions, network, graph, alpha, reproducible);
+        double restoredDifference = 0;
+        uint32_t firstIteration = resume ? checkpointer.restore(ranks, iterations, restoredDifference) : 0;
+
+        PageBlockSums danglingNodesRankSums(reproducible ? graph.getSize() : 0);
+        PageBlockSums differenceSums(reproducible ? graph.getSize() : 0);
+        const size_t numberOfBlocks = PageBlockSums::getNumberOfBlocks(graph.getSize());
+
+        PageRankIterationRecorder recorder(observer, getName(), network.getSize(), 1);
+
+        // Computation converged at the checkpoint, another iteration would change ranks.
+        if (firstIteration > 0 && restoredDifference < tolerance) {
+            if (control != nullptr) {
+                control->endIteration(firstIteration, restoredDifference, true);
             }
+            arenaStatistics = arena.getStatistics();
+            checkpointer.finish();
+            checkpointStatistics = checkpointer.getStatistics();
+            recorder.finish(firstIteration, true);
+            return buildResult(network, &graph, ranks);
         }
 
-        for (uint32_t i = 0; i < iterations; ++i) {
-            std::unordered_map<PageId, PageRank, PageIdHash>
-                previousPageHashMap = pageHashMap;
+        for (uint32_t i = firstIteration; i < iterations; ++i) {
+            recorder.startIteration(i);
 
-            double dangleSum = 0;
-            for (const auto& danglingNode : danglingNodes) {
-                dangleSum += previousPageHashMap.at(danglingNode);
-            }
-            dangleSum = dangleSum * alpha;
-            PageRank pageRankWithoutLinks = dangleSum * danglingWeight + (1.0 - alpha) / network.getSize();
+            std::swap(ranks, previousRanks);
 
+            double danglingNodesRankSum = 0;
             double difference = 0;
-            for (auto& pageMapElem : pageHashMap) {
-                const PageId& pageId = pageMapElem.first;
+            {
+                ThreadBusyTimer busyTimer(recorder.getThreadBusyTime(0));
+
+                const auto& danglingNodes = graph.getDanglingNodes();
+                if (reproducible) {
+                    danglingNodesRankSums.sumSelectedPages(0, numberOfBlocks,
+                        danglingNodes.begin(), danglingNodes.end(),
+                        [&](uint32_t danglingNode) { return previousRanks[danglingNode]; });
+                    danglingNodesRankSum = danglingNodesRankSums.getTotal();
+                } else {
+                    for (auto danglingNode : danglingNodes) {
+                        danglingNodesRankSum += previousRanks[danglingNode];
+                    }
+                }
+                double dangleSum = danglingNodesRankSum * alpha;
+                PageRank pageRankWithoutLinks = dangleSum * danglingWeight + (1.0 - alpha) / network.getSize();
+                recorder.endPhase(PageRankIterationRecorder::Phase::dangling);
 
-                pageMapElem.second = pageRankWithoutLinks;
+                // Returns difference of the updated rank.
+                auto updatePageRank = [&](size_t page) {
+                    PageRank& pageRank = ranks[page];
+                    pageRank = pageRankWithoutLinks;
 
-                if (edges.count(pageId) > 0) {
-                    for (const auto& link : edges.at(pageId)) {
-                        pageMapElem.second += alpha * previousPageHashMap.at(link)
-                            / numLinks.at(link);
+                    for (size_t edge = inEdgesBegin[page]; edge < inEdgesBegin[page + 1]; ++edge) {
+                        uint32_t link = inEdges[edge];
+                        pageRank += alpha * previousRanks[link] / numLinks[link];
+                    }
+                    return std::abs(previousRanks[page] - pageRank);
+                };
+                if (reproducible) {
+                    differenceSums.sumPages(0, numberOfBlocks, graph.getSize(), updatePageRank);
+                    difference = differenceSums.getTotal();
+                } else {
+                    for (size_t page = 0; page < graph.getSize(); ++page) {
+                        difference += updatePageRank(page);
                     }
                 }
-                difference += std::abs(
-                    previousPageHashMap.at(pageId) - pageHashMap.at(pageId));
+                recorder.endPhase(PageRankIterationRecorder::Phase::update);
             }
 
-            if (difference < tolerance) {
-                std::vector<PageIdAndRank> result;
-                for (auto iter : pageHashMap) {
-                    result.push_back(PageIdAndRank(iter.first, iter.second));
-                }
+            recorder.endIteration(difference, danglingNodesRankSum,
+                arena.getStatistics().allocatedBytes);
+            checkpointer.endIteration(i + 1, ranks, difference);
 
-                ASSERT(result.size() == network.getSize(),
-                    "Invalid result size=" << result.size()
-                                           << ", for network" << network);
-                return result;
+            bool converged = difference < tolerance;
+            if (control != nullptr ? control->endIteration(i + 1, difference, converged) : converged) {
+                arenaStatistics = arena.getStatistics();
+                checkpointer.finish();
+                checkpointStatistics = checkpointer.getStatistics();
+                recorder.finish(i + 1, converged);
+                return buildResult(network, &graph, ranks);
             }
         }
-        ASSERT(false, "Not able to find result in iterations=" << iterations);
+        arenaStatistics = arena.getStatistics();
+        checkpointer.finish();
+        checkpointStatistics = checkpointer.getStatistics();
+        recorder.finish(iterations, false);
+        ASSERT(control != nullptr, "Not able to find result in iterations=" << iterations);
+        return buildResult(network, &graph, ranks);
     }
 
-    std::string getName() const
+    void assertNotComputing() const
     {
-        return "SingleThreadedPageRankComputer";
+        ASSERT(!computing.load(std::memory_order_acquire),
+            "Statistics of " << getName() << " read while it computes");
     }
+
+    PageRankObserver* observer = nullptr;
+    bool reproducible = false;
+
+    PageRankCheckpointOptions checkpointOptions;
+
+    mutable std::atomic<bool> computing { false };
+    mutable ArenaStatistics arenaStatistics;
+    mutable PageRankCheckpointStatistics checkpointStatistics;
 };
 
 #endif /* SRC_SINGLETHREADEDPAGERANKCOMPUTER_HPP_ */
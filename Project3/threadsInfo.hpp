@@ -0,0 +1,59 @@
+#ifndef SRC_THREADSINFO_HPP_
+#define SRC_THREADSINFO_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Divides nodes into contiguous ranges for threads, or other workers.
+class ThreadsInfo {
+public:
+    ThreadsInfo(size_t numberOfNodes, uint32_t numThreads)
+    {
+        // Don't need more threads than number of nodes.
+        numberOfThreadsUsed = std::min(static_cast<uint32_t>(numberOfNodes), numThreads);
+
+        // Divide nodes among threads equally.
+        // Threads in first group calculate for one more node than those in second group.
+        nodesPerThreadInFirstGroup = numberOfNodes / numThreads + 1;
+        nodesPerThreadInSecondGroup = numberOfNodes / numThreads;
+
+        numberOfThreadsInFirstGroup = numberOfNodes % numThreads;
+    }
+
+    size_t getThreadFirstIndex(uint32_t threadNumber) const
+    {
+        if (threadNumber < numberOfThreadsInFirstGroup) {
+            return threadNumber * nodesPerThreadInFirstGroup;
+        } else {
+            return numberOfThreadsInFirstGroup * nodesPerThreadInFirstGroup
+                + (threadNumber - numberOfThreadsInFirstGroup)
+                * nodesPerThreadInSecondGroup;
+        }
+    }
+
+    size_t getThreadLastIndex(uint32_t threadNumber) const
+    {
+        if (threadNumber < numberOfThreadsInFirstGroup) {
+            return (threadNumber + 1) * nodesPerThreadInFirstGroup - 1;
+        } else {
+            return numberOfThreadsInFirstGroup * nodesPerThreadInFirstGroup
+                + (threadNumber - numberOfThreadsInFirstGroup + 1)
+                * nodesPerThreadInSecondGroup
+                - 1;
+        }
+    }
+
+    uint32_t getNumberOfThreadsUsed() const
+    {
+        return numberOfThreadsUsed;
+    }
+
+private:
+    uint32_t numberOfThreadsUsed;
+    size_t nodesPerThreadInFirstGroup;
+    size_t nodesPerThreadInSecondGroup;
+    size_t numberOfThreadsInFirstGroup;
+};
+
+#endif /* SRC_THREADSINFO_HPP_ */